@@ -44,9 +44,13 @@
 #include "sysemu/tcg.h"
 #include "exec/helper-proto.h"
 #include "tb-hash.h"
+#include "tb-jmp-cache.h"
 #include "tb-context.h"
 #include "internal.h"
 
+/* log2 of the jump cache size of vCPUs created from now on */
+unsigned int tb_jmp_cache_bits = TB_JMP_CACHE_BITS;
+
 /* -icount align implementation. */
 
 typedef struct SyncClocks {
@@ -171,33 +175,76 @@ uint32_t curr_cflags(CPUState *cpu)
     return cflags;
 }
 
+/*
+ * Is TB, from a jump cache entry of an older generation, still what
+ * tb_htable_lookup() would find at its PC?  The rest of the key was
+ * compared by the caller, so check the guest physical pages.
+ */
+static bool tb_jmp_cache_revalidate(CPUState *cpu, TranslationBlock *tb)
+{
+    CPUArchState *env = cpu->env_ptr;
+    tb_page_addr_t phys_pc;
+
+    phys_pc = get_page_addr_code(env, tb->pc);
+    if (phys_pc == -1 || tb->page_addr[0] != (phys_pc & TARGET_PAGE_MASK)) {
+        return false;
+    }
+    if (tb->page_addr[1] != -1) {
+        target_ulong virt_page2 = (tb->pc & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
+
+        return tb->page_addr[1] == get_page_addr_code(env, virt_page2);
+    }
+    return true;
+}
+
 /* Might cause an exception, so have a longjmp destination ready */
 static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
                                           target_ulong cs_base,
                                           uint32_t flags, uint32_t cflags)
 {
+    TBJmpCacheEntry *set;
     TranslationBlock *tb;
-    uint32_t hash;
+    int way;
 
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(pc);
-    tb = qatomic_rcu_read(&cpu->tb_jmp_cache[hash]);
-
-    if (likely(tb &&
-               tb->pc == pc &&
-               tb->cs_base == cs_base &&
-               tb->flags == flags &&
-               tb->trace_vcpu_dstate == *cpu->trace_dstate &&
-               tb_cflags(tb) == cflags)) {
-        return tb;
+    set = tb_jmp_cache_set(cpu, pc);
+    for (way = 0; way < TB_JMP_CACHE_WAYS; way++) {
+        if (set[way].pc != pc) {
+            continue;
+        }
+        tb = qatomic_rcu_read(&set[way].tb);
+        if (likely(tb &&
+                   tb->pc == pc &&
+                   tb->cs_base == cs_base &&
+                   tb->flags == flags &&
+                   tb->trace_vcpu_dstate == *cpu->trace_dstate &&
+                   tb_cflags(tb) == cflags)) {
+            if (unlikely(set[way].gen != cpu->tb_jmp_cache_gen)) {
+                if (!tb_jmp_cache_revalidate(cpu, tb)) {
+                    qatomic_set(&set[way].tb, NULL);
+                    break;
+                }
+                qatomic_set(&cpu->tb_jmp_cache_revalidations,
+                            cpu->tb_jmp_cache_revalidations + 1);
+            }
+            if (way) {
+                tb_jmp_cache_promote(cpu, set, way, tb);
+            } else {
+                set[0].gen = cpu->tb_jmp_cache_gen;
+            }
+            qatomic_set(&cpu->tb_jmp_cache_hits, cpu->tb_jmp_cache_hits + 1);
+            return tb;
+        }
     }
+
+    qatomic_set(&cpu->tb_jmp_cache_misses, cpu->tb_jmp_cache_misses + 1);
     tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
     if (tb == NULL) {
         return NULL;
     }
-    qatomic_set(&cpu->tb_jmp_cache[hash], tb);
+    tb_jmp_cache_insert(cpu, tb);
     return tb;
 }
 
@@ -333,6 +380,78 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     return tb->tc.ptr;
 }
 
+/**
+ * helper_push_return: record a guest call
+ * @env: current cpu state
+ * @pc: return address of the call
+ *
+ * Push @pc on the shadow return stack, for helper_lookup_tb_ptr_ret.
+ * The slot keeps its TB if it held the same return address already,
+ * as it does when a loop calls the same function over and over.
+ */
+void HELPER(push_return)(CPUArchState *env, target_ulong pc)
+{
+    CPUState *cpu = env_cpu(env);
+    unsigned int top = (cpu->tb_ret_stack_top + 1) & (TB_RET_STACK_SIZE - 1);
+    TBRetStackEntry *e = &cpu->tb_ret_stack[top];
+
+    if (e->pc != pc) {
+        e->pc = pc;
+        e->tb = NULL;
+    }
+    cpu->tb_ret_stack_top = top;
+}
+
+/**
+ * helper_lookup_tb_ptr_ret: quick check for the TB a guest returns to
+ * @env: current cpu state
+ *
+ * Like helper_lookup_tb_ptr, but try the TB predicted by the shadow
+ * return stack first, which is popped.  Fall back to the jump cache
+ * and the hash table when the guest does not return where it was
+ * called from, as longjmp() or a thread switch would.
+ */
+const void *HELPER(lookup_tb_ptr_ret)(CPUArchState *env)
+{
+    CPUState *cpu = env_cpu(env);
+    unsigned int top = cpu->tb_ret_stack_top;
+    TBRetStackEntry *e = &cpu->tb_ret_stack[top];
+    TranslationBlock *tb;
+    target_ulong cs_base, pc;
+    uint32_t flags, cflags;
+
+    cpu->tb_ret_stack_top = (top - 1) & (TB_RET_STACK_SIZE - 1);
+
+    cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
+
+    cflags = curr_cflags(cpu);
+    if (check_for_breakpoints(cpu, pc, &cflags)) {
+        cpu_loop_exit(cpu);
+    }
+
+    tb = e->pc == pc ? e->tb : NULL;
+    if (likely(tb &&
+               tb->cs_base == cs_base &&
+               tb->flags == flags &&
+               tb->trace_vcpu_dstate == *cpu->trace_dstate &&
+               tb_cflags(tb) == cflags)) {
+        qatomic_set(&cpu->tb_ret_stack_hits, cpu->tb_ret_stack_hits + 1);
+    } else {
+        qatomic_set(&cpu->tb_ret_stack_misses, cpu->tb_ret_stack_misses + 1);
+        tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
+        if (tb == NULL) {
+            return tcg_code_gen_epilogue;
+        }
+        if (e->pc == pc) {
+            e->tb = tb;
+        }
+    }
+
+    log_cpu_exec(pc, cpu, tb);
+
+    return tb->tc.ptr;
+}
+
 /* Execute a TB, and fix up the CPU state afterwards if necessary */
 /*
  * Disable CFI checks.
@@ -859,7 +978,12 @@ static inline void cpu_loop_exec_tb(CPUState *cpu, TranslationBlock *tb,
          * interrupt_request) which will be handled by
          * cpu_handle_interrupt.  cpu_handle_interrupt will also
          * clear cpu->icount_decr.u16.high.
+         *
+         * The TB sampler asks for nothing else: @tb is its sample.
          */
+        if (tb_sample_enabled()) {
+            tb_sample_take(cpu, tb);
+        }
         return;
     }
 
@@ -984,7 +1108,7 @@ int cpu_exec(CPUState *cpu)
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                qatomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
+                tb_jmp_cache_insert(cpu, tb);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -993,8 +1117,13 @@ int cpu_exec(CPUState *cpu)
              * changes in system emulation.  So it's not safe to make a
              * direct jump to a TB spanning two pages because the mapping
              * for the second page can change.
+             *
+             * Nor to or from a one-shot TB, which has no physical page:
+             * those are not in the region trees, where an eviction looks
+             * for the TBs to unlink (see tb_invalidate_region).
              */
-            if (tb->page_addr[1] != -1) {
+            if (tb->page_addr[1] != -1 || tb->page_addr[0] == -1 ||
+                (last_tb && last_tb->page_addr[0] == -1)) {
                 last_tb = NULL;
             }
 #endif
@@ -1026,6 +1155,8 @@ void tcg_exec_realizefn(CPUState *cpu, Error **errp)
         cc->tcg_ops->initialize();
         tcg_target_initialized = true;
     }
+    cpu->tb_jmp_cache_bits = tb_jmp_cache_bits;
+    cpu->tb_jmp_cache = g_new0(TBJmpCacheEntry, 1u << tb_jmp_cache_bits);
     tlb_init(cpu);
     qemu_plugin_vcpu_init_hook(cpu);
 
@@ -1043,6 +1174,8 @@ void tcg_exec_unrealizefn(CPUState *cpu)
 
     qemu_plugin_vcpu_exit_hook(cpu);
     tlb_destroy(cpu);
+    g_free(cpu->tb_jmp_cache);
+    cpu->tb_jmp_cache = NULL;
 }
 
 #ifndef CONFIG_USER_ONLY
@@ -1081,6 +1214,30 @@ HumanReadableText *qmp_x_query_jit(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+HumanReadableText *qmp_x_query_tb_hot(bool has_count, int64_t count,
+                                      Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "TB samples are only available with accel=tcg");
+        return NULL;
+    }
+    if (!tb_sample_enabled()) {
+        error_setg(errp, "TB sampling is off, enable it with "
+                   "-accel tcg,tb-sample=hz");
+        return NULL;
+    }
+    if (has_count && count < 0) {
+        error_setg(errp, "Invalid count %" PRId64, count);
+        return NULL;
+    }
+
+    dump_tb_hot_info(buf, has_count ? count : 10);
+
+    return human_readable_text_from_str(buf);
+}
+
 HumanReadableText *qmp_x_query_opcount(Error **errp)
 {
     g_autoptr(GString) buf = g_string_new("");
@@ -35,6 +35,7 @@
 #include "exec/translate-all.h"
 #include "trace/trace-root.h"
 #include "tb-hash.h"
+#include "tb-jmp-cache.h"
 #include "internal.h"
 #ifdef CONFIG_PLUGIN
 #include "qemu/plugin-memory.h"
@@ -81,6 +82,9 @@ QEMU_BUILD_BUG_ON(sizeof(target_ulong) > sizeof(run_on_cpu_data));
 QEMU_BUILD_BUG_ON(NB_MMU_MODES > 16);
 #define ALL_MMUIDX_BITS ((1 << NB_MMU_MODES) - 1)
 
+/* Victim tlb size from -accel tcg,vtlb-size; 0 for CPU_VTLB_SIZE. */
+unsigned int tlb_vtlb_size;
+
 static inline size_t tlb_n_entries(CPUTLBDescFast *fast)
 {
     return (fast->mask >> CPU_TLB_ENTRY_BITS) + 1;
@@ -100,10 +104,15 @@ static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
 
 static void tb_jmp_cache_clear_page(CPUState *cpu, target_ulong page_addr)
 {
-    unsigned int i, i0 = tb_jmp_cache_hash_page(page_addr);
+    unsigned int set_bits = tb_jmp_cache_set_bits(cpu);
+    unsigned int n = TB_JMP_CACHE_WAYS << tb_jmp_page_bits(set_bits);
+    TBJmpCacheEntry *e;
+    unsigned int i;
 
-    for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
-        qatomic_set(&cpu->tb_jmp_cache[i0 + i], NULL);
+    e = &cpu->tb_jmp_cache[tb_jmp_cache_hash_page(page_addr, set_bits)
+                           << TB_JMP_CACHE_WAYS_BITS];
+    for (i = 0; i < n; i++) {
+        qatomic_set(&e[i].tb, NULL);
     }
 }
 
@@ -113,6 +122,7 @@ static void tb_flush_jmp_cache(CPUState *cpu, target_ulong addr)
        overlap the flushed page.  */
     tb_jmp_cache_clear_page(cpu, addr - TARGET_PAGE_SIZE);
     tb_jmp_cache_clear_page(cpu, addr);
+    cpu_tb_ret_stack_clear(cpu);
 }
 
 /**
@@ -233,11 +243,11 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
 static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
 {
     desc->n_used_entries = 0;
-    desc->large_page_addr = -1;
-    desc->large_page_mask = -1;
+    desc->n_large_pages = 0;
+    desc->large_page_walk_mask = TARGET_PAGE_MASK;
     desc->vindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
-    memset(desc->vtable, -1, sizeof(desc->vtable));
+    memset(desc->vtable, -1, desc->vsize * sizeof(CPUTLBEntry));
 }
 
 static void tlb_flush_one_mmuidx_locked(CPUArchState *env, int mmu_idx,
@@ -259,6 +269,9 @@ static void tlb_mmu_init(CPUTLBDesc *desc, CPUTLBDescFast *fast, int64_t now)
     fast->mask = (n_entries - 1) << CPU_TLB_ENTRY_BITS;
     fast->table = g_new(CPUTLBEntry, n_entries);
     desc->iotlb = g_new(CPUIOTLBEntry, n_entries);
+    desc->vsize = tlb_vtlb_size ? tlb_vtlb_size : CPU_VTLB_SIZE;
+    desc->vtable = g_new(CPUTLBEntry, desc->vsize);
+    desc->viotlb = g_new(CPUIOTLBEntry, desc->vsize);
     tlb_mmu_flush_locked(desc, fast);
 }
 
@@ -300,6 +313,8 @@ void tlb_destroy(CPUState *cpu)
 
         g_free(fast->table);
         g_free(desc->iotlb);
+        g_free(desc->vtable);
+        g_free(desc->viotlb);
     }
 }
 
@@ -322,10 +337,11 @@ static void flush_all_helper(CPUState *src, run_on_cpu_func fn,
     }
 }
 
-void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
+void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide,
+                      size_t *plarge)
 {
     CPUState *cpu;
-    size_t full = 0, part = 0, elide = 0;
+    size_t full = 0, part = 0, elide = 0, large = 0;
 
     CPU_FOREACH(cpu) {
         CPUArchState *env = cpu->env_ptr;
@@ -333,10 +349,12 @@ void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
         full += qatomic_read(&env_tlb(env)->c.full_flush_count);
         part += qatomic_read(&env_tlb(env)->c.part_flush_count);
         elide += qatomic_read(&env_tlb(env)->c.elide_flush_count);
+        large += qatomic_read(&env_tlb(env)->c.large_flush_count);
     }
     *pfull = full;
     *ppart = part;
     *pelide = elide;
+    *plarge = large;
 }
 
 static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
@@ -364,7 +382,7 @@ static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
 
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 
-    cpu_tb_jmp_cache_clear(cpu);
+    tb_jmp_cache_new_gen(cpu);
 
     if (to_clean == ALL_MMUIDX_BITS) {
         qatomic_set(&env_tlb(env)->c.full_flush_count,
@@ -477,10 +495,10 @@ static void tlb_flush_vtlb_page_mask_locked(CPUArchState *env, int mmu_idx,
                                             target_ulong mask)
 {
     CPUTLBDesc *d = &env_tlb(env)->d[mmu_idx];
-    int k;
+    size_t k;
 
     assert_cpu_is_self(env_cpu(env));
-    for (k = 0; k < CPU_VTLB_SIZE; k++) {
+    for (k = 0; k < d->vsize; k++) {
         if (tlb_flush_entry_mask_locked(&d->vtable[k], page, mask)) {
             tlb_n_used_entries_dec(env, mmu_idx);
         }
@@ -493,19 +511,13 @@ static inline void tlb_flush_vtlb_page_locked(CPUArchState *env, int mmu_idx,
     tlb_flush_vtlb_page_mask_locked(env, mmu_idx, page, -1);
 }
 
-static void tlb_flush_page_locked(CPUArchState *env, int midx,
-                                  target_ulong page)
+/* Flush every page of [@addr, @last] from @midx. */
+static void tlb_flush_pages_locked(CPUArchState *env, int midx,
+                                   target_ulong addr, target_ulong last)
 {
-    target_ulong lp_addr = env_tlb(env)->d[midx].large_page_addr;
-    target_ulong lp_mask = env_tlb(env)->d[midx].large_page_mask;
+    for (target_ulong o = 0; o <= last - addr; o += TARGET_PAGE_SIZE) {
+        target_ulong page = addr + o;
 
-    /* Check if we need to flush due to large pages.  */
-    if ((page & lp_mask) == lp_addr) {
-        tlb_debug("forcing full flush midx %d ("
-                  TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
-                  midx, lp_addr, lp_mask);
-        tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
-    } else {
         if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
             tlb_n_used_entries_dec(env, midx);
         }
@@ -513,6 +525,84 @@ static void tlb_flush_page_locked(CPUArchState *env, int midx,
     }
 }
 
+/*
+ * Return the index of a large page region of @d that overlaps
+ * [@addr, @last], or -1 if there is none.
+ */
+static int tlb_find_large_page_locked(CPUTLBDesc *d, target_ulong addr,
+                                      target_ulong last)
+{
+    unsigned int i;
+
+    for (i = 0; i < d->n_large_pages; i++) {
+        target_ulong lp_addr = d->large_page_addr[i];
+        target_ulong lp_last = lp_addr | ~d->large_page_mask[i];
+
+        if (addr <= lp_last && lp_addr <= last) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Flush every page of large page region @i of @midx, which then goes
+ * away.  Regions that take longer to walk than the whole tlb does to
+ * clear flush the entire tlb instead.
+ */
+static void tlb_flush_large_page_locked(CPUArchState *env, int midx,
+                                        unsigned int i)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    CPUTLBDescFast *f = &env_tlb(env)->f[midx];
+    target_ulong lp_addr = d->large_page_addr[i];
+    target_ulong lp_mask = d->large_page_mask[i];
+    target_ulong len = ~lp_mask + 1;
+
+    if (len == 0 || len / TARGET_PAGE_SIZE > tlb_n_entries(f)) {
+        tlb_debug("forcing full flush midx %d ("
+                  TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
+                  midx, lp_addr, lp_mask);
+        tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
+        qatomic_set(&env_tlb(env)->c.large_flush_count,
+                    env_tlb(env)->c.large_flush_count + 1);
+        return;
+    }
+
+    tlb_debug("flushing large page midx %d ("
+              TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
+              midx, lp_addr, lp_mask);
+    tlb_flush_pages_locked(env, midx, lp_addr, lp_addr | ~lp_mask);
+
+    /* Keep the regions in use at the front. */
+    d->n_large_pages--;
+    d->large_page_addr[i] = d->large_page_addr[d->n_large_pages];
+    d->large_page_mask[i] = d->large_page_mask[d->n_large_pages];
+}
+
+/* Flush the large page regions of @midx that overlap [@addr, @last]. */
+static void tlb_flush_large_pages_locked(CPUArchState *env, int midx,
+                                         target_ulong addr, target_ulong last)
+{
+    CPUTLBDesc *d = &env_tlb(env)->d[midx];
+    int i;
+
+    while ((i = tlb_find_large_page_locked(d, addr, last)) >= 0) {
+        tlb_flush_large_page_locked(env, midx, i);
+    }
+}
+
+static void tlb_flush_page_locked(CPUArchState *env, int midx,
+                                  target_ulong page)
+{
+    target_ulong walk_mask = env_tlb(env)->d[midx].large_page_walk_mask;
+
+    /* Check if we need to flush due to large pages.  */
+    tlb_flush_large_pages_locked(env, midx, page, page);
+
+    tlb_flush_pages_locked(env, midx, page & walk_mask, page | ~walk_mask);
+}
+
 /**
  * tlb_flush_page_by_mmuidx_async_0:
  * @cpu: cpu on which to flush
@@ -733,18 +823,13 @@ static void tlb_flush_range_locked(CPUArchState *env, int midx,
         return;
     }
 
-    /*
-     * Check if we need to flush due to large pages.
-     * Because large_page_mask contains all 1's from the msb,
-     * we only need to test the end of the range.
-     */
-    if (((addr + len - 1) & d->large_page_mask) == d->large_page_addr) {
-        tlb_debug("forcing full flush midx %d ("
-                  TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
-                  midx, d->large_page_addr, d->large_page_mask);
-        tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
-        return;
-    }
+    /* Check if we need to flush due to large pages.  */
+    tlb_flush_large_pages_locked(env, midx, addr, addr + len - 1);
+
+    /* Round out to the small large pages that the range may hit.  */
+    len = ((addr + len - 1) | ~d->large_page_walk_mask) -
+          (addr & d->large_page_walk_mask) + 1;
+    addr &= d->large_page_walk_mask;
 
     for (target_ulong i = 0; i < len; i += TARGET_PAGE_SIZE) {
         target_ulong page = addr + i;
@@ -785,10 +870,11 @@ static void tlb_flush_range_by_mmuidx_async_0(CPUState *cpu,
 
     /*
      * If the length is larger than the jump cache size, then it will take
-     * longer to clear each entry individually than it will to clear it all.
+     * longer to clear each entry individually than it will to start a new
+     * generation and have the entries revalidated as they are used.
      */
-    if (d.len >= (TARGET_PAGE_SIZE * TB_JMP_CACHE_SIZE)) {
-        cpu_tb_jmp_cache_clear(cpu);
+    if (d.len >= (TARGET_PAGE_SIZE << cpu->tb_jmp_cache_bits)) {
+        tb_jmp_cache_new_gen(cpu);
         return;
     }
 
@@ -1030,7 +1116,7 @@ void tlb_reset_dirty(CPUState *cpu, ram_addr_t start1, ram_addr_t length)
                                          start1, length);
         }
 
-        for (i = 0; i < CPU_VTLB_SIZE; i++) {
+        for (i = 0; i < env_tlb(env)->d[mmu_idx].vsize; i++) {
             tlb_reset_dirty_range_locked(&env_tlb(env)->d[mmu_idx].vtable[i],
                                          start1, length);
         }
@@ -1063,36 +1149,58 @@ void tlb_set_dirty(CPUState *cpu, target_ulong vaddr)
     }
 
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
-        int k;
-        for (k = 0; k < CPU_VTLB_SIZE; k++) {
+        size_t k;
+        for (k = 0; k < env_tlb(env)->d[mmu_idx].vsize; k++) {
             tlb_set_dirty1_locked(&env_tlb(env)->d[mmu_idx].vtable[k], vaddr);
         }
     }
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 }
 
-/* Our TLB does not support large pages, so remember the area covered by
-   large pages and trigger a full TLB flush if these are invalidated.  */
+/* Our TLB does not support large pages, so remember the areas covered by
+   large pages and flush all of an area if any page of it is invalidated.  */
 static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
                                target_ulong vaddr, target_ulong size)
 {
-    target_ulong lp_addr = env_tlb(env)->d[mmu_idx].large_page_addr;
+    CPUTLBDesc *d = &env_tlb(env)->d[mmu_idx];
     target_ulong lp_mask = ~(size - 1);
+    target_ulong best_mask = 0;
+    unsigned int i, best = 0;
+
+    /* Small enough to flush all of it along with any page of its size.  */
+    if (size <= TARGET_PAGE_SIZE << CPU_TLB_LARGE_PAGE_WALK_BITS) {
+        d->large_page_walk_mask &= lp_mask;
+        return;
+    }
+
+    for (i = 0; i < d->n_large_pages; i++) {
+        target_ulong mask = lp_mask & d->large_page_mask[i];
+
+        while (((d->large_page_addr[i] ^ vaddr) & mask) != 0) {
+            mask <<= 1;
+        }
+        if (mask == d->large_page_mask[i]) {
+            /* Already covered by this region.  */
+            return;
+        }
+        /* The masks are all 1's from the msb: bigger is smaller.  */
+        if (mask > best_mask) {
+            best_mask = mask;
+            best = i;
+        }
+    }
 
-    if (lp_addr == (target_ulong)-1) {
-        /* No previous large page.  */
-        lp_addr = vaddr;
+    if (d->n_large_pages < CPU_TLB_LARGE_PAGE_RANGES) {
+        i = d->n_large_pages++;
+        d->large_page_addr[i] = vaddr & lp_mask;
+        d->large_page_mask[i] = lp_mask;
     } else {
-        /* Extend the existing region to include the new page.
+        /* Extend the region that grows the least to include the new page.
            This is a compromise between unnecessary flushes and
            the cost of maintaining a full variable size TLB.  */
-        lp_mask &= env_tlb(env)->d[mmu_idx].large_page_mask;
-        while (((lp_addr ^ vaddr) & lp_mask) != 0) {
-            lp_mask <<= 1;
-        }
+        d->large_page_addr[best] &= best_mask;
+        d->large_page_mask[best] = best_mask;
     }
-    env_tlb(env)->d[mmu_idx].large_page_addr = lp_addr & lp_mask;
-    env_tlb(env)->d[mmu_idx].large_page_mask = lp_mask;
 }
 
 /* Add a new TLB entry. At most one entry for a given virtual address
@@ -1214,7 +1322,7 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
      * different page; otherwise just overwrite the stale data.
      */
     if (!tlb_hit_page_anyprot(te, vaddr_page) && !tlb_entry_is_empty(te)) {
-        unsigned vidx = desc->vindex++ % CPU_VTLB_SIZE;
+        unsigned vidx = desc->vindex++ % desc->vsize;
         CPUTLBEntry *tv = &desc->vtable[vidx];
 
         /* Evict the old entry into the victim tlb.  */
@@ -1459,7 +1567,7 @@ static bool victim_tlb_hit(CPUArchState *env, size_t mmu_idx, size_t index,
     size_t vidx;
 
     assert_cpu_is_self(env_cpu(env));
-    for (vidx = 0; vidx < CPU_VTLB_SIZE; ++vidx) {
+    for (vidx = 0; vidx < env_tlb(env)->d[mmu_idx].vsize; ++vidx) {
         CPUTLBEntry *vtlb = &env_tlb(env)->d[mmu_idx].vtable[vidx];
         target_ulong cmp;
 
@@ -2541,6 +2649,33 @@ void cpu_stq_le_mmu(CPUArchState *env, target_ulong addr, uint64_t val,
     cpu_store_helper(env, addr, val, oi, retaddr, helper_le_stq_mmu);
 }
 
+/*
+ * Probe [addr, addr + len), which must not cross a page, for a bulk access
+ * by guest_memcpy() and friends.  Return the host address if the bytes can
+ * be accessed directly, or NULL if they must go through the slow path one
+ * element at a time, i.e. for MMIO and for pages with watchpoints.
+ */
+static void *guest_mem_probe(CPUArchState *env, target_ulong addr, int len,
+                             MMUAccessType access_type, int mmu_idx,
+                             uintptr_t ra)
+{
+    void *host;
+    int flags;
+
+    flags = probe_access_internal(env, addr, len, access_type, mmu_idx,
+                                  false, &host, ra);
+    if (unlikely(flags & (TLB_MMIO | TLB_WATCHPOINT))) {
+        return NULL;
+    }
+    if (unlikely(flags & TLB_NOTDIRTY)) {
+        uintptr_t index = tlb_index(env, mmu_idx, addr);
+        CPUIOTLBEntry *iotlbentry = &env_tlb(env)->d[mmu_idx].iotlb[index];
+
+        notdirty_write(env_cpu(env), addr, len, iotlbentry, ra);
+    }
+    return host;
+}
+
 #include "ldst_common.c.inc"
 
 /*
@@ -2577,6 +2712,22 @@ void cpu_stq_le_mmu(CPUArchState *env, target_ulong addr, uint64_t val,
 
 /* Code access functions.  */
 
+/*
+ * A translation ahead of execution reads its code straight from the
+ * page it was started on, bypassing the TLB of the vCPU, and gives up
+ * on anything outside of that page.
+ */
+static const void *tb_prefetch_code_ptr(target_ulong addr, int size)
+{
+    const TBPrefetchPage *page = tb_prefetch_page;
+
+    if ((addr & TARGET_PAGE_MASK) != page->addr ||
+        ((addr + size - 1) & TARGET_PAGE_MASK) != page->addr) {
+        siglongjmp(tcg_ctx->jmp_trans, -3);
+    }
+    return page->host + (addr & ~TARGET_PAGE_MASK);
+}
+
 static uint64_t full_ldub_code(CPUArchState *env, target_ulong addr,
                                MemOpIdx oi, uintptr_t retaddr)
 {
@@ -2585,7 +2736,12 @@ static uint64_t full_ldub_code(CPUArchState *env, target_ulong addr,
 
 uint32_t cpu_ldub_code(CPUArchState *env, abi_ptr addr)
 {
-    MemOpIdx oi = make_memop_idx(MO_UB, cpu_mmu_index(env, true));
+    MemOpIdx oi;
+
+    if (unlikely(tb_prefetch_page)) {
+        return ldub_p(tb_prefetch_code_ptr(addr, 1));
+    }
+    oi = make_memop_idx(MO_UB, cpu_mmu_index(env, true));
     return full_ldub_code(env, addr, oi, 0);
 }
 
@@ -2597,7 +2753,12 @@ static uint64_t full_lduw_code(CPUArchState *env, target_ulong addr,
 
 uint32_t cpu_lduw_code(CPUArchState *env, abi_ptr addr)
 {
-    MemOpIdx oi = make_memop_idx(MO_TEUW, cpu_mmu_index(env, true));
+    MemOpIdx oi;
+
+    if (unlikely(tb_prefetch_page)) {
+        return lduw_p(tb_prefetch_code_ptr(addr, 2));
+    }
+    oi = make_memop_idx(MO_TEUW, cpu_mmu_index(env, true));
     return full_lduw_code(env, addr, oi, 0);
 }
 
@@ -2609,7 +2770,12 @@ static uint64_t full_ldl_code(CPUArchState *env, target_ulong addr,
 
 uint32_t cpu_ldl_code(CPUArchState *env, abi_ptr addr)
 {
-    MemOpIdx oi = make_memop_idx(MO_TEUL, cpu_mmu_index(env, true));
+    MemOpIdx oi;
+
+    if (unlikely(tb_prefetch_page)) {
+        return ldl_p(tb_prefetch_code_ptr(addr, 4));
+    }
+    oi = make_memop_idx(MO_TEUL, cpu_mmu_index(env, true));
     return full_ldl_code(env, addr, oi, 0);
 }
 
@@ -2621,6 +2787,11 @@ static uint64_t full_ldq_code(CPUArchState *env, target_ulong addr,
 
 uint64_t cpu_ldq_code(CPUArchState *env, abi_ptr addr)
 {
-    MemOpIdx oi = make_memop_idx(MO_TEUQ, cpu_mmu_index(env, true));
+    MemOpIdx oi;
+
+    if (unlikely(tb_prefetch_page)) {
+        return ldq_p(tb_prefetch_code_ptr(addr, 8));
+    }
+    oi = make_memop_idx(MO_TEUQ, cpu_mmu_index(env, true));
     return full_ldq_code(env, addr, oi, 0);
 }
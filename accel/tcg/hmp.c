@@ -3,13 +3,29 @@
 #include "qapi/error.h"
 #include "qapi/qapi-commands-machine.h"
 #include "exec/exec-all.h"
+#include "monitor/hmp.h"
 #include "monitor/monitor.h"
+#include "qapi/qmp/qdict.h"
 #include "sysemu/tcg.h"
 
+static void hmp_info_tb_hot(Monitor *mon, const QDict *qdict)
+{
+    Error *err = NULL;
+    g_autoptr(HumanReadableText) info = NULL;
+
+    info = qmp_x_query_tb_hot(qdict_haskey(qdict, "count"),
+                              qdict_get_try_int(qdict, "count", 10), &err);
+    if (hmp_handle_error(mon, err)) {
+        return;
+    }
+    monitor_printf(mon, "%s", info->human_readable_text);
+}
+
 static void hmp_tcg_register(void)
 {
     monitor_register_hmp_info_hrt("jit", qmp_x_query_jit);
     monitor_register_hmp_info_hrt("opcount", qmp_x_query_opcount);
+    monitor_register_hmp("tb-hot", true, hmp_info_tb_hot);
 }
 
 type_init(hmp_tcg_register);
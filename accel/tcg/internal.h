@@ -19,4 +19,75 @@ void QEMU_NORETURN cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 void page_init(void);
 void tb_htable_init(void);
 
+extern unsigned int tb_jmp_cache_bits;
+#ifdef CONFIG_SOFTMMU
+extern unsigned int tlb_vtlb_size;
+#endif
+
+#ifdef CONFIG_SOFTMMU
+/*
+ * Translation ahead of execution, see tb-prefetch.c.  While a worker
+ * translates, tb_prefetch_page is the guest page it reads code from,
+ * as mapped in host memory.
+ */
+typedef struct TBPrefetchPage {
+    target_ulong addr;
+    const void *host;
+} TBPrefetchPage;
+
+#define TB_PREFETCH_WORKERS_MAX 8
+
+extern __thread const TBPrefetchPage *tb_prefetch_page;
+extern unsigned int tb_prefetch_workers;
+
+static inline bool tb_prefetch_enabled(void)
+{
+    return tb_prefetch_workers != 0;
+}
+
+void tb_prefetch_init(unsigned int max_cpus);
+void tb_prefetch_post(CPUState *cpu, TranslationBlock *tb,
+                      unsigned int write_gen);
+bool tb_prefetch_seed(CPUState *cpu, TranslationBlock *tb,
+                      unsigned int write_gen, const target_ulong *pcs, int n);
+void tb_prefetch_pause(void);
+void tb_prefetch_resume(void);
+
+TranslationBlock *tb_gen_code_prefetch(CPUState *cpu, target_ulong pc,
+                                       target_ulong cs_base, uint32_t flags,
+                                       int cflags, tb_page_addr_t phys_pc,
+                                       unsigned int write_gen);
+unsigned int tb_page_write_gen(tb_page_addr_t addr);
+
+/* The blocks translated in earlier runs, see tb-cache.c */
+extern char *tb_cache_path;
+
+static inline bool tb_cache_enabled(void)
+{
+    return tb_cache_path != NULL;
+}
+
+void tb_cache_init(void);
+void tb_cache_post(CPUState *cpu, TranslationBlock *tb,
+                   unsigned int write_gen);
+
+/* Sampling of the TBs the vCPUs run, see tb-sample.c */
+#define TB_SAMPLE_HZ_MAX 100000
+
+extern unsigned int tb_sample_hz;
+
+static inline bool tb_sample_enabled(void)
+{
+    return tb_sample_hz != 0;
+}
+
+void tb_sample_init(unsigned int max_cpus);
+void tb_sample_take(CPUState *cpu, TranslationBlock *tb);
+#else
+static inline void tb_prefetch_pause(void) { }
+static inline void tb_prefetch_resume(void) { }
+static inline bool tb_sample_enabled(void) { return false; }
+static inline void tb_sample_take(CPUState *cpu, TranslationBlock *tb) { }
+#endif
+
 #endif /* ACCEL_TCG_INTERNAL_H */
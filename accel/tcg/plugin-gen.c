@@ -41,6 +41,12 @@
  * optimization to avoid generating redundant operations. For instance, for the
  * second and all subsequent callbacks of an event, we do not need to reload the
  * CPU's index into a TCG temp, since the first callback did it already.
+ *
+ * Inline ops and conditional callbacks are not copied: their shape depends
+ * on the op, on whether they update a scoreboard entry and on the condition,
+ * so they are generated afresh with the usual tcg_gen_FOO calls, right after
+ * the empty callback they replace (see tcg_ctx->emit_before_op). Only the
+ * function pointer of a conditional callback gets patched, as above.
  */
 #include "qemu/osdep.h"
 #include "tcg/tcg.h"
@@ -123,21 +129,9 @@ static void gen_empty_udata_cb(void)
     tcg_temp_free_i32(cpu_index);
 }
 
-/*
- * For now we only support addi_i64.
- * When we support more ops, we can generate one empty inline cb for each.
- */
+/* Inline ops are generated from scratch, the empty cb only marks the spot */
 static void gen_empty_inline_cb(void)
 {
-    TCGv_i64 val = tcg_temp_new_i64();
-    TCGv_ptr ptr = tcg_const_ptr(NULL); /* overwritten later */
-
-    tcg_gen_ld_i64(val, ptr, 0);
-    /* pass an immediate != 0 so that it doesn't get optimized away */
-    tcg_gen_addi_i64(val, val, 0xdeadface);
-    tcg_gen_st_i64(val, ptr, 0);
-    tcg_temp_free_ptr(ptr);
-    tcg_temp_free_i64(val);
 }
 
 static void gen_empty_mem_cb(TCGv addr, uint32_t info)
@@ -325,19 +319,6 @@ static TCGOp *copy_extu_tl_i64(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
-static TCGOp *copy_ld_i64(TCGOp **begin_op, TCGOp *op)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* 2x ld_i32 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-        op = copy_op(begin_op, op, INDEX_op_ld_i32);
-    } else {
-        /* ld_i64 */
-        op = copy_op(begin_op, op, INDEX_op_ld_i64);
-    }
-    return op;
-}
-
 static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
 {
     if (TCG_TARGET_REG_BITS == 32) {
@@ -351,21 +332,6 @@ static TCGOp *copy_st_i64(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
-static TCGOp *copy_add_i64(TCGOp **begin_op, TCGOp *op, uint64_t v)
-{
-    if (TCG_TARGET_REG_BITS == 32) {
-        /* all 32-bit backends must implement add2_i32 */
-        g_assert(TCG_TARGET_HAS_add2_i32);
-        op = copy_op(begin_op, op, INDEX_op_add2_i32);
-        op->args[4] = tcgv_i32_arg(tcg_constant_i32(v));
-        op->args[5] = tcgv_i32_arg(tcg_constant_i32(v >> 32));
-    } else {
-        op = copy_op(begin_op, op, INDEX_op_add_i64);
-        op->args[2] = tcgv_i64_arg(tcg_constant_i64(v));
-    }
-    return op;
-}
-
 static TCGOp *copy_st_ptr(TCGOp **begin_op, TCGOp *op)
 {
     if (UINTPTR_MAX == UINT32_MAX) {
@@ -378,6 +344,22 @@ static TCGOp *copy_st_ptr(TCGOp **begin_op, TCGOp *op)
     return op;
 }
 
+static int find_call_func_idx(const TCGOp *op, void *empty_func)
+{
+    int i;
+
+    /*
+     * Instead of working out the position of the callback in args[], just
+     * look for @empty_func, since it should be a unique pointer.
+     */
+    for (i = 0; i < MAX_OPC_PARAM_ARGS; i++) {
+        if ((uintptr_t)op->args[i] == (uintptr_t)empty_func) {
+            return i;
+        }
+    }
+    g_assert_not_reached();
+}
+
 static TCGOp *copy_call(TCGOp **begin_op, TCGOp *op, void *empty_func,
                         void *func, int *cb_idx)
 {
@@ -391,19 +373,7 @@ static TCGOp *copy_call(TCGOp **begin_op, TCGOp *op, void *empty_func,
     op->param2 = (*begin_op)->param2;
     tcg_debug_assert(op->life == 0);
     if (*cb_idx == -1) {
-        int i;
-
-        /*
-         * Instead of working out the position of the callback in args[], just
-         * look for @empty_func, since it should be a unique pointer.
-         */
-        for (i = 0; i < MAX_OPC_PARAM_ARGS; i++) {
-            if ((uintptr_t)(*begin_op)->args[i] == (uintptr_t)empty_func) {
-                *cb_idx = i;
-                break;
-            }
-        }
-        tcg_debug_assert(i < MAX_OPC_PARAM_ARGS);
+        *cb_idx = find_call_func_idx(*begin_op, empty_func);
     }
     op->args[*cb_idx] = (uintptr_t)func;
     op->args[*cb_idx + 1] = (*begin_op)->args[*cb_idx + 1];
@@ -438,23 +408,149 @@ static TCGOp *append_udata_cb(const struct qemu_plugin_dyn_cb *cb,
     return op;
 }
 
+/*
+ * Start generating ops right after @op, instead of at the end of the
+ * op list. gen_after_end() stops it and returns the last op generated.
+ */
+static TCGOp *gen_after_start(TCGOp *op)
+{
+    tcg_debug_assert(tcg_ctx->emit_before_op == NULL);
+    tcg_ctx->emit_before_op = QTAILQ_NEXT(op, link);
+    return tcg_ctx->emit_before_op;
+}
+
+static TCGOp *gen_after_end(TCGOp *next)
+{
+    tcg_ctx->emit_before_op = NULL;
+    if (next) {
+        return QTAILQ_PREV(next, link);
+    }
+    return QTAILQ_LAST(&tcg_ctx->ops);
+}
+
+/*
+ * Return a temp with the address of the executing vCPU's copy of @entry.
+ * The entries may move when vCPUs get added, so their base address is
+ * read from the scoreboard every time.
+ */
+static TCGv_ptr gen_plugin_u64_ptr(qemu_plugin_u64 entry)
+{
+    struct qemu_plugin_scoreboard *score = entry.score;
+    TCGv_ptr ptr = tcg_const_ptr(&score->data);
+    TCGv_i32 cpu_index = tcg_temp_new_i32();
+    TCGv_ptr offset = tcg_temp_new_ptr();
+
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    tcg_gen_muli_i32(cpu_index, cpu_index, score->stride);
+    tcg_gen_ext_i32_ptr(offset, cpu_index);
+
+    tcg_gen_ld_ptr(ptr, ptr, 0);
+    tcg_gen_add_ptr(ptr, ptr, offset);
+    tcg_gen_addi_ptr(ptr, ptr, entry.offset);
+
+    tcg_temp_free_ptr(offset);
+    tcg_temp_free_i32(cpu_index);
+    return ptr;
+}
+
+static void gen_inline_op(const struct qemu_plugin_dyn_cb *cb)
+{
+    TCGv_i64 val = tcg_temp_new_i64();
+    TCGv_ptr ptr;
+
+    if (cb->inline_insn.entry.score) {
+        ptr = gen_plugin_u64_ptr(cb->inline_insn.entry);
+    } else {
+        ptr = tcg_const_ptr(cb->userp);
+    }
+
+    switch (cb->inline_insn.op) {
+    case QEMU_PLUGIN_INLINE_ADD_U64:
+        tcg_gen_ld_i64(val, ptr, 0);
+        tcg_gen_addi_i64(val, val, cb->inline_insn.imm);
+        tcg_gen_st_i64(val, ptr, 0);
+        break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        tcg_gen_movi_i64(val, cb->inline_insn.imm);
+        tcg_gen_st_i64(val, ptr, 0);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(ptr);
+}
+
 static TCGOp *append_inline_cb(const struct qemu_plugin_dyn_cb *cb,
                                TCGOp *begin_op, TCGOp *op,
                                int *unused)
 {
-    /* const_ptr */
-    op = copy_const_ptr(&begin_op, op, cb->userp);
+    TCGOp *next = gen_after_start(op);
 
-    /* ld_i64 */
-    op = copy_ld_i64(&begin_op, op);
+    gen_inline_op(cb);
+    return gen_after_end(next);
+}
 
-    /* add_i64 */
-    op = copy_add_i64(&begin_op, op, cb->inline_insn.imm);
+static TCGCond plugin_cond_to_tcgcond(enum qemu_plugin_cond cond)
+{
+    switch (cond) {
+    case QEMU_PLUGIN_COND_EQ:
+        return TCG_COND_EQ;
+    case QEMU_PLUGIN_COND_NE:
+        return TCG_COND_NE;
+    case QEMU_PLUGIN_COND_LT:
+        return TCG_COND_LTU;
+    case QEMU_PLUGIN_COND_LE:
+        return TCG_COND_LEU;
+    case QEMU_PLUGIN_COND_GT:
+        return TCG_COND_GTU;
+    case QEMU_PLUGIN_COND_GE:
+        return TCG_COND_GEU;
+    default:
+        /* NEVER and ALWAYS are dealt with at registration */
+        g_assert_not_reached();
+    }
+}
 
-    /* st_i64 */
-    op = copy_st_i64(&begin_op, op);
+/*
+ * Branch over the call unless the condition holds. The callback sits
+ * at the start of a guest instruction or TB, where the translators hold
+ * no values in temps, so ending the basic block here is harmless.
+ */
+static TCGOp *append_cond_udata_cb(const struct qemu_plugin_dyn_cb *cb,
+                                   TCGOp *op)
+{
+    TCGOp *next = gen_after_start(op);
+    TCGLabel *skip = gen_new_label();
+    TCGv_ptr ptr = gen_plugin_u64_ptr(cb->cond.entry);
+    TCGv_i64 val = tcg_temp_new_i64();
+    TCGv_i32 cpu_index;
+    TCGv_ptr udata;
+    TCGOp *call;
 
-    return op;
+    tcg_gen_ld_i64(val, ptr, 0);
+    tcg_gen_brcondi_i64(tcg_invert_cond(plugin_cond_to_tcgcond(cb->cond.cond)),
+                        val, cb->cond.imm, skip);
+    tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(ptr);
+
+    cpu_index = tcg_temp_new_i32();
+    udata = tcg_const_ptr(cb->userp);
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_vcpu_udata_cb(cpu_index, udata);
+    tcg_temp_free_ptr(udata);
+    tcg_temp_free_i32(cpu_index);
+
+    call = next ? QTAILQ_PREV(next, link) : QTAILQ_LAST(&tcg_ctx->ops);
+    tcg_debug_assert(call->opc == INDEX_op_call);
+    call->args[find_call_func_idx(call, HELPER(plugin_vcpu_udata_cb))] =
+        (uintptr_t)cb->f.vcpu_udata;
+
+    gen_set_label(skip);
+    return gen_after_end(next);
 }
 
 static TCGOp *append_mem_cb(const struct qemu_plugin_dyn_cb *cb,
@@ -536,10 +632,34 @@ static void inject_cb_type(const GArray *cbs, TCGOp *begin_op,
     rm_ops_range(begin_op, end_op);
 }
 
+/* regular callbacks first, then the conditional ones */
 static void
-inject_udata_cb(const GArray *cbs, TCGOp *begin_op)
+inject_udata_cb(const GArray *cbs, const GArray *cond_cbs, TCGOp *begin_op)
 {
-    inject_cb_type(cbs, begin_op, append_udata_cb, op_ok);
+    TCGOp *end_op;
+    TCGOp *op;
+    int cb_idx = -1;
+    int i;
+
+    if (!cond_cbs || cond_cbs->len == 0) {
+        inject_cb_type(cbs, begin_op, append_udata_cb, op_ok);
+        return;
+    }
+
+    end_op = find_op(begin_op, INDEX_op_plugin_cb_end);
+    tcg_debug_assert(end_op);
+
+    op = end_op;
+    for (i = 0; cbs && i < cbs->len; i++) {
+        op = append_udata_cb(&g_array_index(cbs, struct qemu_plugin_dyn_cb, i),
+                             begin_op, op, &cb_idx);
+    }
+    for (i = 0; i < cond_cbs->len; i++) {
+        op = append_cond_udata_cb(&g_array_index(cond_cbs,
+                                                 struct qemu_plugin_dyn_cb, i),
+                                  op);
+    }
+    rm_ops_range(begin_op, end_op);
 }
 
 static void
@@ -646,7 +766,8 @@ void plugin_gen_disable_mem_helpers(void)
 static void plugin_gen_tb_udata(const struct qemu_plugin_tb *ptb,
                                 TCGOp *begin_op)
 {
-    inject_udata_cb(ptb->cbs[PLUGIN_CB_REGULAR], begin_op);
+    inject_udata_cb(ptb->cbs[PLUGIN_CB_REGULAR], ptb->cbs[PLUGIN_CB_COND],
+                    begin_op);
 }
 
 static void plugin_gen_tb_inline(const struct qemu_plugin_tb *ptb,
@@ -660,7 +781,8 @@ static void plugin_gen_insn_udata(const struct qemu_plugin_tb *ptb,
 {
     struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
 
-    inject_udata_cb(insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_REGULAR], begin_op);
+    inject_udata_cb(insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_REGULAR],
+                    insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_COND], begin_op);
 }
 
 static void plugin_gen_insn_inline(const struct qemu_plugin_tb *ptb,
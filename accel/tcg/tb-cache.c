@@ -0,0 +1,591 @@
+/*
+ * Blocks translated in earlier runs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * With "-accel tcg,tb-cache=FILE", the TBs that the vCPUs translated,
+ * and that are still valid on exit, are written to FILE: the contents
+ * of each guest page that has some, and the pc, cs_base, flags and
+ * cflags of its TBs.  The next run maps FILE.  The first time a vCPU
+ * translates a TB in a page whose contents are those of a page of FILE,
+ * the other blocks of that page with the same flags are handed to the
+ * tb-prefetch workers, see tb_prefetch_seed(), rather than being
+ * translated by the vCPU when it gets to them.
+ *
+ * Host code is not saved: it has the addresses of helpers and of the
+ * code buffer built in, which change from run to run, and jumps between
+ * TBs are patched in place without a record of it.  The blocks are
+ * translated again from the guest code in memory, so FILE only tells
+ * where they start: the TBs are the same whatever FILE contains, and
+ * are invalidated by writes to their page like any other.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/crc32c.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+#include "qemu/rcu.h"
+#include "qemu/xxhash.h"
+#include "cpu.h"
+#include "exec/exec-all.h"
+#include "exec/memory.h"
+#include "sysemu/sysemu.h"
+#include "tcg/tcg.h"
+#include "tb-hash.h"
+#include "tb-context.h"
+#include "internal.h"
+
+#define TB_CACHE_MAGIC "QEMUTBC"
+#define TB_CACHE_VERSION 1
+
+/* TBs recorded at most before those since invalidated are dropped */
+#define TB_CACHE_RECORDS_MAX (1 << 19)
+
+typedef struct TBCacheHeader {
+    char magic[8];
+    /* Also tells that the file comes from a host of the same endianness */
+    uint32_t version;
+    uint32_t page_size;
+    char target[16];
+    char cpu_type[64];
+    uint32_t nb_pages;
+    uint32_t nb_entries;
+} TBCacheHeader;
+
+/*
+ * The pages follow the header, sorted by hash, then the entries, then
+ * the contents of the pages.
+ */
+typedef struct TBCachePage {
+    uint32_t hash;
+    uint32_t first;
+    uint32_t count;
+    uint32_t reserved;
+} TBCachePage;
+
+typedef struct TBCacheEntry {
+    uint64_t pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+} TBCacheEntry;
+
+QEMU_BUILD_BUG_ON(sizeof(TBCacheHeader) % 8);
+QEMU_BUILD_BUG_ON(sizeof(TBCachePage) % 8);
+
+/* A TB translated by a vCPU in this run */
+typedef struct TBCacheRecord {
+    tb_page_addr_t phys_page;
+    uint32_t trace_vcpu_dstate;
+    TBCacheEntry e;
+} TBCacheRecord;
+
+/* The state of a page when its blocks were last looked up */
+typedef struct TBCacheLookup {
+    uint32_t flags;
+    unsigned int write_gen;
+    unsigned int flush_count;
+} TBCacheLookup;
+
+/* A page to save, from this run or from the file */
+typedef struct TBCacheOut {
+    uint32_t hash;
+    uint32_t first;
+    uint32_t count;
+    const TBCacheEntry *entries;
+    const uint8_t *data;
+} TBCacheOut;
+
+char *tb_cache_path;
+
+/* Protects everything below */
+static QemuMutex tb_cache_lock;
+
+/* The file of the earlier run */
+static char tb_cache_cpu_type[64];
+static const TBCachePage *tb_cache_pages;
+static const TBCacheEntry *tb_cache_entries;
+static const uint8_t *tb_cache_data;
+static uint32_t tb_cache_nb_pages;
+static bool tb_cache_cpu_checked;
+
+/* TBCacheRecord set, and TBCacheLookup by page frame */
+static GHashTable *tb_cache_records;
+static GHashTable *tb_cache_lookups;
+/* The flush the records are from, and whether no more fit until the next */
+static unsigned int tb_cache_records_flush_count;
+static bool tb_cache_records_full;
+
+static Notifier tb_cache_exit_notifier;
+
+static guint tb_cache_record_hash(gconstpointer p)
+{
+    const TBCacheRecord *r = p;
+
+    return qemu_xxhash6(r->e.pc, r->phys_page, r->e.flags, r->e.cflags);
+}
+
+static gboolean tb_cache_record_equal(gconstpointer a, gconstpointer b)
+{
+    const TBCacheRecord *ra = a, *rb = b;
+
+    return ra->phys_page == rb->phys_page && ra->e.pc == rb->e.pc &&
+           ra->e.cs_base == rb->e.cs_base && ra->e.flags == rb->e.flags &&
+           ra->e.cflags == rb->e.cflags &&
+           ra->trace_vcpu_dstate == rb->trace_vcpu_dstate;
+}
+
+static uint32_t tb_cache_page_hash(const void *data)
+{
+    return crc32c(0xffffffff, data, TARGET_PAGE_SIZE);
+}
+
+/* The index of the first page of the file with @hash, or above */
+static uint32_t tb_cache_search(uint32_t hash)
+{
+    uint32_t lo = 0, hi = tb_cache_nb_pages;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (tb_cache_pages[mid].hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Forget the file if it was written for other vCPUs */
+static void tb_cache_check_cpu(CPUState *cpu)
+{
+    const char *cpu_type = object_get_typename(OBJECT(cpu));
+
+    tb_cache_cpu_checked = true;
+    if (strncmp(tb_cache_cpu_type, cpu_type, sizeof(tb_cache_cpu_type))) {
+        warn_report("tb-cache: '%s' was written for CPU type %s, not %s",
+                    tb_cache_path, tb_cache_cpu_type, cpu_type);
+        tb_cache_nb_pages = 0;
+    }
+}
+
+/* Hand the blocks that the file has for the page of @tb to tb-prefetch */
+static void tb_cache_lookup(CPUState *cpu, TranslationBlock *tb,
+                            unsigned int write_gen)
+{
+    gpointer frame = GSIZE_TO_POINTER(tb->page_addr[0] >> TARGET_PAGE_BITS);
+    unsigned int flush_count = qatomic_mb_read(&tb_ctx.tb_flush_count);
+    target_ulong page = tb->pc & TARGET_PAGE_MASK;
+    g_autoptr(GArray) pcs = g_array_new(false, false, sizeof(target_ulong));
+    TBCacheLookup *l = g_hash_table_lookup(tb_cache_lookups, frame);
+    uint32_t hash, i, j;
+
+    if (l && l->flags == tb->flags && l->write_gen == write_gen &&
+        l->flush_count == flush_count) {
+        return;
+    }
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        const void *host = qemu_map_ram_ptr(NULL, tb->page_addr[0]);
+
+        hash = tb_cache_page_hash(host);
+        for (i = tb_cache_search(hash);
+             i < tb_cache_nb_pages && tb_cache_pages[i].hash == hash; i++) {
+            const TBCachePage *p = &tb_cache_pages[i];
+
+            if (memcmp(host, tb_cache_data + (size_t)i * TARGET_PAGE_SIZE,
+                       TARGET_PAGE_SIZE)) {
+                continue;
+            }
+            for (j = p->first; j < p->first + p->count; j++) {
+                const TBCacheEntry *e = &tb_cache_entries[j];
+                target_ulong pc = e->pc;
+
+                if ((pc & TARGET_PAGE_MASK) == page && pc != tb->pc &&
+                    e->cs_base == tb->cs_base && e->flags == tb->flags &&
+                    e->cflags == tb_cflags(tb)) {
+                    g_array_append_val(pcs, pc);
+                }
+            }
+            qatomic_inc(&tb_ctx.tb_cache_hit_count);
+            break;
+        }
+    }
+
+    if (pcs->len &&
+        !tb_prefetch_seed(cpu, tb, write_gen, (target_ulong *)pcs->data,
+                          pcs->len)) {
+        /* Try again with the next TB in the page */
+        return;
+    }
+    qatomic_add(&tb_ctx.tb_cache_seed_count, pcs->len);
+
+    if (!l) {
+        l = g_new(TBCacheLookup, 1);
+        g_hash_table_insert(tb_cache_lookups, frame, l);
+    }
+    l->flags = tb->flags;
+    l->write_gen = write_gen;
+    l->flush_count = flush_count;
+}
+
+static bool tb_cache_cmp(const void *p, const void *d)
+{
+    const TranslationBlock *tb = p;
+    const TBCacheRecord *r = d;
+
+    return tb->pc == r->e.pc &&
+           tb->page_addr[0] == r->phys_page &&
+           tb->page_addr[1] == -1 &&
+           tb->cs_base == r->e.cs_base &&
+           tb->flags == r->e.flags &&
+           tb->trace_vcpu_dstate == r->trace_vcpu_dstate &&
+           tb_cflags(tb) == r->e.cflags;
+}
+
+/*
+ * Is the TB of @r still in the hash table, i.e. not invalidated?  Called
+ * within an RCU read-side critical section, see qht_lookup_custom().
+ */
+static bool tb_cache_valid(const TBCacheRecord *r)
+{
+    tb_page_addr_t phys_pc = r->phys_page | (r->e.pc & ~TARGET_PAGE_MASK);
+    uint32_t h = tb_hash_func(phys_pc, r->e.pc, r->e.flags, r->e.cflags,
+                              r->trace_vcpu_dstate);
+
+    return qht_lookup_custom(&tb_ctx.htable, r, h, tb_cache_cmp);
+}
+
+static gboolean tb_cache_invalid(gpointer key, gpointer value, gpointer data)
+{
+    return !tb_cache_valid(key);
+}
+
+static void tb_cache_record(TranslationBlock *tb)
+{
+    unsigned int flush_count = qatomic_mb_read(&tb_ctx.tb_flush_count);
+    TBCacheRecord key = { }, *r;
+    guint size;
+
+    if (flush_count != tb_cache_records_flush_count) {
+        /* None of the TBs recorded so far is left */
+        g_hash_table_remove_all(tb_cache_records);
+        tb_cache_records_flush_count = flush_count;
+        tb_cache_records_full = false;
+    }
+
+    key.phys_page = tb->page_addr[0];
+    key.trace_vcpu_dstate = tb->trace_vcpu_dstate;
+    key.e.pc = tb->pc;
+    key.e.cs_base = tb->cs_base;
+    key.e.flags = tb->flags;
+    key.e.cflags = tb_cflags(tb);
+
+    if (tb_cache_records_full ||
+        g_hash_table_contains(tb_cache_records, &key)) {
+        return;
+    }
+
+    size = g_hash_table_size(tb_cache_records);
+    if (size >= TB_CACHE_RECORDS_MAX) {
+        WITH_RCU_READ_LOCK_GUARD() {
+            g_hash_table_foreach_remove(tb_cache_records, tb_cache_invalid,
+                                        NULL);
+        }
+        /* Not worth sweeping again for a handful of TBs */
+        if (g_hash_table_size(tb_cache_records) >
+            TB_CACHE_RECORDS_MAX - TB_CACHE_RECORDS_MAX / 4) {
+            tb_cache_records_full = true;
+            return;
+        }
+    }
+
+    r = g_new(TBCacheRecord, 1);
+    *r = key;
+    g_hash_table_add(tb_cache_records, r);
+}
+
+/*
+ * Note @tb, just translated by @cpu, to be saved on exit, and queue the
+ * blocks that the file knows in its page.  @write_gen is the write
+ * generation of the page of @tb from before it was translated.
+ */
+void tb_cache_post(CPUState *cpu, TranslationBlock *tb,
+                   unsigned int write_gen)
+{
+    /* The same conditions as translating ahead, see tb_prefetch_post() */
+    if (tb->page_addr[1] != -1 || tcg_ctx->tb_cpu_state ||
+        tb_cflags(tb) != curr_cflags(cpu) ||
+        !QTAILQ_EMPTY(&cpu->breakpoints)) {
+        return;
+    }
+
+    qemu_mutex_lock(&tb_cache_lock);
+    tb_cache_record(tb);
+    if (tb_cache_nb_pages && !tb_cache_cpu_checked) {
+        tb_cache_check_cpu(cpu);
+    }
+    if (tb_cache_nb_pages) {
+        tb_cache_lookup(cpu, tb, write_gen);
+    }
+    qemu_mutex_unlock(&tb_cache_lock);
+}
+
+static gint tb_cache_record_cmp(gconstpointer a, gconstpointer b)
+{
+    const TBCacheRecord *ra = *(const TBCacheRecord **)a;
+    const TBCacheRecord *rb = *(const TBCacheRecord **)b;
+
+    return ra->phys_page < rb->phys_page ? -1 : ra->phys_page > rb->phys_page;
+}
+
+static gint tb_cache_out_cmp(gconstpointer a, gconstpointer b)
+{
+    const TBCacheOut *oa = a, *ob = b;
+
+    return oa->hash < ob->hash ? -1 : oa->hash > ob->hash;
+}
+
+/* Do the @n pages at @o, sorted by hash, have one with contents @data? */
+static bool tb_cache_out_has(const TBCacheOut *o, uint32_t n, uint32_t hash,
+                             const uint8_t *data)
+{
+    const TBCacheOut key = { .hash = hash };
+    const TBCacheOut *found;
+
+    found = bsearch(&key, o, n, sizeof(*o), tb_cache_out_cmp);
+    if (!found) {
+        return false;
+    }
+    while (found > o && found[-1].hash == hash) {
+        found--;
+    }
+    for (; found < o + n && found->hash == hash; found++) {
+        if (!memcmp(found->data, data, TARGET_PAGE_SIZE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Write the pages of the valid TBs of this run, and those of the file
+ * that this run did not see, to tb_cache_path.
+ */
+static void tb_cache_save(Notifier *n, void *unused)
+{
+    g_autoptr(GPtrArray) records = g_ptr_array_new();
+    g_autoptr(GArray) out = g_array_new(false, false, sizeof(TBCacheOut));
+    g_autoptr(GArray) entries = g_array_new(false, false,
+                                            sizeof(TBCacheEntry));
+    g_autoptr(GByteArray) data = g_byte_array_new();
+    g_autoptr(GByteArray) buf = g_byte_array_new();
+    g_autoptr(GError) err = NULL;
+    TBCacheHeader h = { };
+    GHashTableIter iter;
+    gpointer key;
+    uint32_t i, j, nb_new, first;
+
+    if (!first_cpu) {
+        return;
+    }
+
+    qemu_mutex_lock(&tb_cache_lock);
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        g_hash_table_iter_init(&iter, tb_cache_records);
+        while (g_hash_table_iter_next(&iter, &key, NULL)) {
+            if (tb_cache_valid(key)) {
+                g_ptr_array_add(records, key);
+            }
+        }
+        g_ptr_array_sort(records, tb_cache_record_cmp);
+
+        /* The pages of this run; their entries and contents are copied */
+        for (i = 0; i < records->len; i = j) {
+            const TBCacheRecord *r = g_ptr_array_index(records, i);
+            TBCacheOut o = { .first = entries->len };
+
+            for (j = i; j < records->len; j++) {
+                const TBCacheRecord *rj = g_ptr_array_index(records, j);
+
+                if (rj->phys_page != r->phys_page) {
+                    break;
+                }
+                g_array_append_val(entries, rj->e);
+                o.count++;
+            }
+            g_byte_array_append(data, qemu_map_ram_ptr(NULL, r->phys_page),
+                                TARGET_PAGE_SIZE);
+            g_array_append_val(out, o);
+        }
+    }
+    /* Now that the arrays are complete, point into them */
+    for (i = 0; i < out->len; i++) {
+        TBCacheOut *o = &g_array_index(out, TBCacheOut, i);
+
+        o->entries = &g_array_index(entries, TBCacheEntry, o->first);
+        o->data = data->data + (size_t)i * TARGET_PAGE_SIZE;
+        o->hash = tb_cache_page_hash(o->data);
+    }
+    g_array_sort(out, tb_cache_out_cmp);
+
+    /* The pages of the file that this run did not have */
+    nb_new = out->len;
+    for (i = 0; i < tb_cache_nb_pages; i++) {
+        const TBCachePage *p = &tb_cache_pages[i];
+        const uint8_t *page_data = tb_cache_data + (size_t)i * TARGET_PAGE_SIZE;
+        TBCacheOut o = {
+            .hash = p->hash,
+            .count = p->count,
+            .entries = &tb_cache_entries[p->first],
+            .data = page_data,
+        };
+
+        if (!tb_cache_out_has((const TBCacheOut *)out->data, nb_new,
+                              p->hash, page_data)) {
+            g_array_append_val(out, o);
+        }
+    }
+    g_array_sort(out, tb_cache_out_cmp);
+
+    memcpy(h.magic, TB_CACHE_MAGIC, sizeof(h.magic));
+    h.version = TB_CACHE_VERSION;
+    h.page_size = TARGET_PAGE_SIZE;
+    pstrcpy(h.target, sizeof(h.target), TARGET_NAME);
+    pstrcpy(h.cpu_type, sizeof(h.cpu_type),
+            object_get_typename(OBJECT(first_cpu)));
+    h.nb_pages = out->len;
+    for (i = 0; i < out->len; i++) {
+        h.nb_entries += g_array_index(out, TBCacheOut, i).count;
+    }
+    g_byte_array_append(buf, (const guint8 *)&h, sizeof(h));
+
+    first = 0;
+    for (i = 0; i < out->len; i++) {
+        const TBCacheOut *o = &g_array_index(out, TBCacheOut, i);
+        TBCachePage p = {
+            .hash = o->hash,
+            .first = first,
+            .count = o->count,
+        };
+
+        g_byte_array_append(buf, (const guint8 *)&p, sizeof(p));
+        first += o->count;
+    }
+    for (i = 0; i < out->len; i++) {
+        const TBCacheOut *o = &g_array_index(out, TBCacheOut, i);
+
+        g_byte_array_append(buf, (const guint8 *)o->entries,
+                            o->count * sizeof(TBCacheEntry));
+    }
+    for (i = 0; i < out->len; i++) {
+        g_byte_array_append(buf, g_array_index(out, TBCacheOut, i).data,
+                            TARGET_PAGE_SIZE);
+    }
+
+    qemu_mutex_unlock(&tb_cache_lock);
+
+    /* Written to a new file: the old one stays mapped until exit */
+    if (!g_file_set_contents(tb_cache_path, (const gchar *)buf->data,
+                             buf->len, &err)) {
+        warn_report("tb-cache: %s", err->message);
+    }
+}
+
+static bool tb_cache_load(const uint8_t *map, size_t size)
+{
+    const TBCacheHeader *h = (const TBCacheHeader *)map;
+    uint64_t pages_off, entries_off, data_off;
+    uint32_t i;
+
+    if (size < sizeof(*h) ||
+        memcmp(h->magic, TB_CACHE_MAGIC, sizeof(h->magic)) ||
+        h->version != TB_CACHE_VERSION) {
+        warn_report("tb-cache: '%s' is not a translation cache file",
+                    tb_cache_path);
+        return false;
+    }
+    if (h->page_size != TARGET_PAGE_SIZE ||
+        strncmp(h->target, TARGET_NAME, sizeof(h->target))) {
+        warn_report("tb-cache: '%s' was written for another target",
+                    tb_cache_path);
+        return false;
+    }
+
+    pages_off = sizeof(*h);
+    entries_off = pages_off + (uint64_t)h->nb_pages * sizeof(TBCachePage);
+    data_off = entries_off + (uint64_t)h->nb_entries * sizeof(TBCacheEntry);
+    if (data_off + (uint64_t)h->nb_pages * TARGET_PAGE_SIZE > size) {
+        warn_report("tb-cache: '%s' is truncated", tb_cache_path);
+        return false;
+    }
+
+    tb_cache_pages = (const TBCachePage *)(map + pages_off);
+    tb_cache_entries = (const TBCacheEntry *)(map + entries_off);
+    tb_cache_data = map + data_off;
+    for (i = 0; i < h->nb_pages; i++) {
+        const TBCachePage *p = &tb_cache_pages[i];
+
+        if ((uint64_t)p->first + p->count > h->nb_entries ||
+            (i && p->hash < tb_cache_pages[i - 1].hash)) {
+            warn_report("tb-cache: '%s' is corrupt", tb_cache_path);
+            return false;
+        }
+    }
+
+    memcpy(tb_cache_cpu_type, h->cpu_type, sizeof(tb_cache_cpu_type));
+    tb_cache_cpu_type[sizeof(tb_cache_cpu_type) - 1] = 0;
+    tb_cache_nb_pages = h->nb_pages;
+    return true;
+}
+
+void tb_cache_init(void)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (!tb_cache_enabled()) {
+        return;
+    }
+
+    qemu_mutex_init(&tb_cache_lock);
+    tb_cache_records = g_hash_table_new_full(tb_cache_record_hash,
+                                             tb_cache_record_equal,
+                                             g_free, NULL);
+    tb_cache_lookups = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    tb_cache_exit_notifier.notify = tb_cache_save;
+    qemu_add_exit_notifier(&tb_cache_exit_notifier);
+
+    fd = qemu_open_old(tb_cache_path, O_RDONLY);
+    if (fd < 0) {
+        /* No file yet, this run writes it */
+        if (errno != ENOENT) {
+            warn_report("tb-cache: cannot open '%s': %s", tb_cache_path,
+                        strerror(errno));
+        }
+        return;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        warn_report("tb-cache: cannot map '%s': %s", tb_cache_path,
+                    strerror(errno));
+        return;
+    }
+    if (!tb_cache_load(map, st.st_size)) {
+        munmap(map, st.st_size);
+        tb_cache_pages = NULL;
+        tb_cache_entries = NULL;
+        tb_cache_data = NULL;
+    }
+}
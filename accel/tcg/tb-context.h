@@ -34,7 +34,20 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_flush_nonstop_count; /* of which without stopping vCPUs */
     unsigned tb_phys_invalidate_count;
+    unsigned tb_evict_count;        /* code buffer regions evicted */
+    unsigned tb_evict_tb_count;     /* TBs invalidated by those */
+    unsigned tb_evict_stall_count;  /* translations waiting for a region */
+    unsigned tb_prefetch_count;     /* TBs translated ahead of execution */
+    unsigned tb_prefetch_found_count; /* successors already translated */
+    unsigned tb_prefetch_abort_count; /* translations ahead given up */
+    unsigned tb_cache_hit_count;    /* pages found in the tb-cache file */
+    unsigned tb_cache_seed_count;   /* blocks queued from those */
+    unsigned tb_smc_write_count;    /* writes checked against code pages */
+    unsigned tb_smc_invalidate_count; /* TBs invalidated by writes */
+    unsigned tb_smc_protect_count;  /* pages protected, flushing the TLBs */
+    unsigned tb_smc_kept_count;     /* pages given code while kept so */
 };
 
 extern TBContext tb_ctx;
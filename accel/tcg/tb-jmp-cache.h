@@ -0,0 +1,92 @@
+/*
+ * The per-CPU TB jump cache.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef ACCEL_TCG_TB_JMP_CACHE_H
+#define ACCEL_TCG_TB_JMP_CACHE_H
+
+#include "exec/exec-all.h"
+#include "tb-hash.h"
+
+/*
+ * The cache maps a virtual PC to the TB last executed there, in front of
+ * the global TB hash table.  It is set associative: each set holds
+ * TB_JMP_CACHE_WAYS entries, most recently used first.
+ *
+ * It is only ever filled and searched by the vCPU thread that owns it.
+ * Other threads may clear the tb field of an entry (tb_phys_invalidate),
+ * so that field is accessed atomically.
+ *
+ * An entry is tagged with the generation it was last validated in.  A
+ * TLB flush starts a new generation rather than clearing the cache:
+ * older entries are used again once the guest physical pages of their
+ * TB are found to be still mapped at the same virtual address.
+ */
+
+static inline unsigned int tb_jmp_cache_set_bits(CPUState *cpu)
+{
+    return cpu->tb_jmp_cache_bits - TB_JMP_CACHE_WAYS_BITS;
+}
+
+static inline TBJmpCacheEntry *tb_jmp_cache_set(CPUState *cpu,
+                                                target_ulong pc)
+{
+    unsigned int set = tb_jmp_cache_hash_func(pc, tb_jmp_cache_set_bits(cpu));
+
+    return &cpu->tb_jmp_cache[set << TB_JMP_CACHE_WAYS_BITS];
+}
+
+/* Make TB the most recently used entry of SET, moving down the WAY first. */
+static inline void tb_jmp_cache_promote(CPUState *cpu, TBJmpCacheEntry *set,
+                                        int way, TranslationBlock *tb)
+{
+    for (; way > 0; way--) {
+        set[way].pc = set[way - 1].pc;
+        set[way].gen = set[way - 1].gen;
+        qatomic_set(&set[way].tb, qatomic_read(&set[way - 1].tb));
+    }
+    set[0].pc = tb->pc;
+    set[0].gen = cpu->tb_jmp_cache_gen;
+    qatomic_set(&set[0].tb, tb);
+}
+
+static inline void tb_jmp_cache_insert(CPUState *cpu, TranslationBlock *tb)
+{
+    tb_jmp_cache_promote(cpu, tb_jmp_cache_set(cpu, tb->pc),
+                         TB_JMP_CACHE_WAYS - 1, tb);
+}
+
+/* Drop TB from the cache of CPU, which may belong to another thread. */
+static inline void tb_jmp_cache_remove(CPUState *cpu, TranslationBlock *tb)
+{
+    TBJmpCacheEntry *set;
+    int way;
+
+    if (!cpu->tb_jmp_cache) {
+        return;
+    }
+    set = tb_jmp_cache_set(cpu, tb->pc);
+    for (way = 0; way < TB_JMP_CACHE_WAYS; way++) {
+        if (qatomic_read(&set[way].tb) == tb) {
+            qatomic_set(&set[way].tb, NULL);
+        }
+    }
+}
+
+/* The mapping of the guest address space may have changed. */
+static inline void tb_jmp_cache_new_gen(CPUState *cpu)
+{
+    uint32_t gen = cpu->tb_jmp_cache_gen + 1;
+
+    /* The return stack is small enough not to bother with generations. */
+    cpu_tb_ret_stack_clear(cpu);
+    if (unlikely(gen == 0)) {
+        /* Wrapped around: tags of old entries could look current. */
+        cpu_tb_jmp_cache_clear(cpu);
+    }
+    cpu->tb_jmp_cache_gen = gen;
+}
+
+#endif /* ACCEL_TCG_TB_JMP_CACHE_H */
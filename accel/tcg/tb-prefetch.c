@@ -0,0 +1,422 @@
+/*
+ * Translation of code ahead of its execution
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * With "-accel tcg,tb-prefetch=n", each TB a vCPU translates is handed
+ * to one of n worker threads along with a copy of the vCPU.  While the
+ * vCPU runs the TB, the worker translates the blocks it jumps to
+ * directly, and then theirs, so that the vCPU finds them in the hash
+ * table instead of translating them itself.
+ *
+ * Direct jumps only go to the page of the TB, see translator_use_goto_tb(),
+ * and the worker only reads code from that page, straight from the host
+ * memory behind it.  A TB is given up if the page is written to while
+ * it is translated, see tb_link_page(), or if the translator reads
+ * code from another page, see cpu_ldub_code().
+ *
+ * Each vCPU has a second queue for the blocks that tb-cache.c knows
+ * from an earlier run to start in the page of the TB.  It is not
+ * replaced by the next TB, but only refilled once it is empty.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/main-loop.h"
+#include "qemu/rcu.h"
+#include "qemu/thread.h"
+#include "qemu/log.h"
+#include "cpu.h"
+#include "exec/exec-all.h"
+#include "exec/memory.h"
+#include "hw/core/tcg-cpu-ops.h"
+#include "tcg/tcg.h"
+#include "tb-hash.h"
+#include "tb-context.h"
+#include "internal.h"
+
+/* Successors pending per vCPU, and how far to follow them */
+#define TB_PREFETCH_QUEUE 8
+#define TB_PREFETCH_DEPTH 4
+/* Blocks from tb-cache.c pending per vCPU */
+#define TB_PREFETCH_SEEDS 64
+
+typedef struct TBPrefetchItem {
+    target_ulong pc;
+    int depth;
+} TBPrefetchItem;
+
+/* One queue of translations ahead of a vCPU */
+typedef struct TBPrefetchCPU {
+    /* Taken by the worker for a translation, tried by the vCPU */
+    QemuMutex lock;
+    /* Private copy of the vCPU, for the translator */
+    ArchCPU *shadow;
+    target_ulong cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    unsigned int write_gen;
+    unsigned int flush_count;
+    TBPrefetchPage page;
+    tb_page_addr_t phys_page;
+    TBPrefetchItem *queue;
+    int size;
+    int head;
+    int tail;
+} TBPrefetchCPU;
+
+typedef struct TBPrefetchWorker {
+    QemuThread thread;
+    QemuEvent wake;
+    /* Held while translating, see tb_prefetch_pause() */
+    QemuMutex busy;
+    unsigned int index;
+} TBPrefetchWorker;
+
+unsigned int tb_prefetch_workers;
+__thread const TBPrefetchPage *tb_prefetch_page;
+
+/* The successor queues of the vCPUs, then their seed queues */
+static TBPrefetchCPU *tb_prefetch_cpus;
+static unsigned int tb_prefetch_n_cpus;
+static unsigned int tb_prefetch_n_queues;
+static TBPrefetchWorker *tb_prefetch_worker;
+static bool tb_prefetch_started;
+static QemuMutex tb_prefetch_start_lock;
+
+static bool tb_prefetch_queue_empty(TBPrefetchCPU *p)
+{
+    return p->head == p->tail;
+}
+
+static void tb_prefetch_queue_push(TBPrefetchCPU *p, target_ulong pc,
+                                   int depth)
+{
+    if (p->tail - p->head < p->size) {
+        TBPrefetchItem *item = &p->queue[p->tail++ % p->size];
+
+        item->pc = pc;
+        item->depth = depth;
+    }
+}
+
+static TBPrefetchItem tb_prefetch_queue_pop(TBPrefetchCPU *p)
+{
+    return p->queue[p->head++ % p->size];
+}
+
+struct tb_prefetch_desc {
+    target_ulong pc;
+    target_ulong cs_base;
+    tb_page_addr_t phys_page1;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t trace_vcpu_dstate;
+};
+
+/* As tb_lookup_cmp(), but the TBs that follow are within one page */
+static bool tb_prefetch_cmp(const void *p, const void *d)
+{
+    const TranslationBlock *tb = p;
+    const struct tb_prefetch_desc *desc = d;
+
+    return tb->pc == desc->pc &&
+           tb->page_addr[0] == desc->phys_page1 &&
+           tb->cs_base == desc->cs_base &&
+           tb->flags == desc->flags &&
+           tb->trace_vcpu_dstate == desc->trace_vcpu_dstate &&
+           tb_cflags(tb) == desc->cflags;
+}
+
+static bool tb_prefetch_exists(TBPrefetchCPU *p, target_ulong pc,
+                               tb_page_addr_t phys_pc)
+{
+    CPUState *cpu = env_cpu(&p->shadow->env);
+    struct tb_prefetch_desc desc = {
+        .pc = pc,
+        .cs_base = p->cs_base,
+        .phys_page1 = p->phys_page,
+        .flags = p->flags,
+        .cflags = p->cflags,
+        .trace_vcpu_dstate = *cpu->trace_dstate,
+    };
+    uint32_t h = tb_hash_func(phys_pc, pc, p->flags, p->cflags,
+                              *cpu->trace_dstate);
+
+    return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_prefetch_cmp);
+}
+
+/* Translate the next TB queued for @p.  Called with p->lock held. */
+static void tb_prefetch_step(TBPrefetchCPU *p)
+{
+    CPUState *cpu = env_cpu(&p->shadow->env);
+    CPUClass *cc = CPU_GET_CLASS(cpu);
+    TBPrefetchItem item = tb_prefetch_queue_pop(p);
+    tb_page_addr_t phys_pc = p->phys_page | (item.pc & ~TARGET_PAGE_MASK);
+    TranslationBlock *tb;
+    int i;
+
+    if (qatomic_mb_read(&tb_ctx.tb_flush_count) != p->flush_count) {
+        /* Anything queued from before the flush is stale */
+        p->head = p->tail;
+        return;
+    }
+    if (tb_prefetch_exists(p, item.pc, phys_pc)) {
+        qatomic_inc(&tb_ctx.tb_prefetch_found_count);
+        return;
+    }
+    if (cc->tcg_ops->prefetch_prepare &&
+        !cc->tcg_ops->prefetch_prepare(cpu, item.pc)) {
+        qatomic_inc(&tb_ctx.tb_prefetch_abort_count);
+        return;
+    }
+
+    tb_prefetch_page = &p->page;
+    tb = tb_gen_code_prefetch(cpu, item.pc, p->cs_base, p->flags, p->cflags,
+                              phys_pc, p->write_gen);
+    tb_prefetch_page = NULL;
+    if (!tb) {
+        qatomic_inc(&tb_ctx.tb_prefetch_abort_count);
+        return;
+    }
+    /* As in do_tb_gen_code(), for a flush that began meanwhile */
+    if (qatomic_mb_read(&tb_ctx.tb_flush_count) != p->flush_count) {
+        tb_phys_invalidate(tb, -1);
+        return;
+    }
+    qatomic_inc(&tb_ctx.tb_prefetch_count);
+
+    if (item.depth < TB_PREFETCH_DEPTH) {
+        for (i = 0; i < tcg_ctx->nb_tb_succ; i++) {
+            tb_prefetch_queue_push(p, tcg_ctx->tb_succ[i], item.depth + 1);
+        }
+    }
+}
+
+static void *tb_prefetch_thread(void *arg)
+{
+    TBPrefetchWorker *w = arg;
+    unsigned int i;
+
+    rcu_register_thread();
+    tcg_register_thread();
+
+    for (;;) {
+        bool more = false;
+
+        qemu_event_reset(&w->wake);
+        qemu_mutex_lock(&w->busy);
+        for (i = w->index; i < tb_prefetch_n_queues;
+             i += tb_prefetch_workers) {
+            TBPrefetchCPU *p = &tb_prefetch_cpus[i];
+
+            qemu_mutex_lock(&p->lock);
+            if (!tb_prefetch_queue_empty(p)) {
+                WITH_RCU_READ_LOCK_GUARD() {
+                    p->page.host = qemu_map_ram_ptr(NULL, p->phys_page);
+                    tb_prefetch_step(p);
+                }
+                more |= !tb_prefetch_queue_empty(p);
+            }
+            qemu_mutex_unlock(&p->lock);
+        }
+        qemu_mutex_unlock(&w->busy);
+        if (!more) {
+            qemu_event_wait(&w->wake);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * The workers register their TCG contexts, so they are only started
+ * once the target has created its TCG globals.
+ */
+static void tb_prefetch_start(void)
+{
+    unsigned int i;
+
+    qemu_mutex_lock(&tb_prefetch_start_lock);
+    if (!tb_prefetch_started) {
+        for (i = 0; i < tb_prefetch_workers; i++) {
+            TBPrefetchWorker *w = &tb_prefetch_worker[i];
+            char name[16];
+
+            snprintf(name, sizeof(name), "tb-prefetch/%u", i);
+            qemu_thread_create(&w->thread, name, tb_prefetch_thread, w,
+                               QEMU_THREAD_DETACHED);
+        }
+        qatomic_set(&tb_prefetch_started, true);
+    }
+    qemu_mutex_unlock(&tb_prefetch_start_lock);
+}
+
+static bool tb_prefetch_wanted(CPUState *cpu, TranslationBlock *tb)
+{
+    if (tb_cflags(tb) != curr_cflags(cpu) ||
+        !QTAILQ_EMPTY(&cpu->breakpoints) ||
+        qemu_loglevel_mask(CPU_LOG_TB_IN_ASM | CPU_LOG_TB_OUT_ASM |
+                           CPU_LOG_TB_OP | CPU_LOG_TB_OP_OPT)) {
+        return false;
+    }
+#ifdef CONFIG_PLUGIN
+    /* Plugins would see translations of blocks that may never run */
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask)) {
+        return false;
+    }
+#endif
+    if (unlikely(!qatomic_read(&tb_prefetch_started))) {
+        tb_prefetch_start();
+    }
+    return true;
+}
+
+/* Set up @p to translate code of the page of @tb, from the state of @cpu */
+static void tb_prefetch_prepare(TBPrefetchCPU *p, CPUState *cpu,
+                                TranslationBlock *tb, unsigned int write_gen)
+{
+    ArchCPU *arch = env_archcpu(cpu->env_ptr);
+
+    /* Everything but the TLB */
+    memcpy(p->shadow, arch, offsetof(ArchCPU, neg));
+    memcpy(&p->shadow->env, &arch->env,
+           sizeof(ArchCPU) - offsetof(ArchCPU, env));
+    p->shadow->parent_obj.env_ptr = &p->shadow->env;
+    QTAILQ_INIT(&p->shadow->parent_obj.breakpoints);
+    QTAILQ_INIT(&p->shadow->parent_obj.watchpoints);
+
+    p->cs_base = tb->cs_base;
+    p->flags = tb->flags;
+    p->cflags = tb_cflags(tb);
+    p->write_gen = write_gen;
+    p->flush_count = qatomic_mb_read(&tb_ctx.tb_flush_count);
+    p->phys_page = tb->page_addr[0];
+    p->page.addr = tb->pc & TARGET_PAGE_MASK;
+    p->head = p->tail = 0;
+}
+
+/* Wake up the worker that serves @p, see tb_prefetch_thread() */
+static void tb_prefetch_wake(TBPrefetchCPU *p)
+{
+    unsigned int i = p - tb_prefetch_cpus;
+
+    qemu_event_set(&tb_prefetch_worker[i % tb_prefetch_workers].wake);
+}
+
+/*
+ * Queue the direct successors of @tb, just translated by @cpu, to be
+ * translated ahead.  @write_gen is the write generation of the page of
+ * @tb from before it was translated.
+ */
+void tb_prefetch_post(CPUState *cpu, TranslationBlock *tb,
+                      unsigned int write_gen)
+{
+    TBPrefetchCPU *p;
+    int i;
+
+    if (tcg_ctx->nb_tb_succ == 0 || !tb_prefetch_wanted(cpu, tb)) {
+        return;
+    }
+
+    p = &tb_prefetch_cpus[cpu->cpu_index];
+    if (qemu_mutex_trylock(&p->lock)) {
+        /* Still busy with the previous TB */
+        return;
+    }
+    tb_prefetch_prepare(p, cpu, tb, write_gen);
+    for (i = 0; i < tcg_ctx->nb_tb_succ; i++) {
+        tb_prefetch_queue_push(p, tcg_ctx->tb_succ[i], 1);
+    }
+    qemu_mutex_unlock(&p->lock);
+
+    tb_prefetch_wake(p);
+}
+
+/*
+ * Queue the blocks at @pcs, in the page of @tb and with the same flags,
+ * to be translated ahead as for tb_prefetch_post().  Their successors
+ * are not followed.  Return false if @cpu still has blocks queued, for
+ * the caller to try again with a later TB.
+ */
+bool tb_prefetch_seed(CPUState *cpu, TranslationBlock *tb,
+                      unsigned int write_gen, const target_ulong *pcs, int n)
+{
+    TBPrefetchCPU *p;
+    int i;
+
+    if (!tb_prefetch_wanted(cpu, tb)) {
+        return true;
+    }
+
+    p = &tb_prefetch_cpus[tb_prefetch_n_cpus + cpu->cpu_index];
+    if (qemu_mutex_trylock(&p->lock)) {
+        return false;
+    }
+    if (!tb_prefetch_queue_empty(p)) {
+        qemu_mutex_unlock(&p->lock);
+        return false;
+    }
+    tb_prefetch_prepare(p, cpu, tb, write_gen);
+    for (i = 0; i < n; i++) {
+        tb_prefetch_queue_push(p, pcs[i], TB_PREFETCH_DEPTH);
+    }
+    qemu_mutex_unlock(&p->lock);
+
+    tb_prefetch_wake(p);
+    return true;
+}
+
+/*
+ * Stop the workers from translating, and drop what they have queued,
+ * until tb_prefetch_resume().  Called by do_tb_flush(), with the vCPUs
+ * stopped.
+ */
+void tb_prefetch_pause(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < tb_prefetch_workers; i++) {
+        qemu_mutex_lock(&tb_prefetch_worker[i].busy);
+    }
+    for (i = 0; i < tb_prefetch_n_queues; i++) {
+        tb_prefetch_cpus[i].head = tb_prefetch_cpus[i].tail;
+    }
+}
+
+void tb_prefetch_resume(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < tb_prefetch_workers; i++) {
+        qemu_mutex_unlock(&tb_prefetch_worker[i].busy);
+    }
+}
+
+void tb_prefetch_init(unsigned int max_cpus)
+{
+    unsigned int i;
+
+    if (!tb_prefetch_workers) {
+        return;
+    }
+
+    qemu_mutex_init(&tb_prefetch_start_lock);
+    tb_prefetch_n_cpus = max_cpus;
+    tb_prefetch_n_queues = 2 * max_cpus;
+    tb_prefetch_cpus = g_new0(TBPrefetchCPU, tb_prefetch_n_queues);
+    for (i = 0; i < tb_prefetch_n_queues; i++) {
+        TBPrefetchCPU *p = &tb_prefetch_cpus[i];
+
+        qemu_mutex_init(&p->lock);
+        p->shadow = g_malloc0(sizeof(ArchCPU));
+        p->size = i < max_cpus ? TB_PREFETCH_QUEUE : TB_PREFETCH_SEEDS;
+        p->queue = g_new(TBPrefetchItem, p->size);
+    }
+    tb_prefetch_worker = g_new0(TBPrefetchWorker, tb_prefetch_workers);
+    for (i = 0; i < tb_prefetch_workers; i++) {
+        qemu_event_init(&tb_prefetch_worker[i].wake, false);
+        qemu_mutex_init(&tb_prefetch_worker[i].busy);
+        tb_prefetch_worker[i].index = i;
+    }
+}
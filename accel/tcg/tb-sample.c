@@ -0,0 +1,196 @@
+/*
+ * Sampling of the translation blocks the vCPUs execute
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * With "-accel tcg,tb-sample=hz", a timer asks each running vCPU hz
+ * times per second of guest run time to leave its chain of TBs, the
+ * same way cpu_exit() does but without going back to the main loop.
+ * The TB whose entry notices the request is the sample, see
+ * cpu_loop_exec_tb(): no instrumentation goes into the generated code,
+ * so a vCPU pays for one lookup of its next TB per sample.
+ *
+ * Samples are counted per guest block, keyed by pc, cs_base and flags,
+ * so that they outlive flushes of the code cache. "info tb-hot" lists
+ * the blocks that got the most.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/main-loop.h"
+#include "qemu/timer.h"
+#include "qemu/xxhash.h"
+#include "cpu.h"
+#include "disas/disas.h"
+#include "exec/exec-all.h"
+#include "hw/core/cpu.h"
+#include "internal.h"
+
+typedef struct TBSample {
+    target_ulong pc;
+    target_ulong cs_base;
+    uint32_t flags;
+    uint32_t size;
+    uint32_t icount;
+    uint32_t host_size;
+    uint64_t count;
+} TBSample;
+
+typedef struct TBSampleCPU {
+    /* Set by the timer, cleared by the vCPU as it takes the sample */
+    bool pending;
+} TBSampleCPU;
+
+unsigned int tb_sample_hz;
+
+static TBSampleCPU *tb_sample_cpus;
+static unsigned int tb_sample_n_cpus;
+static QEMUTimer *tb_sample_timer;
+
+/* Protects the table and the totals */
+static QemuMutex tb_sample_lock;
+static GHashTable *tb_sample_table;
+static uint64_t tb_sample_total;
+static uint64_t tb_sample_missed;
+
+static guint tb_sample_hash(gconstpointer p)
+{
+    const TBSample *s = p;
+
+    return qemu_xxhash6(s->pc, s->cs_base, s->flags, 0);
+}
+
+static gboolean tb_sample_equal(gconstpointer a, gconstpointer b)
+{
+    const TBSample *sa = a, *sb = b;
+
+    return sa->pc == sb->pc && sa->cs_base == sb->cs_base &&
+           sa->flags == sb->flags;
+}
+
+static void tb_sample_tick(void *opaque)
+{
+    CPUState *cpu;
+    uint64_t missed = 0;
+
+    CPU_FOREACH(cpu) {
+        if (cpu->cpu_index >= tb_sample_n_cpus ||
+            cpu->halted || cpu_is_stopped(cpu)) {
+            continue;
+        }
+        /*
+         * A request still pending found the vCPU outside of generated
+         * code, e.g. in a helper or waiting for the BQL.  Ask again:
+         * cpu_handle_interrupt() may have cleared the exit request.
+         */
+        if (qatomic_xchg(&tb_sample_cpus[cpu->cpu_index].pending, true)) {
+            missed++;
+        }
+        qatomic_set(&cpu->icount_decr_ptr->u16.high, -1);
+    }
+
+    if (missed) {
+        qemu_mutex_lock(&tb_sample_lock);
+        tb_sample_missed += missed;
+        qemu_mutex_unlock(&tb_sample_lock);
+    }
+
+    timer_mod(tb_sample_timer,
+              qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL_RT) +
+              NANOSECONDS_PER_SECOND / tb_sample_hz);
+}
+
+void tb_sample_take(CPUState *cpu, TranslationBlock *tb)
+{
+    TBSample key, *s;
+
+    if (!qatomic_xchg(&tb_sample_cpus[cpu->cpu_index].pending, false)) {
+        return;
+    }
+
+    key.pc = tb->pc;
+    key.cs_base = tb->cs_base;
+    key.flags = tb->flags;
+
+    qemu_mutex_lock(&tb_sample_lock);
+    s = g_hash_table_lookup(tb_sample_table, &key);
+    if (!s) {
+        s = g_new0(TBSample, 1);
+        *s = key;
+        g_hash_table_add(tb_sample_table, s);
+    }
+    /* The latest translation of the block describes it */
+    s->size = tb->size;
+    s->icount = tb->icount;
+    s->host_size = tb->tc.size;
+    s->count++;
+    tb_sample_total++;
+    qemu_mutex_unlock(&tb_sample_lock);
+}
+
+static gint tb_sample_cmp(gconstpointer a, gconstpointer b)
+{
+    const TBSample *sa = *(const TBSample **)a;
+    const TBSample *sb = *(const TBSample **)b;
+
+    return sa->count < sb->count ? 1 : sa->count > sb->count ? -1 : 0;
+}
+
+void dump_tb_hot_info(GString *buf, int count)
+{
+    g_autoptr(GPtrArray) hot = g_ptr_array_new_with_free_func(g_free);
+    GHashTableIter iter;
+    TBSample *s;
+    uint64_t total;
+    int i;
+
+    qemu_mutex_lock(&tb_sample_lock);
+    g_hash_table_iter_init(&iter, tb_sample_table);
+    while (g_hash_table_iter_next(&iter, (gpointer *)&s, NULL)) {
+        g_ptr_array_add(hot, g_memdup2(s, sizeof(*s)));
+    }
+    total = tb_sample_total;
+    g_string_append_printf(buf, "TB samples          %" PRIu64
+                           " at %u Hz per vCPU, %" PRIu64
+                           " missed outside of TBs\n",
+                           total, tb_sample_hz, tb_sample_missed);
+    qemu_mutex_unlock(&tb_sample_lock);
+
+    if (!total) {
+        return;
+    }
+    g_ptr_array_sort(hot, tb_sample_cmp);
+
+    for (i = 0; i < count && i < hot->len; i++) {
+        s = g_ptr_array_index(hot, i);
+        g_string_append_printf(buf, "\n#%d  pc 0x" TARGET_FMT_lx
+                               " %s  %" PRIu64 " samples (%.2f%%)\n"
+                               "    %u guest insns, %u guest bytes, "
+                               "%u host bytes\n",
+                               i + 1, s->pc, lookup_symbol(s->pc), s->count,
+                               100.0 * s->count / total, s->icount, s->size,
+                               s->host_size);
+        /* The guest code as mapped now, which may not be what ran */
+        target_disas_buf(buf, first_cpu, s->pc, s->size);
+    }
+}
+
+void tb_sample_init(unsigned int max_cpus)
+{
+    if (!tb_sample_hz) {
+        return;
+    }
+
+    qemu_mutex_init(&tb_sample_lock);
+    tb_sample_table = g_hash_table_new_full(tb_sample_hash, tb_sample_equal,
+                                            g_free, NULL);
+    tb_sample_n_cpus = max_cpus;
+    tb_sample_cpus = g_new0(TBSampleCPU, max_cpus);
+
+    tb_sample_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL_RT, tb_sample_tick,
+                                   NULL);
+    timer_mod(tb_sample_timer,
+              qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL_RT) +
+              NANOSECONDS_PER_SECOND / tb_sample_hz);
+}
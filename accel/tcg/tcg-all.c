@@ -44,6 +44,14 @@ struct TCGState {
     bool mttcg_enabled;
     int splitwx_enabled;
     unsigned long tb_size;
+    bool ebb_regalloc;
+    bool return_stack;
+    bool tb_evict;
+    uint32_t jmp_cache_bits;
+    uint32_t vtlb_size;
+    uint32_t tb_prefetch;
+    uint32_t tb_sample;
+    char *tb_cache;
 };
 typedef struct TCGState TCGState;
 
@@ -106,6 +114,7 @@ static void tcg_accel_instance_init(Object *obj)
 #else
     s->splitwx_enabled = 0;
 #endif
+    s->jmp_cache_bits = TB_JMP_CACHE_BITS;
 }
 
 bool mttcg_enabled;
@@ -115,8 +124,15 @@ static int tcg_init_machine(MachineState *ms)
     TCGState *s = TCG_STATE(current_accel());
 #ifdef CONFIG_USER_ONLY
     unsigned max_cpus = 1;
+    unsigned n_workers = 0;
 #else
     unsigned max_cpus = ms->smp.max_cpus;
+    unsigned n_workers = s->tb_prefetch;
+
+    /* The blocks of the cache file are translated by the workers */
+    if (s->tb_cache && !n_workers) {
+        n_workers = 1;
+    }
 #endif
 
     tcg_allowed = true;
@@ -124,14 +140,29 @@ static int tcg_init_machine(MachineState *ms)
 
     page_init();
     tb_htable_init();
-    tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus);
+    tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus, n_workers,
+             s->tb_evict);
+    tcg_ctx->ebb_regalloc = s->ebb_regalloc;
+    tcg_ctx->return_stack = s->return_stack;
+    tb_jmp_cache_bits = s->jmp_cache_bits;
 
 #if defined(CONFIG_SOFTMMU)
+    tlb_vtlb_size = s->vtlb_size;
+
     /*
      * There's no guest base to take into account, so go ahead and
      * initialize the prologue now.
      */
     tcg_prologue_init(tcg_ctx);
+
+    tb_prefetch_workers = n_workers;
+    tb_prefetch_init(max_cpus);
+
+    tb_cache_path = s->tb_cache;
+    tb_cache_init();
+
+    tb_sample_hz = s->tb_sample;
+    tb_sample_init(max_cpus);
 #endif
 
     return 0;
@@ -208,6 +239,170 @@ static void tcg_set_splitwx(Object *obj, bool value, Error **errp)
     s->splitwx_enabled = value;
 }
 
+static bool tcg_get_ebb_regalloc(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->ebb_regalloc;
+}
+
+static void tcg_set_ebb_regalloc(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->ebb_regalloc = value;
+}
+
+static bool tcg_get_return_stack(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->return_stack;
+}
+
+static void tcg_set_return_stack(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->return_stack = value;
+}
+
+static bool tcg_get_tb_evict(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->tb_evict;
+}
+
+static void tcg_set_tb_evict(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->tb_evict = value;
+}
+
+static void tcg_get_jmp_cache_bits(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    visit_type_uint32(v, name, &s->jmp_cache_bits, errp);
+}
+
+static void tcg_set_jmp_cache_bits(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value < TB_JMP_CACHE_WAYS_BITS + 2 || value > TB_JMP_CACHE_BITS_MAX) {
+        error_setg(errp, "Invalid 'jmp-cache-bits' %" PRIu32
+                   ", must be between %d and %d", value,
+                   TB_JMP_CACHE_WAYS_BITS + 2, TB_JMP_CACHE_BITS_MAX);
+        return;
+    }
+    s->jmp_cache_bits = value;
+}
+
+#ifdef CONFIG_SOFTMMU
+static void tcg_get_vtlb_size(Object *obj, Visitor *v,
+                              const char *name, void *opaque,
+                              Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->vtlb_size ? s->vtlb_size : CPU_VTLB_SIZE;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_vtlb_size(Object *obj, Visitor *v,
+                              const char *name, void *opaque,
+                              Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value < 1 || value > CPU_VTLB_SIZE_MAX) {
+        error_setg(errp, "Invalid 'vtlb-size' %" PRIu32
+                   ", must be between 1 and %d", value, CPU_VTLB_SIZE_MAX);
+        return;
+    }
+    s->vtlb_size = value;
+}
+
+static void tcg_get_tb_prefetch(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    visit_type_uint32(v, name, &s->tb_prefetch, errp);
+}
+
+static void tcg_set_tb_prefetch(Object *obj, Visitor *v,
+                                const char *name, void *opaque,
+                                Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value > TB_PREFETCH_WORKERS_MAX) {
+        error_setg(errp, "Invalid 'tb-prefetch' %" PRIu32
+                   ", must be between 0 and %d", value,
+                   TB_PREFETCH_WORKERS_MAX);
+        return;
+    }
+    s->tb_prefetch = value;
+}
+
+static void tcg_get_tb_sample(Object *obj, Visitor *v,
+                              const char *name, void *opaque,
+                              Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    visit_type_uint32(v, name, &s->tb_sample, errp);
+}
+
+static void tcg_set_tb_sample(Object *obj, Visitor *v,
+                              const char *name, void *opaque,
+                              Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value > TB_SAMPLE_HZ_MAX) {
+        error_setg(errp, "Invalid 'tb-sample' %" PRIu32
+                   ", must be between 0 and %d", value, TB_SAMPLE_HZ_MAX);
+        return;
+    }
+    s->tb_sample = value;
+}
+
+static char *tcg_get_tb_cache(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return g_strdup(s->tb_cache);
+}
+
+static void tcg_set_tb_cache(Object *obj, const char *value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    g_free(s->tb_cache);
+    s->tb_cache = g_strdup(value);
+}
+#endif
+
 static void tcg_accel_class_init(ObjectClass *oc, void *data)
 {
     AccelClass *ac = ACCEL_CLASS(oc);
@@ -229,6 +424,52 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
         "Map jit pages into separate RW and RX regions");
+
+    object_class_property_add_bool(oc, "ebb-regalloc",
+        tcg_get_ebb_regalloc, tcg_set_ebb_regalloc);
+    object_class_property_set_description(oc, "ebb-regalloc",
+        "Keep TCG globals in host registers across labels");
+
+    object_class_property_add_bool(oc, "return-stack",
+        tcg_get_return_stack, tcg_set_return_stack);
+    object_class_property_set_description(oc, "return-stack",
+        "Predict the target of guest function returns");
+
+    object_class_property_add_bool(oc, "tb-evict",
+        tcg_get_tb_evict, tcg_set_tb_evict);
+    object_class_property_set_description(oc, "tb-evict",
+        "Evict cold parts of the TCG translation block cache when full");
+
+    object_class_property_add(oc, "jmp-cache-bits", "int",
+        tcg_get_jmp_cache_bits, tcg_set_jmp_cache_bits,
+        NULL, NULL);
+    object_class_property_set_description(oc, "jmp-cache-bits",
+        "log2 of the per-vCPU TB jump cache size");
+
+#ifdef CONFIG_SOFTMMU
+    object_class_property_add(oc, "vtlb-size", "int",
+        tcg_get_vtlb_size, tcg_set_vtlb_size,
+        NULL, NULL);
+    object_class_property_set_description(oc, "vtlb-size",
+        "Number of entries of the softmmu victim TLB");
+
+    object_class_property_add(oc, "tb-prefetch", "int",
+        tcg_get_tb_prefetch, tcg_set_tb_prefetch,
+        NULL, NULL);
+    object_class_property_set_description(oc, "tb-prefetch",
+        "Number of threads translating code ahead of the vCPUs");
+
+    object_class_property_add(oc, "tb-sample", "int",
+        tcg_get_tb_sample, tcg_set_tb_sample,
+        NULL, NULL);
+    object_class_property_set_description(oc, "tb-sample",
+        "Samples of the running TB per second and vCPU, for info tb-hot");
+
+    object_class_property_add_str(oc, "tb-cache",
+        tcg_get_tb_cache, tcg_set_tb_cache);
+    object_class_property_set_description(oc, "tb-cache",
+        "File of the blocks translated in earlier runs");
+#endif
 }
 
 static const TypeInfo tcg_accel_type = {
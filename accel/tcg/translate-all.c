@@ -59,6 +59,7 @@
 #include "qapi/error.h"
 #include "hw/core/tcg-cpu-ops.h"
 #include "tb-hash.h"
+#include "tb-jmp-cache.h"
 #include "tb-context.h"
 #include "internal.h"
 
@@ -102,16 +103,28 @@
 #define assert_memory_lock() tcg_debug_assert(have_mmap_lock())
 #endif
 
-#define SMC_BITMAP_USE_THRESHOLD 10
+/* Writes checked against its TBs that make a code page data-hot */
+#define SMC_WRITE_HOT_THRESHOLD 16
+/* Writes a data-hot page left without code stays write protected for */
+#define SMC_KEEP_PROTECTED_WRITES 256
 
 typedef struct PageDesc {
     /* list of TBs intersecting this ram page */
     uintptr_t first_tb;
 #ifdef CONFIG_SOFTMMU
-    /* in order to optimize self modifying code, we count the number
-       of lookups we do to a given page to use a bitmap */
+    /*
+     * The bytes of the page that TBs cover, built on the first write
+     * checked against them and kept up to date as TBs are added.  With
+     * code_bitmap_stale, TBs have been removed since and it is a superset.
+     */
     unsigned long *code_bitmap;
+    bool code_bitmap_stale;
+    /* writes checked against the TBs since the page was protected */
     unsigned int code_write_count;
+    /* writes left before the page, without code, is unprotected */
+    unsigned int smc_keep;
+    /* bumped under @lock on each write checked against the TBs */
+    unsigned int write_gen;
 #else
     unsigned long flags;
     void *target_data;
@@ -914,7 +927,19 @@ static inline void invalidate_page_bitmap(PageDesc *p)
 #ifdef CONFIG_SOFTMMU
     g_free(p->code_bitmap);
     p->code_bitmap = NULL;
+    p->code_bitmap_stale = false;
     p->code_write_count = 0;
+    p->smc_keep = 0;
+#endif
+}
+
+/* call with @p->lock held, once a TB has been removed from @p */
+static inline void page_bitmap_remove(PageDesc *p)
+{
+    assert_page_locked(p);
+#ifdef CONFIG_SOFTMMU
+    /* Its bytes may be shared with another TB: rebuild when needed */
+    p->code_bitmap_stale = true;
 #endif
 }
 
@@ -975,6 +1000,8 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
         goto done;
     }
     did_flush = true;
+    /* Workers must not translate into the buffer while it is reset */
+    tb_prefetch_pause();
 
     if (DEBUG_TB_FLUSH_GATE) {
         size_t nb_tbs = tcg_nb_tbs();
@@ -996,6 +1023,8 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
     /* XXX: flush processor icache at this point if cache flush is
        expensive */
     qatomic_mb_set(&tb_ctx.tb_flush_count, tb_ctx.tb_flush_count + 1);
+    trace_tb_flush(false);
+    tb_prefetch_resume();
 
 done:
     mmap_unlock();
@@ -1004,17 +1033,16 @@ done:
     }
 }
 
-void tb_flush(CPUState *cpu)
+/* Flush with all vCPUs stopped, in an exclusive section. */
+static void tb_flush_exclusive(CPUState *cpu)
 {
-    if (tcg_enabled()) {
-        unsigned tb_flush_count = qatomic_mb_read(&tb_ctx.tb_flush_count);
+    unsigned tb_flush_count = qatomic_mb_read(&tb_ctx.tb_flush_count);
 
-        if (cpu_in_exclusive_context(cpu)) {
-            do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_flush_count));
-        } else {
-            async_safe_run_on_cpu(cpu, do_tb_flush,
-                                  RUN_ON_CPU_HOST_INT(tb_flush_count));
-        }
+    if (cpu_in_exclusive_context(cpu)) {
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_flush_count));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_flush,
+                              RUN_ON_CPU_HOST_INT(tb_flush_count));
     }
 }
 
@@ -1197,20 +1225,17 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     if (rm_from_page_list) {
         p = page_find(tb->page_addr[0] >> TARGET_PAGE_BITS);
         tb_page_remove(p, tb);
-        invalidate_page_bitmap(p);
+        page_bitmap_remove(p);
         if (tb->page_addr[1] != -1) {
             p = page_find(tb->page_addr[1] >> TARGET_PAGE_BITS);
             tb_page_remove(p, tb);
-            invalidate_page_bitmap(p);
+            page_bitmap_remove(p);
         }
     }
 
     /* remove the TB from the hash list */
-    h = tb_jmp_cache_hash_func(tb->pc);
     CPU_FOREACH(cpu) {
-        if (qatomic_read(&cpu->tb_jmp_cache[h]) == tb) {
-            qatomic_set(&cpu->tb_jmp_cache[h], NULL);
-        }
+        tb_jmp_cache_remove(cpu, tb);
     }
 
     /* suppress this TB from the two jump lists */
@@ -1246,33 +1271,289 @@ void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr)
     }
 }
 
+/*
+ * Incremental reclamation of the code buffer, "-accel tcg,tb-evict=on".
+ *
+ * Rather than flushing all TBs once the buffer is full, the TBs of one full
+ * region at a time are invalidated, which unlinks them from the hash table,
+ * the page lists and the jump lists of other TBs.  A vCPU may still be
+ * running one of them, or hold one in its jump cache or return stack: the
+ * region is only handed back to tcg/region.c once every vCPU has run
+ * tb_evict_cpu_work(), which happens outside of cpu_exec() and drops those
+ * references.  No vCPU has to stop for another one.
+ */
+typedef struct TBEvict {
+    unsigned int token;
+    int pending;                /* references to this struct */
+    unsigned long regions[];    /* bitmap of the regions retired */
+} TBEvict;
+
+static TBEvict *tb_evict_new(void)
+{
+    TBEvict *ev;
+
+    ev = g_malloc0(sizeof(*ev) + BITS_TO_LONGS(tcg_region_count())
+                                 * sizeof(unsigned long));
+    ev->pending = 1;
+    return ev;
+}
+
+static void tb_evict_put(TBEvict *ev)
+{
+    size_t i, n = tcg_region_count();
+
+    if (qatomic_fetch_dec(&ev->pending) == 1) {
+        for (i = find_first_bit(ev->regions, n); i < n;
+             i = find_next_bit(ev->regions, n, i + 1)) {
+            tcg_region_evict_end(i, ev->token);
+        }
+        g_free(ev);
+    }
+}
+
+static bool tb_in_regions(const TranslationBlock *tb,
+                          const unsigned long *regions)
+{
+    ssize_t idx = tb ? tcg_region_index(tb) : -1;
+
+    return idx >= 0 && test_bit(idx, regions);
+}
+
+static void tb_evict_cpu_work(CPUState *cpu, run_on_cpu_data data)
+{
+    TBEvict *ev = data.host_ptr;
+    size_t i, n;
+
+    if (cpu->tb_jmp_cache) {
+        n = (size_t)1 << cpu->tb_jmp_cache_bits;
+        for (i = 0; i < n; i++) {
+            TBJmpCacheEntry *e = &cpu->tb_jmp_cache[i];
+
+            if (tb_in_regions(qatomic_read(&e->tb), ev->regions)) {
+                qatomic_set(&e->tb, NULL);
+            }
+        }
+    }
+    for (i = 0; i < TB_RET_STACK_SIZE; i++) {
+        if (tb_in_regions(cpu->tb_ret_stack[i].tb, ev->regions)) {
+            cpu->tb_ret_stack[i].tb = NULL;
+        }
+    }
+    tb_evict_put(ev);
+}
+
+/* Recycle the regions of @ev once every vCPU has dropped its references. */
+static void tb_evict_finish(TBEvict *ev)
+{
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        qatomic_inc(&ev->pending);
+        async_run_on_cpu(cpu, tb_evict_cpu_work, RUN_ON_CPU_HOST_PTR(ev));
+    }
+    tb_evict_put(ev);
+}
+
+static gboolean tb_evict_collect(gpointer key, gpointer value, gpointer data)
+{
+    g_ptr_array_add(data, value);
+    return false;
+}
+
+/*
+ * Invalidate all TBs of region @idx, returning how many there were.
+ * One-shot TBs are not in the region trees, and so cannot be found here:
+ * cpu_exec() never chains them to other TBs.
+ */
+static size_t tb_invalidate_region(size_t idx)
+{
+    g_autoptr(GPtrArray) tbs = g_ptr_array_new();
+    guint i;
+
+    /* The TB destructors run from tcg_region_evict_end(), not before. */
+    tcg_region_tb_foreach(idx, tb_evict_collect, tbs);
+    for (i = 0; i < tbs->len; i++) {
+        tb_phys_invalidate(g_ptr_array_index(tbs, i), -1);
+    }
+    return tbs->len;
+}
+
+/*
+ * Start evicting a full region, preferably one that no vCPU has in its
+ * jump cache.  Returns false if there is none, or if some region is still
+ * retiring.
+ *
+ * Called from a vCPU thread, which must be in jit write mode.
+ */
+static bool tb_evict_region(void)
+{
+    g_autofree unsigned long *hot = bitmap_new(tcg_region_count());
+    TBEvict *ev;
+    CPUState *cpu;
+    ssize_t idx;
+    size_t i, n;
+
+    CPU_FOREACH(cpu) {
+        if (!cpu->tb_jmp_cache) {
+            continue;
+        }
+        n = (size_t)1 << cpu->tb_jmp_cache_bits;
+        for (i = 0; i < n; i++) {
+            TranslationBlock *tb = qatomic_read(&cpu->tb_jmp_cache[i].tb);
+
+            idx = tb ? tcg_region_index(tb) : -1;
+            if (idx >= 0) {
+                set_bit(idx, hot);
+            }
+        }
+    }
+
+    ev = tb_evict_new();
+    idx = tcg_region_evict_begin(hot, &ev->token);
+    if (idx < 0) {
+        g_free(ev);
+        return false;
+    }
+    set_bit(idx, ev->regions);
+
+    n = tb_invalidate_region(idx);
+    qatomic_inc(&tb_ctx.tb_evict_count);
+    qatomic_add(&tb_ctx.tb_evict_tb_count, n);
+    trace_tb_evict_region(idx, n);
+
+    tb_evict_finish(ev);
+    return true;
+}
+
+/* Invalidate the TBs found in the page lists below @lp. */
+static void tb_invalidate_pages_1(int level, void **lp, GPtrArray *tbs)
+{
+    TranslationBlock *tb;
+    int i, n;
+    guint j;
+
+    if (*lp == NULL) {
+        return;
+    }
+    if (level == 0) {
+        PageDesc *pd = *lp;
+
+        for (i = 0; i < V_L2_SIZE; ++i) {
+            page_lock(&pd[i]);
+            PAGE_FOR_EACH_TB(&pd[i], tb, n) {
+                /* a TB spanning two pages is found from its first one */
+                if (n == 0) {
+                    g_ptr_array_add(tbs, tb);
+                }
+            }
+            page_unlock(&pd[i]);
+
+            for (j = 0; j < tbs->len; j++) {
+                tb_phys_invalidate(g_ptr_array_index(tbs, j), -1);
+            }
+            g_ptr_array_set_size(tbs, 0);
+        }
+    } else {
+        void **pp = *lp;
+
+        for (i = 0; i < V_L2_SIZE; ++i) {
+            tb_invalidate_pages_1(level - 1, pp + i, tbs);
+        }
+    }
+}
+
+/*
+ * tb_flush() from a vCPU thread with "-accel tcg,tb-evict=on".
+ *
+ * The other vCPUs keep running while the TBs are invalidated one by one,
+ * as on guest code writes: they may finish the TB they are in, but can no
+ * longer find or chain to any of them.  The TBs are found through the
+ * page lists, which only hold the TBs fully linked; one that is being
+ * translated meanwhile is checked against tb_flush_count at the end of
+ * tb_gen_code().  The full regions are then recycled like evicted ones;
+ * the regions being filled keep their dead code until they fill up.
+ *
+ * Own TBs of the caller, which is still in cpu_exec(), cannot be
+ * recycled under its feet: its own tb_evict_cpu_work() runs later.
+ *
+ * Plugins are not supported: qemu_plugin_flush_cb() frees the callback
+ * arrays of every TB, including those still running and those translated
+ * after the flush.  tb_flush() stops the world for them instead.
+ */
+static void tb_flush_nonstop(void)
+{
+    g_autoptr(GPtrArray) tbs = g_ptr_array_new();
+    TBEvict *ev = tb_evict_new();
+    int i, l1_sz = v_l1_size;
+
+    qemu_thread_jit_write();
+    qatomic_mb_set(&tb_ctx.tb_flush_count, tb_ctx.tb_flush_count + 1);
+
+    tcg_region_retire_all(ev->regions, &ev->token);
+    for (i = 0; i < l1_sz; i++) {
+        tb_invalidate_pages_1(v_l2_levels, l1_map + i, tbs);
+    }
+    qemu_thread_jit_execute();
+    qatomic_inc(&tb_ctx.tb_flush_nonstop_count);
+    trace_tb_flush(true);
+
+    tb_evict_finish(ev);
+}
+
+void tb_flush(CPUState *cpu)
+{
+    if (tcg_enabled()) {
+        if (tcg_region_evict_enabled() && cpu == current_cpu
+            && !cpu_in_exclusive_context(cpu)
+            && bitmap_empty(cpu->plugin_mask, QEMU_PLUGIN_EV_MAX)) {
+            tb_flush_nonstop();
+        } else {
+            tb_flush_exclusive(cpu);
+        }
+    }
+}
+
 #ifdef CONFIG_SOFTMMU
+/* Mark the bytes of page @n of @tb in the code bitmap of @p */
+static void page_bitmap_set_tb(PageDesc *p, TranslationBlock *tb, int n)
+{
+    int tb_start, tb_end;
+
+    /* NOTE: this is subtle as a TB may span two physical pages */
+    if (n == 0) {
+        tb_start = tb->pc & ~TARGET_PAGE_MASK;
+        tb_end = MIN(tb_start + tb->size, TARGET_PAGE_SIZE);
+    } else {
+        tb_start = 0;
+        tb_end = ((tb->pc + tb->size) & ~TARGET_PAGE_MASK);
+    }
+    bitmap_set(p->code_bitmap, tb_start, tb_end - tb_start);
+}
+
 /* call with @p->lock held */
 static void build_page_bitmap(PageDesc *p)
 {
-    int n, tb_start, tb_end;
     TranslationBlock *tb;
+    int n;
 
     assert_page_locked(p);
-    p->code_bitmap = bitmap_new(TARGET_PAGE_SIZE);
+    if (p->code_bitmap) {
+        bitmap_zero(p->code_bitmap, TARGET_PAGE_SIZE);
+    } else {
+        p->code_bitmap = bitmap_new(TARGET_PAGE_SIZE);
+    }
+    p->code_bitmap_stale = false;
 
     PAGE_FOR_EACH_TB(p, tb, n) {
-        /* NOTE: this is subtle as a TB may span two physical pages */
-        if (n == 0) {
-            /* NOTE: tb_end may be after the end of the page, but
-               it is not a problem */
-            tb_start = tb->pc & ~TARGET_PAGE_MASK;
-            tb_end = tb_start + tb->size;
-            if (tb_end > TARGET_PAGE_SIZE) {
-                tb_end = TARGET_PAGE_SIZE;
-             }
-        } else {
-            tb_start = 0;
-            tb_end = ((tb->pc + tb->size) & ~TARGET_PAGE_MASK);
-        }
-        bitmap_set(p->code_bitmap, tb_start, tb_end - tb_start);
+        page_bitmap_set_tb(p, tb, n);
     }
 }
+
+/* call with @p->lock held and the bitmap built */
+static bool page_bitmap_test(PageDesc *p, unsigned int nr, int len)
+{
+    return find_next_bit(p->code_bitmap, nr + len, nr) < nr + len;
+}
 #endif
 
 /* add the tb in the target page and protect it if necessary
@@ -1295,16 +1576,29 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
     page_already_protected = p->first_tb != (uintptr_t)NULL;
 #endif
     p->first_tb = (uintptr_t)tb | n;
-    invalidate_page_bitmap(p);
 
 #if defined(CONFIG_USER_ONLY)
     /* translator_loop() must have made all TB pages non-writable */
     assert(!(p->flags & PAGE_WRITE));
 #else
+    if (p->code_bitmap) {
+        page_bitmap_set_tb(p, tb, n);
+    }
+
     /* if some code is already present, then the pages are already
        protected. So we handle the case where only the first TB is
        allocated in a physical page */
     if (!page_already_protected) {
+        /*
+         * A page kept protected needs no TLB flush, unless a DMA write
+         * has unprotected it since, which tlb_protect_code() then finds.
+         */
+        if (p->smc_keep) {
+            p->smc_keep = 0;
+            qatomic_inc(&tb_ctx.tb_smc_kept_count);
+        } else {
+            qatomic_inc(&tb_ctx.tb_smc_protect_count);
+        }
         tlb_protect_code(page_addr);
     }
 #endif
@@ -1320,10 +1614,14 @@ static inline void tb_page_add(PageDesc *p, TranslationBlock *tb,
  * Note that in !user-mode, another thread might have already added a TB
  * for the same block of guest code that @tb corresponds to. In that case,
  * the caller should discard the original @tb, and use instead the returned TB.
+ *
+ * With @write_gen, also return NULL without linking @tb if the first page
+ * has been written to since its write generation was *@write_gen: @tb may
+ * have been translated from stale code.  Writes from then on will find it.
  */
 static TranslationBlock *
 tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
-             tb_page_addr_t phys_page2)
+             tb_page_addr_t phys_page2, const unsigned int *write_gen)
 {
     PageDesc *p;
     PageDesc *p2 = NULL;
@@ -1342,6 +1640,13 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
      * we can only insert TBs that are fully initialized.
      */
     page_lock_pair(&p, phys_pc, &p2, phys_page2, 1);
+#ifdef CONFIG_SOFTMMU
+    if (write_gen && p->write_gen != *write_gen) {
+        tcg_debug_assert(!p2);
+        page_unlock(p);
+        return NULL;
+    }
+#endif
     tb_page_add(p, tb, 0, phys_pc & TARGET_PAGE_MASK);
     if (p2) {
         tb_page_add(p2, tb, 1, phys_page2);
@@ -1357,10 +1662,10 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     /* remove TB from the page(s) if we couldn't insert it */
     if (unlikely(existing_tb)) {
         tb_page_remove(p, tb);
-        invalidate_page_bitmap(p);
+        page_bitmap_remove(p);
         if (p2) {
             tb_page_remove(p2, tb);
-            invalidate_page_bitmap(p2);
+            page_bitmap_remove(p2);
         }
         tb = existing_tb;
     }
@@ -1378,31 +1683,31 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     return tb;
 }
 
-/* Called with mmap_lock held for user mode emulation.  */
-TranslationBlock *tb_gen_code(CPUState *cpu,
-                              target_ulong pc, target_ulong cs_base,
-                              uint32_t flags, int cflags)
+/*
+ * Translate and link a TB, see tb_gen_code().  @write_gen is NULL, except
+ * when translating ahead on a worker thread, see tb_gen_code_prefetch():
+ * then NULL is returned rather than making room in the code buffer, and
+ * if the translation has to be given up.
+ */
+static TranslationBlock *do_tb_gen_code(CPUState *cpu, target_ulong pc,
+                                        target_ulong cs_base, uint32_t flags,
+                                        int cflags, tb_page_addr_t phys_pc,
+                                        const unsigned int *write_gen)
 {
     CPUArchState *env = cpu->env_ptr;
     TranslationBlock *tb, *existing_tb;
-    tb_page_addr_t phys_pc, phys_page2;
+    tb_page_addr_t phys_page2;
     target_ulong virt_page2;
     tcg_insn_unit *gen_code_buf;
     int gen_code_size, search_size, max_insns;
+    unsigned flush_count;
 #ifdef CONFIG_PROFILER
     TCGProfile *prof = &tcg_ctx->prof;
     int64_t ti;
 #endif
 
-    assert_memory_lock();
     qemu_thread_jit_write();
-
-    phys_pc = get_page_addr_code(env, pc);
-
-    if (phys_pc == -1) {
-        /* Generate a one-shot TB with 1 insn in it */
-        cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
-    }
+    flush_count = qatomic_mb_read(&tb_ctx.tb_flush_count);
 
     max_insns = cflags & CF_COUNT_MASK;
     if (max_insns == 0) {
@@ -1410,11 +1715,24 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     }
     QEMU_BUILD_BUG_ON(CF_COUNT_MASK + 1 != TCG_MAX_INSNS);
 
+    if (unlikely(tcg_region_evict_wanted()) && !write_gen) {
+        tb_evict_region();
+    }
+
  buffer_overflow:
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        if (write_gen) {
+            /* Leave it to the vCPUs to make room */
+            return NULL;
+        }
+        if (tb_evict_region() || tcg_region_evict_pending()) {
+            /* A region frees up once the vCPUs have left cpu_exec. */
+            qatomic_inc(&tb_ctx.tb_evict_stall_count);
+        } else {
+            /* flush must be done, and only a full flush makes room */
+            tb_flush_exclusive(cpu);
+        }
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -1450,6 +1768,15 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tcg_ctx->cpu = NULL;
     max_insns = tb->icount;
 
+    if (write_gen && tcg_ctx->tb_cpu_state) {
+        /*
+         * The code depends on the state of the worker's copy of the
+         * vCPU, which the vCPU may no longer be in when it gets here.
+         */
+        existing_tb = NULL;
+        goto discard;
+    }
+
     trace_translate_block(tb, tb->pc, tb->tc.ptr);
 
     /* generate machine code */
@@ -1508,6 +1835,16 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
                           max_insns);
             goto tb_overflow;
 
+        case -3:
+            /*
+             * The translation ahead of time read code outside of its
+             * page, see tb_prefetch_code_ptr().
+             */
+            tcg_debug_assert(write_gen);
+            tcg_ctx->cpu = NULL;
+            existing_tb = NULL;
+            goto discard;
+
         default:
             g_assert_not_reached();
         }
@@ -1625,36 +1962,120 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         return tb;
     }
 
-    /*
-     * Insert TB into the corresponding region tree before publishing it
-     * through QHT. Otherwise rewinding happened in the TB might fail to
-     * lookup itself using host PC.
-     */
-    tcg_tb_insert(tb);
-
     /* check next page if needed */
     virt_page2 = (pc + tb->size - 1) & TARGET_PAGE_MASK;
     phys_page2 = -1;
     if ((pc & TARGET_PAGE_MASK) != virt_page2) {
+        /* A translation ahead of time reads from the first page only */
+        tcg_debug_assert(!write_gen);
         phys_page2 = get_page_addr_code(env, virt_page2);
     }
+
+    /*
+     * Insert TB into the corresponding region tree before publishing it
+     * through QHT. Otherwise rewinding happened in the TB might fail to
+     * lookup itself using host PC.  Only do so once nothing can longjmp
+     * out of here any more: a TB evicted from its region's tree must have
+     * been linked.
+     */
+    tcg_tb_insert(tb);
     /*
      * No explicit memory barrier is required -- tb_link_page() makes the
      * TB visible in a consistent state.
      */
-    existing_tb = tb_link_page(tb, phys_pc, phys_page2);
+    existing_tb = tb_link_page(tb, phys_pc, phys_page2, write_gen);
     /* if the TB already exists, discard what we just translated */
     if (unlikely(existing_tb != tb)) {
-        uintptr_t orig_aligned = (uintptr_t)gen_code_buf;
-
-        orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize);
-        qatomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
         tcg_tb_remove(tb);
-        return existing_tb;
+    discard:
+        qatomic_set(&tcg_ctx->code_gen_ptr, (void *)
+                    ((uintptr_t)gen_code_buf -
+                     ROUND_UP(sizeof(*tb), qemu_icache_linesize)));
+        if (!existing_tb) {
+            return NULL;
+        }
+        tb = existing_tb;
+    }
+
+    /*
+     * A tb_flush_nonstop() that began meanwhile may have missed the TB:
+     * it can still be run this once, but must not be found again.
+     */
+    if (unlikely(qatomic_mb_read(&tb_ctx.tb_flush_count) != flush_count)) {
+        tb_phys_invalidate(tb, -1);
     }
     return tb;
 }
 
+/* Called with mmap_lock held for user mode emulation.  */
+TranslationBlock *tb_gen_code(CPUState *cpu,
+                              target_ulong pc, target_ulong cs_base,
+                              uint32_t flags, int cflags)
+{
+    TranslationBlock *tb;
+    tb_page_addr_t phys_pc;
+#ifdef CONFIG_SOFTMMU
+    unsigned int write_gen = 0;
+#endif
+
+    assert_memory_lock();
+
+    phys_pc = get_page_addr_code(cpu->env_ptr, pc);
+
+    if (phys_pc == -1) {
+        /* Generate a one-shot TB with 1 insn in it */
+        cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
+    }
+
+#ifdef CONFIG_SOFTMMU
+    /*
+     * Read before the code is: a write that the translation may miss
+     * either changes it, or comes before the page is protected again by
+     * linking the TB, just as for this translation.
+     */
+    if (tb_prefetch_enabled() && phys_pc != -1) {
+        write_gen = tb_page_write_gen(phys_pc);
+    }
+#endif
+    tb = do_tb_gen_code(cpu, pc, cs_base, flags, cflags, phys_pc, NULL);
+#ifdef CONFIG_SOFTMMU
+    if (tb_prefetch_enabled() && phys_pc != -1) {
+        tb_prefetch_post(cpu, tb, write_gen);
+    }
+    if (tb_cache_enabled() && phys_pc != -1) {
+        tb_cache_post(cpu, tb, write_gen);
+    }
+#endif
+    return tb;
+}
+
+#ifdef CONFIG_SOFTMMU
+/*
+ * Translate @pc ahead of execution, on a worker thread of tb-prefetch.c.
+ * @cpu is the worker's private copy of the vCPU, and @phys_pc the known
+ * address of the code, of which only that page may be read.  No room is
+ * made in the code buffer if it is full.  Return NULL if the TB could
+ * not be translated, or if its page has been written to since its write
+ * generation was @write_gen.
+ */
+TranslationBlock *tb_gen_code_prefetch(CPUState *cpu, target_ulong pc,
+                                       target_ulong cs_base, uint32_t flags,
+                                       int cflags, tb_page_addr_t phys_pc,
+                                       unsigned int write_gen)
+{
+    return do_tb_gen_code(cpu, pc, cs_base, flags, cflags, phys_pc,
+                          &write_gen);
+}
+
+/* The write generation of the page at @addr, see tb_link_page(). */
+unsigned int tb_page_write_gen(tb_page_addr_t addr)
+{
+    PageDesc *p = page_find(addr >> TARGET_PAGE_BITS);
+
+    return p ? qatomic_read(&p->write_gen) : 0;
+}
+#endif
+
 /*
  * @p must be non-NULL.
  * user-mode: call with mmap_lock held.
@@ -1681,6 +2102,9 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
 #endif /* TARGET_HAS_PRECISE_SMC */
 
     assert_page_locked(p);
+#ifdef CONFIG_SOFTMMU
+    qatomic_set(&p->write_gen, p->write_gen + 1);
+#endif
 
 #if defined(TARGET_HAS_PRECISE_SMC)
     if (cpu != NULL) {
@@ -1726,13 +2150,24 @@ tb_invalidate_phys_page_range__locked(struct page_collection *pages,
             }
 #endif /* TARGET_HAS_PRECISE_SMC */
             tb_phys_invalidate__locked(tb);
+            qatomic_inc(&tb_ctx.tb_smc_invalidate_count);
         }
     }
 #if !defined(CONFIG_USER_ONLY)
-    /* if no code remaining, no need to continue to use slow writes */
+    /*
+     * if no code remaining, no need to continue to use slow writes.
+     * But the code of a page that is also written to often is likely
+     * to be translated again soon: keep the page protected for a while,
+     * rather than have tlb_protect_code() flush it from every TLB again.
+     */
     if (!p->first_tb) {
-        invalidate_page_bitmap(p);
-        tlb_unprotect_code(start);
+        if (p->code_write_count >= SMC_WRITE_HOT_THRESHOLD) {
+            p->code_write_count = 0;
+            p->smc_keep = SMC_KEEP_PROTECTED_WRITES;
+        } else {
+            invalidate_page_bitmap(p);
+            tlb_unprotect_code(start);
+        }
     }
 #endif
 #ifdef TARGET_HAS_PRECISE_SMC
@@ -1807,7 +2242,7 @@ void tb_invalidate_phys_range(target_ulong start, target_ulong end)
 }
 
 #ifdef CONFIG_SOFTMMU
-/* len must be <= 8 and start must be a multiple of len.
+/* [start, start + len[ must not cross a page.
  * Called via softmmu_template.h when code areas are written to with
  * iothread mutex not held.
  *
@@ -1817,6 +2252,7 @@ void tb_invalidate_phys_page_fast(struct page_collection *pages,
                                   tb_page_addr_t start, int len,
                                   uintptr_t retaddr)
 {
+    unsigned int nr = start & ~TARGET_PAGE_MASK;
     PageDesc *p;
 
     assert_memory_lock();
@@ -1827,24 +2263,38 @@ void tb_invalidate_phys_page_fast(struct page_collection *pages,
     }
 
     assert_page_locked(p);
-    if (!p->code_bitmap &&
-        ++p->code_write_count >= SMC_BITMAP_USE_THRESHOLD) {
-        build_page_bitmap(p);
+    qatomic_set(&p->write_gen, p->write_gen + 1);
+
+    if (!p->first_tb) {
+        /* Kept protected by tb_invalidate_phys_page_range__locked() */
+        if (p->smc_keep && --p->smc_keep) {
+            return;
+        }
+        invalidate_page_bitmap(p);
+        tlb_unprotect_code(start);
+        return;
     }
-    if (p->code_bitmap) {
-        unsigned int nr;
-        unsigned long b;
 
-        nr = start & ~TARGET_PAGE_MASK;
-        b = p->code_bitmap[BIT_WORD(nr)] >> (nr & (BITS_PER_LONG - 1));
-        if (b & ((1 << len) - 1)) {
-            goto do_invalidate;
+    /*
+     * Only the TBs with bytes in the range are invalidated, but the
+     * bitmap saves walking them all for each write to the data around.
+     */
+    qatomic_inc(&tb_ctx.tb_smc_write_count);
+    p->code_write_count++;
+    if (!p->code_bitmap) {
+        build_page_bitmap(p);
+    }
+    if (!page_bitmap_test(p, nr, len)) {
+        return;
+    }
+    if (p->code_bitmap_stale) {
+        build_page_bitmap(p);
+        if (!page_bitmap_test(p, nr, len)) {
+            return;
         }
-    } else {
-    do_invalidate:
-        tb_invalidate_phys_page_range__locked(pages, p, start, start + len,
-                                              retaddr);
     }
+    tb_invalidate_phys_page_range__locked(pages, p, start, start + len,
+                                          retaddr);
 }
 #else
 /* Called with mmap_lock held. If pc is not 0 then it indicates the
@@ -2070,7 +2520,10 @@ void dump_exec_info(GString *buf)
 {
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
-    size_t nb_tbs, flush_full, flush_part, flush_elide;
+    size_t nb_tbs, flush_full, flush_part, flush_elide, flush_large;
+    size_t jc_hits = 0, jc_misses = 0, jc_reval = 0;
+    size_t rs_hits = 0, rs_misses = 0;
+    CPUState *cpu;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -2107,15 +2560,56 @@ void dump_exec_info(GString *buf)
     qht_statistics_destroy(&hst);
 
     g_string_append_printf(buf, "\nStatistics:\n");
-    g_string_append_printf(buf, "TB flush count      %u\n",
-                           qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB flush count      %u (%u non-stop)\n",
+                           qatomic_read(&tb_ctx.tb_flush_count),
+                           qatomic_read(&tb_ctx.tb_flush_nonstop_count));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
-
-    tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
+    g_string_append_printf(buf, "TB region evictions %u (%u TBs, "
+                           "%u stalls)\n",
+                           qatomic_read(&tb_ctx.tb_evict_count),
+                           qatomic_read(&tb_ctx.tb_evict_tb_count),
+                           qatomic_read(&tb_ctx.tb_evict_stall_count));
+    g_string_append_printf(buf, "TB prefetch count   %u (%u found, "
+                           "%u given up)\n",
+                           qatomic_read(&tb_ctx.tb_prefetch_count),
+                           qatomic_read(&tb_ctx.tb_prefetch_found_count),
+                           qatomic_read(&tb_ctx.tb_prefetch_abort_count));
+    g_string_append_printf(buf, "TB cache pages      %u (%u blocks "
+                           "queued)\n",
+                           qatomic_read(&tb_ctx.tb_cache_hit_count),
+                           qatomic_read(&tb_ctx.tb_cache_seed_count));
+    g_string_append_printf(buf, "SMC checked writes  %u (%u TBs "
+                           "invalidated)\n",
+                           qatomic_read(&tb_ctx.tb_smc_write_count),
+                           qatomic_read(&tb_ctx.tb_smc_invalidate_count));
+    g_string_append_printf(buf, "code page protects  %u (%u more while "
+                           "kept protected)\n",
+                           qatomic_read(&tb_ctx.tb_smc_protect_count),
+                           qatomic_read(&tb_ctx.tb_smc_kept_count));
+
+    tlb_flush_counts(&flush_full, &flush_part, &flush_elide, &flush_large);
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    g_string_append_printf(buf, "TLB large page full flushes %zu\n",
+                           flush_large);
+
+    CPU_FOREACH(cpu) {
+        jc_hits += qatomic_read(&cpu->tb_jmp_cache_hits);
+        jc_misses += qatomic_read(&cpu->tb_jmp_cache_misses);
+        jc_reval += qatomic_read(&cpu->tb_jmp_cache_revalidations);
+        rs_hits += qatomic_read(&cpu->tb_ret_stack_hits);
+        rs_misses += qatomic_read(&cpu->tb_ret_stack_misses);
+    }
+    g_string_append_printf(buf, "jump cache hits     %zu (%zu%%)\n", jc_hits,
+                           jc_hits + jc_misses ?
+                           jc_hits * 100 / (jc_hits + jc_misses) : 0);
+    g_string_append_printf(buf, "jump cache misses   %zu\n", jc_misses);
+    g_string_append_printf(buf, "jump cache revalid. %zu\n", jc_reval);
+    g_string_append_printf(buf, "return stack hits   %zu (%zu%%)\n", rs_hits,
+                           rs_hits + rs_misses ?
+                           rs_hits * 100 / (rs_hits + rs_misses) : 0);
     tcg_dump_info(buf);
 }
 
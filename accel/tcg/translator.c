@@ -33,13 +33,46 @@ void translator_loop_temp_check(DisasContextBase *db)
 
 bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest)
 {
+    int i;
+
     /* Suppress goto_tb if requested. */
     if (tb_cflags(db->tb) & CF_NO_GOTO_TB) {
         return false;
     }
 
     /* Check for the dest on the same page as the start of the TB.  */
-    return ((db->pc_first ^ dest) & TARGET_PAGE_MASK) == 0;
+    if ((db->pc_first ^ dest) & TARGET_PAGE_MASK) {
+        return false;
+    }
+
+    /* Note it as a successor that may be translated ahead of time. */
+    for (i = 0; i < tcg_ctx->nb_tb_succ; i++) {
+        if (tcg_ctx->tb_succ[i] == dest) {
+            return true;
+        }
+    }
+    if (i < ARRAY_SIZE(tcg_ctx->tb_succ)) {
+        tcg_ctx->tb_succ[i] = dest;
+        tcg_ctx->nb_tb_succ++;
+    }
+    return true;
+}
+
+void translator_forget_succ(DisasContextBase *db, target_ulong dest)
+{
+    int i;
+
+    for (i = 0; i < tcg_ctx->nb_tb_succ; i++) {
+        if (tcg_ctx->tb_succ[i] == dest) {
+            tcg_ctx->tb_succ[i] = tcg_ctx->tb_succ[--tcg_ctx->nb_tb_succ];
+            return;
+        }
+    }
+}
+
+void translator_uses_cpu_state(DisasContextBase *db)
+{
+    tcg_ctx->tb_cpu_state = true;
 }
 
 static inline void translator_page_protect(DisasContextBase *dcbase,
@@ -65,6 +98,8 @@ void translator_loop(const TranslatorOps *ops, DisasContextBase *db,
     db->num_insns = 0;
     db->max_insns = max_insns;
     db->singlestep_enabled = cflags & CF_SINGLE_STEP;
+    tcg_ctx->nb_tb_succ = 0;
+    tcg_ctx->tb_cpu_state = false;
     translator_page_protect(db, db->pc_next);
 
     ops->init_disas_context(db, cpu);
@@ -465,6 +465,17 @@ uint64_t cpu_ldq_code(CPUArchState *env, abi_ptr ptr)
     return ret;
 }
 
+/*
+ * Probe [addr, addr + len), which must not cross a page, for a bulk access
+ * by guest_memcpy() and friends.  All guest memory is host memory here.
+ */
+static void *guest_mem_probe(CPUArchState *env, target_ulong addr, int len,
+                             MMUAccessType access_type, int mmu_idx,
+                             uintptr_t ra)
+{
+    return probe_access(env, addr, len, access_type, mmu_idx, ra);
+}
+
 #include "ldst_common.c.inc"
 
 /*
@@ -1,3 +1,4 @@
 TARGET_ARCH=arc32
 TARGET_BASE_ARCH=arc
+TARGET_SUPPORTS_MTTCG=y
 TARGET_XML_FILES= gdb-xml/arc-v2-core.xml gdb-xml/arc-v2-aux.xml gdb-xml/arc-v3_32-core.xml gdb-xml/arc-v3_32-aux.xml
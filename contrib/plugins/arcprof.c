@@ -0,0 +1,515 @@
+/*
+ * ARC execution profile
+ *
+ * Counts the ARC specific idioms that tend to dominate the cost of a
+ * workload, both on real hardware and under emulation: zero overhead
+ * loops, delay slots, long immediates, aux register accesses,
+ * LLOCK/SCOND retries and memory instructions restarted by an MMU
+ * exception. Instructions are classified from the output of the ARC
+ * disassembler as returned by qemu_plugin_insn_disas().
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include <inttypes.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+static int limit = 20;
+
+/* Plugins need to take care of their own locking */
+static GMutex lock;
+
+/* Static instructions of interest, indexed by vaddr */
+static GHashTable *insns;
+/* Zero overhead loops, indexed by the vaddr of the loop body start */
+static GHashTable *loops;
+/* Aux registers accessed by LR/SR/AEX, indexed by name */
+static GHashTable *aux_regs;
+
+typedef struct {
+    uint64_t vaddr;
+    char *disas;
+    uint64_t count;
+    /* LLOCK: re-executed right after a failed SCOND */
+    uint64_t retries;
+    /* Memory access restarted because of an exception */
+    uint64_t faults;
+} InsnRec;
+
+typedef struct {
+    uint64_t lp_vaddr;
+    uint64_t entries;
+    uint64_t iterations;
+} LoopRec;
+
+typedef struct {
+    char *name;
+    uint64_t reads;
+    uint64_t writes;
+} AuxRec;
+
+/*
+ * Per vCPU tracking state. As in the cache plugin, user mode shares a
+ * single entry between all the threads.
+ */
+typedef struct {
+    /* Memory instruction started but whose access did not complete */
+    InsnRec *mem_insn;
+    /* Last LLOCK executed */
+    InsnRec *llock;
+    /* SCOND executed in the previous block */
+    bool scond;
+} VCPUState;
+
+static VCPUState *vcpus;
+static int cores;
+
+static uint64_t total_insns;
+static uint64_t limm_insns;
+static uint64_t dslot_branches;
+static uint64_t dslot_nops;
+static uint64_t dslot_unknown;
+static uint64_t llock_insns;
+static uint64_t scond_insns;
+
+static gint cmp_insn_faults(gconstpointer a, gconstpointer b)
+{
+    const InsnRec *ea = a;
+    const InsnRec *eb = b;
+    return ea->faults > eb->faults ? -1 : 1;
+}
+
+static gint cmp_insn_count(gconstpointer a, gconstpointer b)
+{
+    const InsnRec *ea = a;
+    const InsnRec *eb = b;
+    return ea->count > eb->count ? -1 : 1;
+}
+
+static gint cmp_loop_iterations(gconstpointer a, gconstpointer b)
+{
+    const LoopRec *ea = a;
+    const LoopRec *eb = b;
+    return ea->iterations > eb->iterations ? -1 : 1;
+}
+
+static gint cmp_aux_accesses(gconstpointer a, gconstpointer b)
+{
+    const AuxRec *ea = a;
+    const AuxRec *eb = b;
+    return ea->reads + ea->writes > eb->reads + eb->writes ? -1 : 1;
+}
+
+static double percent(uint64_t part, uint64_t total)
+{
+    return total ? 100.0 * part / total : 0.0;
+}
+
+static void report_loops(GString *report)
+{
+    GList *list = g_list_sort(g_hash_table_get_values(loops),
+                              cmp_loop_iterations);
+    GList *it;
+    int i;
+
+    g_string_append_printf(report, "\nZero overhead loops: %u\n",
+                           g_hash_table_size(loops));
+    if (list) {
+        g_string_append(report, "lp pc, entries, iterations, avg\n");
+    }
+    for (i = 0, it = list; i < limit && it; i++, it = it->next) {
+        LoopRec *rec = it->data;
+        g_string_append_printf(report,
+                               "0x%016" PRIx64 ", %" PRId64 ", %" PRId64
+                               ", %.1f\n",
+                               rec->lp_vaddr, rec->entries, rec->iterations,
+                               rec->entries ?
+                               (double) rec->iterations / rec->entries : 0.0);
+    }
+    g_list_free(list);
+}
+
+static void report_aux_regs(GString *report)
+{
+    GList *list = g_list_sort(g_hash_table_get_values(aux_regs),
+                              cmp_aux_accesses);
+    GList *it;
+    int i;
+
+    g_string_append_printf(report, "\nAux register accesses:\n");
+    if (list) {
+        g_string_append(report, "register, lr, sr\n");
+    }
+    for (i = 0, it = list; i < limit && it; i++, it = it->next) {
+        AuxRec *rec = it->data;
+        g_string_append_printf(report, "%-16s, %" PRId64 ", %" PRId64 "\n",
+                               rec->name, rec->reads, rec->writes);
+    }
+    g_list_free(list);
+}
+
+static void report_insns(GString *report, const char *title,
+                         GCompareFunc cmp, bool faults)
+{
+    GList *list = g_list_sort(g_hash_table_get_values(insns), cmp);
+    GList *it;
+    int i;
+
+    g_string_append_printf(report, "\n%s:\n", title);
+    for (i = 0, it = list; i < limit && it; it = it->next) {
+        InsnRec *rec = it->data;
+
+        if (faults && rec->faults) {
+            g_string_append_printf(report, "0x%016" PRIx64 ", %" PRId64
+                                   ", %s\n", rec->vaddr, rec->faults,
+                                   rec->disas);
+            i++;
+        } else if (!faults && (rec->retries || g_str_has_prefix(rec->disas,
+                                                                "llock"))) {
+            g_string_append_printf(report, "0x%016" PRIx64 ", %" PRId64
+                                   ", %" PRId64 ", %s\n", rec->vaddr,
+                                   rec->count, rec->retries, rec->disas);
+            i++;
+        }
+    }
+    g_list_free(list);
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new("ARC execution profile\n");
+    uint64_t faults = 0;
+    uint64_t retries = 0;
+    GHashTableIter iter;
+    gpointer value;
+
+    g_mutex_lock(&lock);
+
+    g_hash_table_iter_init(&iter, insns);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        InsnRec *rec = value;
+        faults += rec->faults;
+        retries += rec->retries;
+    }
+
+    g_string_append_printf(report, "instructions: %" PRId64 "\n",
+                           total_insns);
+    g_string_append_printf(report, "with LIMM: %" PRId64 " (%.2f%%)\n",
+                           limm_insns, percent(limm_insns, total_insns));
+    g_string_append_printf(report,
+                           "delay slot branches: %" PRId64
+                           ", slots with nop: %" PRId64 " (%.2f%%)"
+                           ", slots in next block: %" PRId64 "\n",
+                           dslot_branches, dslot_nops,
+                           percent(dslot_nops, dslot_branches),
+                           dslot_unknown);
+    g_string_append_printf(report,
+                           "llock: %" PRId64 ", scond: %" PRId64
+                           ", retries: %" PRId64 " (%.2f%% of scond)\n",
+                           llock_insns, scond_insns, retries,
+                           percent(retries, scond_insns));
+    g_string_append_printf(report, "MMU exceptions on memory access: %"
+                           PRId64 "\n", faults);
+
+    report_loops(report);
+    report_aux_regs(report);
+    report_insns(report, "LLOCK sites (pc, count, retries, insn)",
+                 cmp_insn_count, false);
+    report_insns(report, "Faulting memory instructions (pc, faults, insn)",
+                 cmp_insn_faults, true);
+
+    g_mutex_unlock(&lock);
+
+    qemu_plugin_outs(report->str);
+}
+
+static void free_insn(gpointer data)
+{
+    InsnRec *rec = data;
+    g_free(rec->disas);
+    g_free(rec);
+}
+
+static void free_aux(gpointer data)
+{
+    AuxRec *rec = data;
+    g_free(rec->name);
+    g_free(rec);
+}
+
+static void plugin_init(void)
+{
+    insns = g_hash_table_new_full(NULL, g_direct_equal, NULL, free_insn);
+    loops = g_hash_table_new_full(NULL, g_direct_equal, NULL, g_free);
+    aux_regs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_aux);
+    vcpus = g_new0(VCPUState, cores);
+}
+
+/*
+ * A memory instruction whose access callback did not fire before the
+ * next block or memory instruction was restarted by an exception.
+ */
+static void check_mem_fault(VCPUState *vcpu)
+{
+    if (vcpu->mem_insn) {
+        vcpu->mem_insn->faults++;
+        vcpu->mem_insn = NULL;
+    }
+}
+
+static void vcpu_tb_exec(unsigned int cpu_index, void *udata)
+{
+    VCPUState *vcpu = &vcpus[cpu_index % cores];
+    InsnRec *llock = udata;
+
+    check_mem_fault(vcpu);
+
+    /*
+     * A failed SCOND branches straight back to its LLOCK, so count a
+     * retry when the block following a SCOND holds the last LLOCK.
+     */
+    if (vcpu->scond && llock && llock == vcpu->llock) {
+        llock->retries++;
+    }
+    vcpu->scond = false;
+}
+
+static void vcpu_mem_insn_exec(unsigned int cpu_index, void *udata)
+{
+    VCPUState *vcpu = &vcpus[cpu_index % cores];
+
+    check_mem_fault(vcpu);
+    vcpu->mem_insn = udata;
+}
+
+static void vcpu_mem_access(unsigned int cpu_index, qemu_plugin_meminfo_t info,
+                            uint64_t vaddr, void *udata)
+{
+    vcpus[cpu_index % cores].mem_insn = NULL;
+}
+
+static void vcpu_llock_exec(unsigned int cpu_index, void *udata)
+{
+    vcpus[cpu_index % cores].llock = udata;
+}
+
+static void vcpu_scond_exec(unsigned int cpu_index, void *udata)
+{
+    vcpus[cpu_index % cores].scond = true;
+}
+
+/* Must be called with lock held */
+static InsnRec *get_insn_rec(struct qemu_plugin_insn *insn)
+{
+    uint64_t vaddr = qemu_plugin_insn_vaddr(insn);
+    InsnRec *rec = g_hash_table_lookup(insns, GUINT_TO_POINTER(vaddr));
+
+    if (!rec) {
+        rec = g_new0(InsnRec, 1);
+        rec->vaddr = vaddr;
+        rec->disas = qemu_plugin_insn_disas(insn);
+        g_hash_table_insert(insns, GUINT_TO_POINTER(vaddr), rec);
+    }
+    return rec;
+}
+
+/* Must be called with lock held */
+static AuxRec *get_aux_rec(const char *operands)
+{
+    const char *start = strchr(operands, '[');
+    g_autofree char *name = NULL;
+    AuxRec *rec;
+
+    if (!start || !strchr(start, ']')) {
+        return NULL;
+    }
+    name = g_strndup(start + 1, strcspn(start + 1, "]"));
+
+    rec = g_hash_table_lookup(aux_regs, name);
+    if (!rec) {
+        rec = g_new0(AuxRec, 1);
+        rec->name = g_steal_pointer(&name);
+        g_hash_table_insert(aux_regs, rec->name, rec);
+    }
+    return rec;
+}
+
+/* Does the mnemonic carry the ".d" delay slot flag? */
+static bool has_delay_slot(char **flags)
+{
+    for (; *flags; flags++) {
+        if (strcmp(*flags, "d") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool is_nop(struct qemu_plugin_insn *insn)
+{
+    g_autofree char *disas = qemu_plugin_insn_disas(insn);
+    return g_str_has_prefix(disas, "nop");
+}
+
+static bool is_mem_insn(const char *base)
+{
+    static const char * const prefixes[] = {
+        "ld", "st", "push", "pop", "enter", "leave",
+    };
+    int i;
+
+    /* Not to be confused with the "ext" sign/zero extension family */
+    if (strcmp(base, "ex") == 0) {
+        return true;
+    }
+    for (i = 0; i < G_N_ELEMENTS(prefixes); i++) {
+        if (g_str_has_prefix(base, prefixes[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n = qemu_plugin_tb_n_insns(tb);
+    InsnRec *tb_llock = NULL;
+    size_t i;
+
+    qemu_plugin_register_vcpu_tb_exec_inline(tb, QEMU_PLUGIN_INLINE_ADD_U64,
+                                             &total_insns, n);
+
+    g_mutex_lock(&lock);
+
+    for (i = 0; i < n; i++) {
+        struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
+        uint64_t vaddr = qemu_plugin_insn_vaddr(insn);
+        size_t size = qemu_plugin_insn_size(insn);
+        g_autofree char *disas = qemu_plugin_insn_disas(insn);
+        g_autofree char *mnemonic = g_strndup(disas, strcspn(disas, " \t"));
+        g_auto(GStrv) flags = g_strsplit(mnemonic, ".", -1);
+        const char *base = flags[0];
+        LoopRec *loop;
+
+        /* A 16 or 32 bit encoding followed by a 32 bit long immediate */
+        if (size == 6 || size == 8) {
+            qemu_plugin_register_vcpu_insn_exec_inline(
+                insn, QEMU_PLUGIN_INLINE_ADD_U64, &limm_insns, 1);
+        }
+
+        loop = g_hash_table_lookup(loops, GUINT_TO_POINTER(vaddr));
+        if (loop) {
+            qemu_plugin_register_vcpu_insn_exec_inline(
+                insn, QEMU_PLUGIN_INLINE_ADD_U64, &loop->iterations, 1);
+        }
+
+        if (g_str_has_prefix(base, "lp")) {
+            /* The loop body starts right after the LP instruction. */
+            uint64_t start = vaddr + size;
+
+            loop = g_hash_table_lookup(loops, GUINT_TO_POINTER(start));
+            if (!loop) {
+                loop = g_new0(LoopRec, 1);
+                loop->lp_vaddr = vaddr;
+                g_hash_table_insert(loops, GUINT_TO_POINTER(start), loop);
+            }
+            qemu_plugin_register_vcpu_insn_exec_inline(
+                insn, QEMU_PLUGIN_INLINE_ADD_U64, &loop->entries, 1);
+        } else if (g_str_has_prefix(base, "llock")) {
+            InsnRec *rec = get_insn_rec(insn);
+
+            tb_llock = tb_llock ? tb_llock : rec;
+            qemu_plugin_register_vcpu_insn_exec_inline(
+                insn, QEMU_PLUGIN_INLINE_ADD_U64, &rec->count, 1);
+            qemu_plugin_register_vcpu_insn_exec_inline(
+                insn, QEMU_PLUGIN_INLINE_ADD_U64, &llock_insns, 1);
+            qemu_plugin_register_vcpu_insn_exec_cb(
+                insn, vcpu_llock_exec, QEMU_PLUGIN_CB_NO_REGS, rec);
+        } else if (g_str_has_prefix(base, "scond")) {
+            qemu_plugin_register_vcpu_insn_exec_inline(
+                insn, QEMU_PLUGIN_INLINE_ADD_U64, &scond_insns, 1);
+            qemu_plugin_register_vcpu_insn_exec_cb(
+                insn, vcpu_scond_exec, QEMU_PLUGIN_CB_NO_REGS, NULL);
+        } else if (strcmp(base, "lr") == 0 || strcmp(base, "lrl") == 0 ||
+                   strcmp(base, "sr") == 0 || strcmp(base, "srl") == 0 ||
+                   strcmp(base, "aex") == 0) {
+            AuxRec *aux = get_aux_rec(disas + strlen(mnemonic));
+
+            if (aux) {
+                qemu_plugin_register_vcpu_insn_exec_inline(
+                    insn, QEMU_PLUGIN_INLINE_ADD_U64,
+                    base[0] == 'l' ? &aux->reads : &aux->writes, 1);
+            }
+        } else if (is_mem_insn(base)) {
+            InsnRec *rec = get_insn_rec(insn);
+
+            qemu_plugin_register_vcpu_insn_exec_cb(
+                insn, vcpu_mem_insn_exec, QEMU_PLUGIN_CB_NO_REGS, rec);
+            qemu_plugin_register_vcpu_mem_cb(
+                insn, vcpu_mem_access, QEMU_PLUGIN_CB_NO_REGS,
+                QEMU_PLUGIN_MEM_RW, NULL);
+        }
+
+        if (has_delay_slot(flags + 1)) {
+            uint64_t *slot = &dslot_unknown;
+
+            qemu_plugin_register_vcpu_insn_exec_inline(
+                insn, QEMU_PLUGIN_INLINE_ADD_U64, &dslot_branches, 1);
+            if (i + 1 < n) {
+                slot = is_nop(qemu_plugin_tb_get_insn(tb, i + 1)) ?
+                       &dslot_nops : NULL;
+            }
+            if (slot) {
+                qemu_plugin_register_vcpu_insn_exec_inline(
+                    insn, QEMU_PLUGIN_INLINE_ADD_U64, slot, 1);
+            }
+        }
+    }
+
+    g_mutex_unlock(&lock);
+
+    qemu_plugin_register_vcpu_tb_exec_cb(tb, vcpu_tb_exec,
+                                         QEMU_PLUGIN_CB_NO_REGS, tb_llock);
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    int i;
+
+    if (strcmp(info->target_name, "arc") != 0 &&
+        strcmp(info->target_name, "arc64") != 0) {
+        fprintf(stderr, "arcprof: unsupported target %s\n",
+                info->target_name);
+        return -1;
+    }
+
+    for (i = 0; i < argc; i++) {
+        char *opt = argv[i];
+        g_autofree char **tokens = g_strsplit(opt, "=", 2);
+        if (g_strcmp0(tokens[0], "limit") == 0 && tokens[1]) {
+            limit = atoi(tokens[1]);
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
+    }
+
+    cores = info->system_emulation ? qemu_plugin_n_vcpus() : 1;
+
+    plugin_init();
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
@@ -43,13 +43,13 @@ typedef struct {
     uint32_t mask;
     uint32_t pattern;
     CountType what;
-    uint64_t count;
+    struct qemu_plugin_scoreboard *count;
 } InsnClassExecCount;
 
 typedef struct {
     char *insn;
     uint32_t opcode;
-    uint64_t count;
+    struct qemu_plugin_scoreboard *count;
     InsnClassExecCount *class;
 } InsnExecCount;
 
@@ -155,16 +155,23 @@ static ClassSelector class_tables[] = {
 static InsnClassExecCount *class_table;
 static int class_table_sz;
 
+/* Each vCPU counts in its own entry, we add them up at the end */
+static uint64_t total(struct qemu_plugin_scoreboard *count)
+{
+    return qemu_plugin_u64_sum(qemu_plugin_scoreboard_u64(count));
+}
+
 static gint cmp_exec_count(gconstpointer a, gconstpointer b)
 {
     InsnExecCount *ea = (InsnExecCount *) a;
     InsnExecCount *eb = (InsnExecCount *) b;
-    return ea->count > eb->count ? -1 : 1;
+    return total(ea->count) > total(eb->count) ? -1 : 1;
 }
 
 static void free_record(gpointer data)
 {
     InsnExecCount *rec = (InsnExecCount *) data;
+    qemu_plugin_scoreboard_free(rec->count);
     g_free(rec->insn);
     g_free(rec);
 }
@@ -180,10 +187,10 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
         class = &class_table[i];
         switch (class->what) {
         case COUNT_CLASS:
-            if (class->count || verbose) {
+            if (total(class->count) || verbose) {
                 g_string_append_printf(report, "Class: %-24s\t(%ld hits)\n",
                                        class->class,
-                                       class->count);
+                                       total(class->count));
             }
             break;
         case COUNT_INDIVIDUAL:
@@ -210,7 +217,7 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
             g_string_append_printf(report,
                                    "Instr: %-24s\t(%ld hits)\t(op=0x%08x/%s)\n",
                                    rec->insn,
-                                   rec->count,
+                                   total(rec->count),
                                    rec->opcode,
                                    rec->class ?
                                    rec->class->class : "un-categorised");
@@ -230,14 +237,16 @@ static void plugin_init(void)
 
 static void vcpu_insn_exec_before(unsigned int cpu_index, void *udata)
 {
-    uint64_t *count = (uint64_t *) udata;
-    (*count)++;
+    struct qemu_plugin_scoreboard *count = udata;
+
+    qemu_plugin_u64_add(qemu_plugin_scoreboard_u64(count), cpu_index, 1);
 }
 
-static uint64_t *find_counter(struct qemu_plugin_insn *insn)
+static struct qemu_plugin_scoreboard *find_counter(
+    struct qemu_plugin_insn *insn)
 {
     int i;
-    uint64_t *cnt = NULL;
+    struct qemu_plugin_scoreboard *cnt = NULL;
     uint32_t opcode;
     InsnClassExecCount *class = NULL;
 
@@ -263,7 +272,7 @@ static uint64_t *find_counter(struct qemu_plugin_insn *insn)
     case COUNT_NONE:
         return NULL;
     case COUNT_CLASS:
-        return &class->count;
+        return class->count;
     case COUNT_INDIVIDUAL:
     {
         InsnExecCount *icount;
@@ -277,13 +286,14 @@ static uint64_t *find_counter(struct qemu_plugin_insn *insn)
             icount->opcode = opcode;
             icount->insn = qemu_plugin_insn_disas(insn);
             icount->class = class;
+            icount->count = qemu_plugin_scoreboard_new(sizeof(uint64_t));
 
             g_hash_table_insert(insns, GUINT_TO_POINTER(opcode),
                                 (gpointer) icount);
         }
         g_mutex_unlock(&lock);
 
-        return &icount->count;
+        return icount->count;
     }
     default:
         g_assert_not_reached();
@@ -298,14 +308,15 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
     size_t i;
 
     for (i = 0; i < n; i++) {
-        uint64_t *cnt;
+        struct qemu_plugin_scoreboard *cnt;
         struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
         cnt = find_counter(insn);
 
         if (cnt) {
             if (do_inline) {
-                qemu_plugin_register_vcpu_insn_exec_inline(
-                    insn, QEMU_PLUGIN_INLINE_ADD_U64, cnt, 1);
+                qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+                    insn, QEMU_PLUGIN_INLINE_ADD_U64,
+                    qemu_plugin_scoreboard_u64(cnt), 1);
             } else {
                 qemu_plugin_register_vcpu_insn_exec_cb(
                     insn, vcpu_insn_exec_before, QEMU_PLUGIN_CB_NO_REGS, cnt);
@@ -365,6 +376,9 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
     }
 
     plugin_init();
+    for (i = 0; i < class_table_sz; i++) {
+        class_table[i].count = qemu_plugin_scoreboard_new(sizeof(uint64_t));
+    }
 
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
@@ -250,7 +250,7 @@ void target_disas(FILE *out, CPUState *cpu, target_ulong code,
     }
 }
 
-static int plugin_printf(FILE *stream, const char *fmt, ...)
+static int gstring_printf(FILE *stream, const char *fmt, ...)
 {
     /* We abuse the FILE parameter to pass a GString. */
     GString *s = (GString *)stream;
@@ -281,7 +281,7 @@ char *plugin_disas(CPUState *cpu, uint64_t addr, size_t size)
     GString *ds = g_string_new(NULL);
 
     initialize_debug_target(&s, cpu);
-    s.info.fprintf_func = plugin_printf;
+    s.info.fprintf_func = gstring_printf;
     s.info.stream = (FILE *)ds;  /* abuse this slot */
     s.info.buffer_vma = addr;
     s.info.buffer_length = size;
@@ -299,6 +299,38 @@ char *plugin_disas(CPUState *cpu, uint64_t addr, size_t size)
     return g_string_free(ds, false);
 }
 
+/* As target_disas(), into @buf, e.g. for a monitor command */
+void target_disas_buf(GString *buf, CPUState *cpu, target_ulong code,
+                      target_ulong size)
+{
+    target_ulong pc;
+    int count;
+    CPUDebug s;
+
+    initialize_debug_target(&s, cpu);
+    s.info.fprintf_func = gstring_printf;
+    s.info.stream = (FILE *)buf;  /* abuse this slot */
+    s.info.buffer_vma = code;
+    s.info.buffer_length = size;
+
+    if (s.info.cap_arch >= 0 && cap_disas_target(&s.info, code, size)) {
+        return;
+    }
+
+    if (s.info.print_insn == NULL) {
+        s.info.print_insn = print_insn_od_target;
+    }
+
+    for (pc = code; size > 0; pc += count, size -= count) {
+        g_string_append_printf(buf, "0x" TARGET_FMT_lx ":  ", pc);
+        count = s.info.print_insn(pc, &s.info);
+        g_string_append_c(buf, '\n');
+        if (count < 0 || size < count) {
+            break;
+        }
+    }
+}
+
 /* Disassemble this for me please... (debugging). */
 void disas(FILE *out, const void *code, unsigned long size)
 {
@@ -281,6 +281,23 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tb-hot",
+        .args_type  = "count:i?",
+        .params     = "[count]",
+        .help       = "show the translation blocks sampled the most "
+                      "(default: 10)",
+    },
+#endif
+
+SRST
+  ``info tb-hot`` [*count*]
+    Show the *count* translation blocks, 10 by default, that got the
+    most samples with ``-accel tcg,tb-sample=hz``, with their guest
+    code.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
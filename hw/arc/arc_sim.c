@@ -74,6 +74,8 @@ static void arc_sim_init(MachineState *machine)
     boot_info.ram_start = ram_base;
     boot_info.ram_size = ram_size;
     boot_info.kernel_filename = machine->kernel_filename;
+    boot_info.initrd_filename = machine->initrd_filename;
+    boot_info.dtb_filename = machine->dtb;
 
     for (n = 0; n < smp_cpus; n++) {
         cpu = ARC_CPU(object_new(machine->cpu_type));
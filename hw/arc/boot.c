@@ -24,6 +24,22 @@
 #include "hw/loader.h"
 #include "qemu/error-report.h"
 #include "qemu/units.h"
+#include "sysemu/device_tree.h"
+
+/*
+ * Boot blobs are placed at the top of the low memory window, in this
+ * order going down: command line, DTB, initrd.
+ */
+#define ARC_BOOT_ALIGN (64 * KiB)
+
+/*
+ * During early boot only first 1 GiB is mapped by kernel.
+ * So do not place anything after that point.
+ */
+static hwaddr arc_boot_lowmem_end(const struct arc_boot_info *info)
+{
+    return info->ram_start + MIN(1 * GiB, info->ram_size);
+}
 
 void arc_cpu_reset(void *opaque)
 {
@@ -41,19 +57,17 @@ void arc_cpu_reset(void *opaque)
      * via CPU registers we have to do it here.
      */
 
-    if (info->kernel_cmdline && strlen(info->kernel_cmdline)) {
+    if (info->dtb_addr) {
+        /* Command line and initrd location are in the DTB's /chosen. */
+        cpu->env.r[0] = ARC_UBOOT_DTB;
+        cpu->env.r[2] = info->dtb_addr;
+    } else if (info->kernel_cmdline && strlen(info->kernel_cmdline)) {
         /* Load "cmdline" far enough from the kernel image. */
-        hwaddr cmdline_offset, cmdline_addr;
-        const hwaddr max_page_size = 64 * KiB;
+        hwaddr cmdline_addr;
 
-        /*
-         * During early boot only first 1 GiB is mapped by kernel.
-         * So do not place cmdline after that point.
-         */
-        cmdline_offset = MIN(1 * GiB, info->ram_size) -
-            strlen(info->kernel_cmdline);
-        cmdline_addr = info->ram_start +
-            QEMU_ALIGN_DOWN(cmdline_offset, max_page_size);
+        cmdline_addr = QEMU_ALIGN_DOWN(arc_boot_lowmem_end(info) -
+                                       strlen(info->kernel_cmdline),
+                                       ARC_BOOT_ALIGN);
 
         cpu_physical_memory_write(cmdline_addr, info->kernel_cmdline,
                                   strlen(info->kernel_cmdline));
@@ -64,11 +78,85 @@ void arc_cpu_reset(void *opaque)
     }
 }
 
+/*
+ * The initrd is added as a ROM blob backed by a private mapping of the
+ * file: nothing is read up front and the host page cache is shared
+ * between all the instances booting the same image.
+ */
+static void arc_load_initrd(struct arc_boot_info *info, hwaddr kernel_high,
+                            hwaddr top)
+{
+    int64_t size = get_image_size(info->initrd_filename);
+    hwaddr addr;
+
+    if (size < 0) {
+        error_report("could not load initrd '%s'", info->initrd_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    addr = QEMU_ALIGN_DOWN(top - size, ARC_BOOT_ALIGN);
+    if (size > top - info->ram_start || addr < kernel_high) {
+        error_report("initrd '%s' is too large to fit in low memory",
+                     info->initrd_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    size = load_image_mapped_targphys_as(info->initrd_filename, addr,
+                                         top - addr, NULL);
+    if (size < 0) {
+        error_report("could not load initrd '%s'", info->initrd_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    info->initrd_start = addr;
+    info->initrd_size = size;
+}
+
+#ifdef CONFIG_FDT
+static hwaddr arc_load_dtb(struct arc_boot_info *info, hwaddr kernel_high,
+                           hwaddr top)
+{
+    int size;
+    hwaddr addr;
+    void *fdt = load_device_tree(info->dtb_filename, &size);
+
+    if (!fdt) {
+        error_report("could not load DTB '%s'", info->dtb_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    qemu_fdt_add_path(fdt, "/chosen");
+    if (info->kernel_cmdline && strlen(info->kernel_cmdline)) {
+        qemu_fdt_setprop_string(fdt, "/chosen", "bootargs",
+                                info->kernel_cmdline);
+    }
+
+    addr = QEMU_ALIGN_DOWN(top - size, ARC_BOOT_ALIGN);
+
+    /* The initrd goes right below the DTB. */
+    if (info->initrd_filename) {
+        arc_load_initrd(info, kernel_high, addr);
+        qemu_fdt_setprop_u64(fdt, "/chosen", "linux,initrd-start",
+                             info->initrd_start);
+        qemu_fdt_setprop_u64(fdt, "/chosen", "linux,initrd-end",
+                             info->initrd_start + info->initrd_size);
+    }
+
+    rom_add_blob_fixed("dtb", fdt, size, addr);
+    g_free(fdt);
+
+    return addr;
+}
+#endif
+
 
 void arc_load_kernel(ARCCPU *cpu, struct arc_boot_info *info)
 {
-    hwaddr entry;
+    hwaddr entry, kernel_high;
+    hwaddr top = arc_boot_lowmem_end(info) - ARC_BOOT_ALIGN;
+    uint64_t elf_high;
     int elf_machine, kernel_size;
+    CPUState *cs;
 
     if (!info->kernel_filename) {
         error_report("missing kernel file");
@@ -78,19 +166,22 @@ void arc_load_kernel(ARCCPU *cpu, struct arc_boot_info *info)
     elf_machine = cpu->family > 2 ? EM_ARC_COMPACT2 : EM_ARC_COMPACT;
     elf_machine = (cpu->family & ARC_OPCODE_V3_ALL) != 0 ? EM_ARC_COMPACT3_64 : elf_machine;
     kernel_size = load_elf(info->kernel_filename, NULL, NULL, NULL,
-                           &entry, NULL, NULL, NULL,
+                           &entry, NULL, &elf_high, NULL,
                            false, /* little endian */
                            elf_machine, 1, 0);
+    kernel_high = elf_high;
 
     if (kernel_size < 0) {
         int is_linux;
+        hwaddr load_addr;
 
-        kernel_size = load_uimage(info->kernel_filename, &entry, NULL,
+        kernel_size = load_uimage(info->kernel_filename, &entry, &load_addr,
                                   &is_linux, NULL, NULL);
         if (!is_linux) {
             error_report("Wrong U-Boot image, only Linux kernel is supported");
             exit(EXIT_FAILURE);
         }
+        kernel_high = load_addr + kernel_size;
     }
 
     if (kernel_size < 0) {
@@ -98,12 +189,40 @@ void arc_load_kernel(ARCCPU *cpu, struct arc_boot_info *info)
         exit(EXIT_FAILURE);
     }
 
-    cpu->env.boot_info = info;
+    if (info->dtb_filename) {
+#ifdef CONFIG_FDT
+        info->dtb_addr = arc_load_dtb(info, kernel_high, top);
+#else
+        error_report("could not load DTB '%s': "
+                     "FDT support is not configured in QEMU",
+                     info->dtb_filename);
+        exit(EXIT_FAILURE);
+#endif
+    } else if (info->initrd_filename) {
+        /*
+         * No DTB to patch: the kernel keeps using its built-in one, so
+         * pass the initrd location with the generic "initrd=" parameter.
+         */
+        const char *cmdline = info->kernel_cmdline ?: "";
 
-    /* Set CPU's PC to point to the entry-point */
-    cpu->env.pc = entry;
-}
+        arc_load_initrd(info, kernel_high, top);
+        info->kernel_cmdline =
+            g_strdup_printf("%s%sinitrd=0x%" HWADDR_PRIx ",%" PRIu64,
+                            cmdline, *cmdline ? " " : "",
+                            info->initrd_start, info->initrd_size);
+    }
+
+    /*
+     * All the cores start at the entry-point: Linux parks the secondary
+     * ones itself, based on the core number read from IDENTITY.
+     */
+    CPU_FOREACH(cs) {
+        ARCCPU *c = ARC_CPU(cs);
 
+        c->env.boot_info = info;
+        c->env.pc = entry;
+    }
+}
 
 /*-*-indent-tabs-mode:nil;tab-width:4;indent-line-function:'insert-tab'-*-*/
 /* vim: set ts=4 sw=4 et: */
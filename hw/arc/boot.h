@@ -9,6 +9,13 @@ struct arc_boot_info {
     uint64_t ram_size;
     const char *kernel_filename;
     const char *kernel_cmdline;
+    const char *initrd_filename;
+    const char *dtb_filename;
+
+    /* Filled in by arc_load_kernel(). */
+    hwaddr initrd_start;
+    uint64_t initrd_size;
+    hwaddr dtb_addr;
 };
 
 void arc_cpu_reset(void *opaque);
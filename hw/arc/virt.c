@@ -27,6 +27,8 @@
 #include "hw/sysbus.h"
 #include "hw/arc/virt.h"
 
+#define VIRT_MAX_CPUS      16
+
 #define VIRT_IO_BASE       0xf0000000
 #define VIRT_IO_SIZE       0x10000000
 
@@ -117,12 +119,15 @@ static void virt_init(MachineState *machine)
     MemoryRegion *system_ram0;
     MemoryRegion *system_io;
     ARCCPU *cpu = NULL;
+    ARCCPU *boot_cpu = NULL;
     int n;
 
     boot_info.ram_start = vms->ram_start;
     boot_info.ram_size = machine->ram_size;
     boot_info.kernel_filename = machine->kernel_filename;
     boot_info.kernel_cmdline = machine->kernel_cmdline;
+    boot_info.initrd_filename = machine->initrd_filename;
+    boot_info.dtb_filename = machine->dtb;
 
     for (n = 0; n < smp_cpus; n++) {
 #if defined(TARGET_ARC32)
@@ -136,6 +141,10 @@ static void virt_init(MachineState *machine)
             fprintf(stderr, "Unable to find CPU definition!\n");
             exit(1);
         }
+        cpu->core_id = n;
+        if (boot_cpu == NULL) {
+            boot_cpu = cpu;
+        }
 
        /* Initialize internal devices. */
         cpu_arc_pic_init(cpu);
@@ -163,26 +172,27 @@ static void virt_init(MachineState *machine)
 
     for (n = 0; n < VIRT_UART_NUMBER; n++) {
         serial_mm_init(system_io, VIRT_UART_OFFSET + VIRT_UART_SIZE * n, 2,
-                       cpu->env.irq[VIRT_UART_IRQ + n], 115200, serial_hd(n),
+                       boot_cpu->env.irq[VIRT_UART_IRQ + n], 115200,
+                       serial_hd(n),
                        DEVICE_NATIVE_ENDIAN);
     }
 
     for (n = 0; n < VIRT_VIRTIO_NUMBER; n++) {
         sysbus_create_simple("virtio-mmio",
                              VIRT_VIRTIO_BASE + VIRT_VIRTIO_SIZE * n,
-                             cpu->env.irq[VIRT_VIRTIO_IRQ + n]);
+                             boot_cpu->env.irq[VIRT_VIRTIO_IRQ + n]);
     }
 
-    create_pcie(cpu);
+    create_pcie(boot_cpu);
 
-    arc_load_kernel(cpu, &boot_info);
+    arc_load_kernel(boot_cpu, &boot_info);
 }
 
 static void virt_machine_init(MachineClass *mc)
 {
     mc->desc = "ARC Virtual Machine";
     mc->init = virt_init;
-    mc->max_cpus = 1;
+    mc->max_cpus = VIRT_MAX_CPUS;
     mc->is_default = true;
     mc->default_ram_size = 2 * GiB;
 }
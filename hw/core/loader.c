@@ -139,6 +139,38 @@ int load_image_targphys_as(const char *filename,
     return size;
 }
 
+/* return the size or -1 if error */
+int load_image_mapped_targphys_as(const char *filename,
+                                  hwaddr addr, uint64_t max_sz,
+                                  AddressSpace *as)
+{
+    GMappedFile *mapped_file;
+    GError *gerr = NULL;
+    size_t size;
+
+    /* A writable mapping of a regular file is MAP_PRIVATE, i.e. CoW. */
+    mapped_file = g_mapped_file_new(filename, true, &gerr);
+    if (!mapped_file) {
+        error_report("could not map '%s': %s", filename, gerr->message);
+        g_error_free(gerr);
+        return -1;
+    }
+
+    size = g_mapped_file_get_length(mapped_file);
+    if (size > max_sz || size > INT_MAX) {
+        g_mapped_file_unref(mapped_file);
+        return -1;
+    }
+    if (size > 0) {
+        /* The ROM takes its own reference to the mapping. */
+        rom_add_elf_program(filename, mapped_file,
+                            g_mapped_file_get_contents(mapped_file),
+                            size, size, addr, as);
+    }
+    g_mapped_file_unref(mapped_file);
+    return size;
+}
+
 int load_image_mr(const char *filename, MemoryRegion *mr)
 {
     int size;
@@ -424,6 +424,8 @@ void dump_drift_info(GString *buf);
 /* accel/tcg/translate-all.c */
 void dump_exec_info(GString *buf);
 void dump_opcount_info(GString *buf);
+/* accel/tcg/tb-sample.c */
+void dump_tb_hot_info(GString *buf, int count);
 #endif /* CONFIG_TCG */
 
 #endif /* !CONFIG_USER_ONLY */
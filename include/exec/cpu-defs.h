@@ -76,8 +76,21 @@ typedef uint64_t target_ulong;
 
 #if !defined(CONFIG_USER_ONLY) && defined(CONFIG_TCG)
 
-/* use a fully associative victim tlb of 8 entries */
+/*
+ * Use a fully associative victim tlb, of 8 entries unless cpu-param.h
+ * says otherwise.  The size can also be set with -accel tcg,vtlb-size.
+ */
+#ifndef CPU_VTLB_SIZE
 #define CPU_VTLB_SIZE 8
+#endif
+#define CPU_VTLB_SIZE_MAX 256
+
+/*
+ * The number of separate large page ranges tracked per MMU mode, and
+ * log2 of the number of pages of the largest pages that are not.
+ */
+#define CPU_TLB_LARGE_PAGE_RANGES 4
+#define CPU_TLB_LARGE_PAGE_WALK_BITS 4
 
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
@@ -156,13 +169,21 @@ typedef struct CPUIOTLBEntry {
  */
 typedef struct CPUTLBDesc {
     /*
-     * Describe a region covering all of the large pages allocated
-     * into the tlb.  When any page within this region is flushed,
-     * we must flush the entire tlb.  The region is matched if
-     * (addr & large_page_mask) == large_page_addr.
+     * Describe up to CPU_TLB_LARGE_PAGE_RANGES regions covering all of
+     * the large pages allocated into the tlb.  When any page within a
+     * region is flushed, we must flush every page of that region, or
+     * the entire tlb if the region is too big.  Region i is matched if
+     * (addr & large_page_mask[i]) == large_page_addr[i].  The first
+     * n_large_pages regions are in use.
+     *
+     * Large pages of up to 1 << CPU_TLB_LARGE_PAGE_WALK_BITS pages are
+     * not tracked that way: flushing any page flushes all of the pages
+     * in the same (addr & large_page_walk_mask) block instead.
      */
-    target_ulong large_page_addr;
-    target_ulong large_page_mask;
+    target_ulong large_page_addr[CPU_TLB_LARGE_PAGE_RANGES];
+    target_ulong large_page_mask[CPU_TLB_LARGE_PAGE_RANGES];
+    unsigned int n_large_pages;
+    target_ulong large_page_walk_mask;
     /* host time (in ns) at the beginning of the time window */
     int64_t window_begin_ns;
     /* maximum number of entries observed in the window */
@@ -170,9 +191,11 @@ typedef struct CPUTLBDesc {
     size_t n_used_entries;
     /* The next index to use in the tlb victim table.  */
     size_t vindex;
+    /* The number of entries in the tlb victim table.  */
+    size_t vsize;
     /* The tlb victim table, in two parts.  */
-    CPUTLBEntry vtable[CPU_VTLB_SIZE];
-    CPUIOTLBEntry viotlb[CPU_VTLB_SIZE];
+    CPUTLBEntry *vtable;
+    CPUIOTLBEntry *viotlb;
     /* The iotlb.  */
     CPUIOTLBEntry *iotlb;
 } CPUTLBDesc;
@@ -208,6 +231,8 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    /* MMU modes flushed whole because of a large page.  */
+    size_t large_flush_count;
 } CPUTLBCommon;
 
 /*
@@ -206,6 +206,47 @@ void cpu_stl_le_mmuidx_ra(CPUArchState *env, abi_ptr ptr, uint32_t val,
 void cpu_stq_le_mmuidx_ra(CPUArchState *env, abi_ptr ptr, uint64_t val,
                           int mmu_idx, uintptr_t ra);
 
+/**
+ * guest_memcpy:
+ * @env: CPUArchState
+ * @dest: guest virtual address of the destination
+ * @src: guest virtual address of the source
+ * @len: number of bytes, a multiple of the element size
+ * @mop: MO_SIZE gives the element size
+ * @mmu_idx: MMU index to use for the accesses
+ * @ra: host return address for exceptions
+ *
+ * Copy @len bytes of guest memory as if one element at a time, in
+ * ascending address order, so that a destination just above the source
+ * repeats its first elements.  Each page is probed once and RAM is copied
+ * with host memcpy; elements on MMIO pages or pages with watchpoints are
+ * loaded and stored one by one with @mop's size.  On an exception, the
+ * pages before the faulting one have been written.
+ */
+void guest_memcpy(CPUArchState *env, abi_ptr dest, abi_ptr src, abi_ptr len,
+                  MemOp mop, int mmu_idx, uintptr_t ra);
+
+/**
+ * guest_memmove:
+ *
+ * Like guest_memcpy(), but copy as if through a temporary buffer.  When
+ * the destination overlaps the end of the source, the copy is done in
+ * descending address order, and an exception leaves the pages after the
+ * faulting one written.
+ */
+void guest_memmove(CPUArchState *env, abi_ptr dest, abi_ptr src, abi_ptr len,
+                   MemOp mop, int mmu_idx, uintptr_t ra);
+
+/**
+ * guest_memset:
+ *
+ * Fill @len bytes of guest memory at @dest with copies of @val, an
+ * element of @mop's size in target byte order, in ascending address
+ * order like guest_memcpy().
+ */
+void guest_memset(CPUArchState *env, abi_ptr dest, uint64_t val, abi_ptr len,
+                  MemOp mop, int mmu_idx, uintptr_t ra);
+
 uint8_t cpu_ldb_mmu(CPUArchState *env, abi_ptr ptr, MemOpIdx oi, uintptr_t ra);
 uint16_t cpu_ldw_be_mmu(CPUArchState *env, abi_ptr ptr,
                         MemOpIdx oi, uintptr_t ra);
@@ -19,13 +19,7 @@ static inline void gen_io_start(void)
 
 static inline void gen_tb_start(const TranslationBlock *tb)
 {
-    TCGv_i32 count;
-
-    if (tb_cflags(tb) & CF_USE_ICOUNT) {
-        count = tcg_temp_local_new_i32();
-    } else {
-        count = tcg_temp_new_i32();
-    }
+    TCGv_i32 count = tcg_temp_new_i32();
 
     tcg_gen_ld_i32(count, cpu_env,
                    offsetof(ArchCPU, neg.icount_decr.u32) -
@@ -39,6 +33,15 @@ static inline void gen_tb_start(const TranslationBlock *tb)
          */
         tcg_gen_sub_i32(count, count, tcg_constant_i32(0));
         icount_start_insn = tcg_last_op();
+
+        /*
+         * Store the decremented counter before the check, so that count
+         * dies at the branch instead of living in a stack slot across
+         * it.  The exit path in gen_tb_end() gives the instructions back.
+         */
+        tcg_gen_st16_i32(count, cpu_env,
+                         offsetof(ArchCPU, neg.icount_decr.u16.low) -
+                         offsetof(ArchCPU, env));
     }
 
     /*
@@ -56,9 +59,6 @@ static inline void gen_tb_start(const TranslationBlock *tb)
     }
 
     if (tb_cflags(tb) & CF_USE_ICOUNT) {
-        tcg_gen_st16_i32(count, cpu_env,
-                         offsetof(ArchCPU, neg.icount_decr.u16.low) -
-                         offsetof(ArchCPU, env));
         /*
          * cpu->can_do_io is cleared automatically here at the beginning of
          * each translation block.  The cost is minimal and only paid for
@@ -87,6 +87,23 @@ static inline void gen_tb_end(const TranslationBlock *tb, int num_insns)
 
     if (tcg_ctx->exitreq_label) {
         gen_set_label(tcg_ctx->exitreq_label);
+        if (tb_cflags(tb) & CF_USE_ICOUNT) {
+            /*
+             * None of the TB ran: undo the store gen_tb_start() did ahead
+             * of the check.  Only the low half was written, so an exit
+             * request in the high half is left alone.
+             */
+            TCGv_i32 count = tcg_temp_new_i32();
+
+            tcg_gen_ld16u_i32(count, cpu_env,
+                              offsetof(ArchCPU, neg.icount_decr.u16.low) -
+                              offsetof(ArchCPU, env));
+            tcg_gen_addi_i32(count, count, num_insns);
+            tcg_gen_st16_i32(count, cpu_env,
+                             offsetof(ArchCPU, neg.icount_decr.u16.low) -
+                             offsetof(ArchCPU, env));
+            tcg_temp_free_i32(count);
+        }
         tcg_gen_exit_tb(tb, TB_EXIT_REQUESTED);
     }
 }
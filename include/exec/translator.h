@@ -152,10 +152,33 @@ void translator_loop_temp_check(DisasContextBase *db);
  * @dest: target pc of the goto
  *
  * Return true if goto_tb is allowed between the current TB
- * and the destination PC.
+ * and the destination PC.  If so, @dest is also noted as a
+ * successor of the TB, for tb-prefetch to translate.
  */
 bool translator_use_goto_tb(DisasContextBase *db, target_ulong dest);
 
+/**
+ * translator_forget_succ
+ * @db: Disassembly context
+ * @dest: target pc of a goto_tb
+ *
+ * Do not translate @dest ahead of time after all: the current TB
+ * changes vCPU state that the translation of @dest depends on, so it
+ * can only be translated once the current TB has run.
+ */
+void translator_forget_succ(DisasContextBase *db, target_ulong dest);
+
+/**
+ * translator_uses_cpu_state
+ * @db: Disassembly context
+ *
+ * Note that the code generated for the current TB depends on vCPU
+ * state other than its pc, cs_base and flags.  Such a TB is only
+ * translated for the vCPU that is about to run it: tb-prefetch and
+ * tb-cache do not translate it ahead of time.
+ */
+void translator_uses_cpu_state(DisasContextBase *db);
+
 /*
  * Translator Load Functions
  *
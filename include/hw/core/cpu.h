@@ -230,8 +230,36 @@ struct kvm_run;
 struct hax_vcpu_state;
 struct hvf_vcpu_state;
 
+/*
+ * The jump cache is set associative, with TB_JMP_CACHE_WAYS entries per
+ * set; TB_JMP_CACHE_BITS is the default log2 of its size, which can be
+ * changed with "-accel tcg,jmp-cache-bits=N".
+ */
 #define TB_JMP_CACHE_BITS 12
-#define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+#define TB_JMP_CACHE_BITS_MAX 20
+#define TB_JMP_CACHE_WAYS_BITS 2
+#define TB_JMP_CACHE_WAYS (1 << TB_JMP_CACHE_WAYS_BITS)
+
+typedef struct TBJmpCacheEntry {
+    /* Accessed in parallel; all accesses must be atomic */
+    TranslationBlock *tb;
+    vaddr pc;
+    /* CPUState.tb_jmp_cache_gen when the entry was last validated */
+    uint32_t gen;
+} TBJmpCacheEntry;
+
+/*
+ * Shadow stack of guest return addresses, with the TB last returned to
+ * at each of them.  It is circular: a deep call chain overwrites its
+ * oldest entries, which then simply mispredict.
+ */
+#define TB_RET_STACK_BITS 4
+#define TB_RET_STACK_SIZE (1 << TB_RET_STACK_BITS)
+
+typedef struct TBRetStackEntry {
+    vaddr pc;
+    TranslationBlock *tb;
+} TBRetStackEntry;
 
 /* work queue */
 
@@ -361,8 +389,17 @@ struct CPUState {
     CPUArchState *env_ptr;
     IcountDecr *icount_decr_ptr;
 
-    /* Accessed in parallel; all accesses must be atomic */
-    TranslationBlock *tb_jmp_cache[TB_JMP_CACHE_SIZE];
+    TBJmpCacheEntry *tb_jmp_cache;
+    unsigned int tb_jmp_cache_bits;
+    uint32_t tb_jmp_cache_gen;
+    size_t tb_jmp_cache_hits;
+    size_t tb_jmp_cache_misses;
+    size_t tb_jmp_cache_revalidations;
+
+    TBRetStackEntry tb_ret_stack[TB_RET_STACK_SIZE];
+    unsigned int tb_ret_stack_top;
+    size_t tb_ret_stack_hits;
+    size_t tb_ret_stack_misses;
 
     struct GDBRegisterState *gdb_regs;
     int gdb_num_regs;
@@ -442,12 +479,26 @@ extern CPUTailQ cpus;
 
 extern __thread CPUState *current_cpu;
 
-static inline void cpu_tb_jmp_cache_clear(CPUState *cpu)
+/* Forget the TBs of the return stack, keeping its return addresses. */
+static inline void cpu_tb_ret_stack_clear(CPUState *cpu)
 {
     unsigned int i;
 
-    for (i = 0; i < TB_JMP_CACHE_SIZE; i++) {
-        qatomic_set(&cpu->tb_jmp_cache[i], NULL);
+    for (i = 0; i < TB_RET_STACK_SIZE; i++) {
+        cpu->tb_ret_stack[i].tb = NULL;
+    }
+}
+
+static inline void cpu_tb_jmp_cache_clear(CPUState *cpu)
+{
+    size_t i;
+
+    cpu_tb_ret_stack_clear(cpu);
+    if (!cpu->tb_jmp_cache) {
+        return;
+    }
+    for (i = 0; i < (size_t)1 << cpu->tb_jmp_cache_bits; i++) {
+        qatomic_set(&cpu->tb_jmp_cache[i].tb, NULL);
     }
 }
 
@@ -109,6 +109,16 @@ struct TCGCPUOps {
      */
     bool (*io_recompile_replay_branch)(CPUState *cpu,
                                        const TranslationBlock *tb);
+    /**
+     * @prefetch_prepare: Callback for translating ahead of execution.
+     *
+     * @cpu is a private copy of a vCPU, taken when it translated a
+     * block that may jump to @pc.  Adjust its state for translating the
+     * block at @pc, or return false if the translator would depend on
+     * state of the vCPU that is not known until it gets there.
+     * By default, when this is NULL, any block may be translated ahead.
+     */
+    bool (*prefetch_prepare)(CPUState *cpu, vaddr pc);
 #else
     /**
      * record_sigsegv:
@@ -43,6 +43,24 @@ ssize_t load_image_size(const char *filename, void *addr, size_t size);
 int load_image_targphys_as(const char *filename,
                            hwaddr addr, uint64_t max_sz, AddressSpace *as);
 
+/**load_image_mapped_targphys_as:
+ * @filename: Path to the image file
+ * @addr: Address to load the image to
+ * @max_sz: The maximum size of the image to load
+ * @as: The AddressSpace to load the image to. The value of
+ *      address_space_memory is used if nothing is supplied here.
+ *
+ * Same as load_image_targphys_as(), but instead of reading the file into
+ * a heap buffer the ROM blob keeps a private (copy-on-write) mapping of
+ * the file, so large images such as initrds do not have to be read and
+ * duplicated in host memory before they are copied into the guest.
+ *
+ * Returns the size of the loaded image on success, -1 otherwise.
+ */
+int load_image_mapped_targphys_as(const char *filename,
+                                  hwaddr addr, uint64_t max_sz,
+                                  AddressSpace *as);
+
 /**load_targphys_hex_as:
  * @filename: Path to the .hex file
  * @entry: Store the entry point given by the .hex file
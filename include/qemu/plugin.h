@@ -88,9 +88,22 @@ enum plugin_dyn_cb_type {
 enum plugin_dyn_cb_subtype {
     PLUGIN_CB_REGULAR,
     PLUGIN_CB_INLINE,
+    PLUGIN_CB_COND,
     PLUGIN_N_CB_SUBTYPES,
 };
 
+/*
+ * Per-vCPU storage of plugins. @data holds @alloc_size entries, one per
+ * vCPU index, each @stride bytes apart. Generated code reads @data at
+ * run-time, so that it can be reallocated when vCPUs are added.
+ */
+struct qemu_plugin_scoreboard {
+    void *data;
+    size_t element_size;
+    size_t stride;
+    QLIST_ENTRY(qemu_plugin_scoreboard) entry;
+};
+
 /*
  * A dynamic callback has an insertion point that is determined at run-time.
  * Usually the insertion point is somewhere in the code cache; think for
@@ -104,10 +117,17 @@ struct qemu_plugin_dyn_cb {
     enum qemu_plugin_mem_rw rw;
     /* fields specific to each dyn_cb type go here */
     union {
+        /* @entry.score is NULL for ops on the single counter at @userp */
         struct {
             enum qemu_plugin_op op;
+            qemu_plugin_u64 entry;
             uint64_t imm;
         } inline_insn;
+        struct {
+            enum qemu_plugin_cond cond;
+            qemu_plugin_u64 entry;
+            uint64_t imm;
+        } cond;
     };
 };
 
@@ -50,7 +50,7 @@ typedef uint64_t qemu_plugin_id_t;
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 1
+#define QEMU_PLUGIN_VERSION 2
 
 /**
  * struct qemu_info_t - system information for plugins
@@ -209,6 +209,27 @@ void qemu_plugin_register_vcpu_resume_cb(qemu_plugin_id_t id,
 struct qemu_plugin_tb;
 /** struct qemu_plugin_insn - Opaque handle for a translated instruction */
 struct qemu_plugin_insn;
+/**
+ * struct qemu_plugin_scoreboard - Opaque handle for a scoreboard
+ *
+ * A scoreboard holds one entry of a given size per vCPU. Each entry
+ * starts on its own cache line, so that vCPUs updating their entries
+ * from inline ops do not contend with each other.
+ */
+struct qemu_plugin_scoreboard;
+
+/**
+ * typedef qemu_plugin_u64 - uint64_t member of a scoreboard entry
+ * @score: the scoreboard
+ * @offset: offset of the uint64_t in the entry
+ *
+ * Names the same counter in the entry of every vCPU. Build it with
+ * qemu_plugin_scoreboard_u64() or qemu_plugin_scoreboard_u64_in_struct().
+ */
+typedef struct {
+    struct qemu_plugin_scoreboard *score;
+    size_t offset;
+} qemu_plugin_u64;
 
 /**
  * enum qemu_plugin_cb_flags - type of callback
@@ -273,12 +294,40 @@ void qemu_plugin_register_vcpu_tb_exec_cb(struct qemu_plugin_tb *tb,
  * enum qemu_plugin_op - describes an inline op
  *
  * @QEMU_PLUGIN_INLINE_ADD_U64: add an immediate value uint64_t
+ * @QEMU_PLUGIN_INLINE_STORE_U64: store an immediate value uint64_t
  *
- * Note: currently only a single inline op is supported.
+ * Any number of inline ops may be registered for the same event; they
+ * are run in the order they were registered in.
  */
 
 enum qemu_plugin_op {
     QEMU_PLUGIN_INLINE_ADD_U64,
+    QEMU_PLUGIN_INLINE_STORE_U64,
+};
+
+/**
+ * enum qemu_plugin_cond - condition of a conditional callback
+ *
+ * @QEMU_PLUGIN_COND_NEVER: never call
+ * @QEMU_PLUGIN_COND_ALWAYS: always call, like an unconditional callback
+ * @QEMU_PLUGIN_COND_EQ: call if the counter is equal to the immediate
+ * @QEMU_PLUGIN_COND_NE: call if the counter is not equal to it
+ * @QEMU_PLUGIN_COND_LT: call if the counter is lower than it
+ * @QEMU_PLUGIN_COND_LE: call if the counter is lower than or equal to it
+ * @QEMU_PLUGIN_COND_GT: call if the counter is greater than it
+ * @QEMU_PLUGIN_COND_GE: call if the counter is greater than or equal to it
+ *
+ * Counters and immediates compare as unsigned values.
+ */
+enum qemu_plugin_cond {
+    QEMU_PLUGIN_COND_NEVER,
+    QEMU_PLUGIN_COND_ALWAYS,
+    QEMU_PLUGIN_COND_EQ,
+    QEMU_PLUGIN_COND_NE,
+    QEMU_PLUGIN_COND_LT,
+    QEMU_PLUGIN_COND_LE,
+    QEMU_PLUGIN_COND_GT,
+    QEMU_PLUGIN_COND_GE,
 };
 
 /**
@@ -299,6 +348,45 @@ void qemu_plugin_register_vcpu_tb_exec_inline(struct qemu_plugin_tb *tb,
                                               enum qemu_plugin_op op,
                                               void *ptr, uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu() - per-vCPU inline op
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the counter to update, in the entry of the executing vCPU
+ * @imm: the op data (e.g. 1)
+ *
+ * Like qemu_plugin_register_vcpu_tb_exec_inline(), but each vCPU
+ * updates its own copy of the counter, so the results are exact.
+ */
+void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+    struct qemu_plugin_tb *tb,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm);
+
+/**
+ * qemu_plugin_register_vcpu_tb_exec_cond_cb() - conditional execution cb
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition on the counter of the executing vCPU
+ * @entry: the counter
+ * @imm: the value the counter is compared with
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * The @cb function is called every time a translated unit executes
+ * while @cond holds for the counter. The comparison is inline: it costs
+ * much less than a call when it fails. It sees the inline ops that
+ * were registered for the unit before the callback.
+ */
+void qemu_plugin_register_vcpu_tb_exec_cond_cb(struct qemu_plugin_tb *tb,
+                                               qemu_plugin_vcpu_udata_cb_t cb,
+                                               enum qemu_plugin_cb_flags flags,
+                                               enum qemu_plugin_cond cond,
+                                               qemu_plugin_u64 entry,
+                                               uint64_t imm,
+                                               void *userdata);
+
 /**
  * qemu_plugin_register_vcpu_insn_exec_cb() - register insn execution cb
  * @insn: the opaque qemu_plugin_insn handle for an instruction
@@ -327,6 +415,44 @@ void qemu_plugin_register_vcpu_insn_exec_inline(struct qemu_plugin_insn *insn,
                                                 enum qemu_plugin_op op,
                                                 void *ptr, uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu() - per-vCPU inline op
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the counter to update, in the entry of the executing vCPU
+ * @imm: the op data (e.g. 1)
+ *
+ * Like qemu_plugin_register_vcpu_insn_exec_inline(), but each vCPU
+ * updates its own copy of the counter.
+ */
+void qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+    struct qemu_plugin_insn *insn,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm);
+
+/**
+ * qemu_plugin_register_vcpu_insn_exec_cond_cb() - conditional insn cb
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition on the counter of the executing vCPU
+ * @entry: the counter
+ * @imm: the value the counter is compared with
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * The @cb function is called every time the instruction is executed
+ * while @cond holds for the counter.
+ */
+void qemu_plugin_register_vcpu_insn_exec_cond_cb(
+    struct qemu_plugin_insn *insn,
+    qemu_plugin_vcpu_udata_cb_t cb,
+    enum qemu_plugin_cb_flags flags,
+    enum qemu_plugin_cond cond,
+    qemu_plugin_u64 entry,
+    uint64_t imm,
+    void *userdata);
+
 /**
  * qemu_plugin_tb_n_insns() - query helper for number of insns in TB
  * @tb: opaque handle to TB passed to callback
@@ -496,6 +622,23 @@ void qemu_plugin_register_vcpu_mem_inline(struct qemu_plugin_insn *insn,
                                           enum qemu_plugin_op op, void *ptr,
                                           uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_mem_inline_per_vcpu() - per-vCPU mem inline op
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @rw: monitor reads, writes or both
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the counter to update, in the entry of the executing vCPU
+ * @imm: the op data (e.g. 1)
+ *
+ * Run @op on every memory access of the instruction.
+ */
+void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+    struct qemu_plugin_insn *insn,
+    enum qemu_plugin_mem_rw rw,
+    enum qemu_plugin_op op,
+    qemu_plugin_u64 entry,
+    uint64_t imm);
+
 
 
 typedef void
@@ -571,6 +714,76 @@ int qemu_plugin_n_vcpus(void);
 /* returns -1 in user-mode */
 int qemu_plugin_n_max_vcpus(void);
 
+/**
+ * qemu_plugin_scoreboard_new() - alloc a new scoreboard
+ * @element_size: size, in bytes, of the entry of each vCPU
+ *
+ * Returns a scoreboard with a zeroed entry for each vCPU, present or
+ * yet to be created. Entries are made room for as vCPUs come up.
+ */
+struct qemu_plugin_scoreboard *qemu_plugin_scoreboard_new(size_t element_size);
+
+/**
+ * qemu_plugin_scoreboard_free() - free a scoreboard
+ * @score: scoreboard to free
+ *
+ * No code may refer to @score any more, e.g. from an atexit callback.
+ */
+void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
+
+/**
+ * qemu_plugin_scoreboard_find() - get the entry of a vCPU
+ * @score: scoreboard to query
+ * @vcpu_index: index of the vCPU
+ *
+ * The address may change as vCPUs get added: do not keep it across
+ * callbacks.
+ */
+void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                                  unsigned int vcpu_index);
+
+/* Counter at the start of the entries of a scoreboard */
+static inline qemu_plugin_u64
+qemu_plugin_scoreboard_u64(struct qemu_plugin_scoreboard *score)
+{
+    return (qemu_plugin_u64) { score, 0 };
+}
+
+/* Counter @member of the struct type @type of the entries */
+#define qemu_plugin_scoreboard_u64_in_struct(score, type, member) \
+    ((qemu_plugin_u64) { score, offsetof(type, member) })
+
+/**
+ * qemu_plugin_u64_add() - add a value to the counter of a vCPU
+ * @entry: the counter
+ * @vcpu_index: index of the vCPU
+ * @added: value to add
+ */
+void qemu_plugin_u64_add(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t added);
+
+/**
+ * qemu_plugin_u64_get() - value of the counter of a vCPU
+ * @entry: the counter
+ * @vcpu_index: index of the vCPU
+ */
+uint64_t qemu_plugin_u64_get(qemu_plugin_u64 entry, unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_u64_set() - set the counter of a vCPU
+ * @entry: the counter
+ * @vcpu_index: index of the vCPU
+ * @val: new value
+ */
+void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t val);
+
+/**
+ * qemu_plugin_u64_sum() - sum of the counter over all vCPUs
+ * @entry: the counter
+ */
+uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry);
+
 /**
  * qemu_plugin_outs() - output string via QEMU's logging system
  * @string: a string
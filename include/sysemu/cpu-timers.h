@@ -50,6 +50,12 @@ int64_t icount_get(void);
  */
 int64_t icount_to_ns(int64_t icount);
 
+/*
+ * true if the running vCPU can keep going after a change of the
+ * QEMU_CLOCK_VIRTUAL deadline: its budget ends before the deadline.
+ */
+bool icount_deadline_past_budget(CPUState *cpu);
+
 /* configure the icount options, including "shift" */
 void icount_configure(QemuOpts *opts, Error **errp);
 
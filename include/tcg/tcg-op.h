@@ -830,6 +830,26 @@ void tcg_gen_goto_tb(unsigned idx);
  */
 void tcg_gen_lookup_and_goto_ptr(void);
 
+/**
+ * tcg_gen_lookup_and_goto_ptr_ret() - tcg_gen_lookup_and_goto_ptr() for
+ * a guest function return
+ *
+ * With "-accel tcg,return-stack=on", the TB to jump to is predicted from
+ * the return address pushed by the matching tcg_gen_push_return(), which
+ * saves looking it up when the prediction is right.
+ */
+void tcg_gen_lookup_and_goto_ptr_ret(void);
+
+/**
+ * tcg_gen_push_return() - record a guest function call
+ * @addr: Guest address the call returns to
+ *
+ * Emit at every call instruction, on the path where the call is taken,
+ * so that returns through tcg_gen_lookup_and_goto_ptr_ret() can be
+ * predicted.  Nothing is emitted unless the return stack is enabled.
+ */
+void tcg_gen_push_return(TCGv addr);
+
 static inline void tcg_gen_plugin_cb_start(unsigned from, unsigned type,
                                            unsigned wr)
 {
@@ -844,6 +864,7 @@ static inline void tcg_gen_plugin_cb_end(void)
 #if TARGET_LONG_BITS == 32
 #define tcg_temp_new() tcg_temp_new_i32()
 #define tcg_global_mem_new tcg_global_mem_new_i32
+#define tcg_global_set_restorable tcg_global_set_restorable_i32
 #define tcg_temp_local_new() tcg_temp_local_new_i32()
 #define tcg_temp_free tcg_temp_free_i32
 #define tcg_gen_qemu_ld_tl tcg_gen_qemu_ld_i32
@@ -851,6 +872,7 @@ static inline void tcg_gen_plugin_cb_end(void)
 #else
 #define tcg_temp_new() tcg_temp_new_i64()
 #define tcg_global_mem_new tcg_global_mem_new_i64
+#define tcg_global_set_restorable tcg_global_set_restorable_i64
 #define tcg_temp_local_new() tcg_temp_local_new_i64()
 #define tcg_temp_free tcg_temp_free_i64
 #define tcg_gen_qemu_ld_tl tcg_gen_qemu_ld_i64
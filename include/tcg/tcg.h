@@ -267,6 +267,10 @@ struct TCGLabel {
         uintptr_t value;
         const tcg_insn_unit *value_ptr;
     } u;
+    /* Extended basic block allocation, see tcg_reg_alloc_label().  */
+    uint8_t *la_globals;        /* state of the globals at the label */
+    struct TCGTemp **ebb_regs;  /* globals kept in registers by all refs */
+    unsigned ebb_refs;          /* refs seen by the register allocator */
     QSIMPLEQ_HEAD(, TCGRelocation) relocs;
     QSIMPLEQ_ENTRY(TCGLabel) next;
 };
@@ -454,6 +458,7 @@ typedef struct TCGTemp {
     unsigned int mem_coherent:1;
     unsigned int mem_allocated:1;
     unsigned int temp_allocated:1;
+    unsigned int restorable:1;
 
     int64_t val;
     struct TCGTemp *mem_base;
@@ -530,6 +535,8 @@ typedef struct TCGProfile {
     int64_t opt_time;
     int64_t restore_count;
     int64_t restore_time;
+    int64_t spill_count;  /* temps stored to memory */
+    int64_t reload_count; /* temps loaded from memory */
     int64_t table_op_count[NB_OPS];
 } TCGProfile;
 
@@ -550,6 +557,9 @@ struct TCGContext {
 
     TCGRegSet reserved_regs;
     uint32_t tb_cflags; /* cflags of the current TB */
+    bool ebb_regalloc;  /* keep globals in registers across labels */
+    bool ebb_unreachable; /* the register allocator is past a br/exit */
+    bool return_stack;  /* predict guest returns, see tcg_gen_push_return */
     intptr_t current_frame_offset;
     intptr_t frame_start;
     intptr_t frame_end;
@@ -612,6 +622,8 @@ struct TCGContext {
 
     QTAILQ_HEAD(, TCGOp) ops, free_ops;
     QSIMPLEQ_HEAD(, TCGLabel) labels;
+    /* If set, tcg_emit_op() inserts ops before this one, not at the end */
+    TCGOp *emit_before_op;
 
     /* Tells which temporary holds a given register.
        It does not take into account fixed registers */
@@ -620,6 +632,12 @@ struct TCGContext {
     uint16_t gen_insn_end_off[TCG_MAX_INSNS];
     target_ulong gen_insn_data[TCG_MAX_INSNS][TARGET_INSN_START_WORDS];
 
+    /* Direct jump targets of the TB, noted by translator_use_goto_tb() */
+    target_ulong tb_succ[2];
+    int nb_tb_succ;
+    /* Set by translator_uses_cpu_state() */
+    bool tb_cpu_state;
+
     /* Exit to translator on overflow. */
     sigjmp_buf jmp_trans;
 };
@@ -804,6 +822,15 @@ void tcg_pool_reset(TCGContext *s);
 TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_reset_all(void);
+size_t tcg_region_count(void);
+ssize_t tcg_region_index(const void *p);
+void tcg_region_tb_foreach(size_t idx, GTraverseFunc func, gpointer user_data);
+bool tcg_region_evict_wanted(void);
+bool tcg_region_evict_pending(void);
+bool tcg_region_evict_enabled(void);
+ssize_t tcg_region_evict_begin(const unsigned long *hot, unsigned int *token);
+void tcg_region_retire_all(unsigned long *retired, unsigned int *token);
+void tcg_region_evict_end(size_t idx, unsigned int token);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
@@ -833,7 +860,8 @@ static inline void *tcg_malloc(int size)
     }
 }
 
-void tcg_init(size_t tb_size, int splitwx, unsigned max_cpus);
+void tcg_init(size_t tb_size, int splitwx, unsigned max_cpus,
+              unsigned n_workers, bool evict);
 void tcg_register_thread(void);
 void tcg_prologue_init(TCGContext *s);
 void tcg_func_start(TCGContext *s);
@@ -846,6 +874,7 @@ TCGTemp *tcg_global_mem_new_internal(TCGType, TCGv_ptr,
                                      intptr_t, const char *);
 TCGTemp *tcg_temp_new_internal(TCGType, bool);
 void tcg_temp_free_internal(TCGTemp *);
+void tcg_global_set_restorable_internal(TCGTemp *);
 TCGv_vec tcg_temp_new_vec(TCGType type);
 TCGv_vec tcg_temp_new_vec_matching(TCGv_vec match);
 
@@ -876,6 +905,18 @@ static inline TCGv_i32 tcg_global_mem_new_i32(TCGv_ptr reg, intptr_t offset,
     return temp_tcgv_i32(t);
 }
 
+/*
+ * Declare that restore_state_to_opc() recomputes the value of the global
+ * from the insn_start data, whenever the TB raises an exception.  It is
+ * then not stored back to env before guest loads and stores, but only at
+ * the end of basic blocks and before helpers that read globals, so that
+ * a value overwritten before then is never stored at all.
+ */
+static inline void tcg_global_set_restorable_i32(TCGv_i32 v)
+{
+    tcg_global_set_restorable_internal(tcgv_i32_temp(v));
+}
+
 static inline TCGv_i32 tcg_temp_new_i32(void)
 {
     TCGTemp *t = tcg_temp_new_internal(TCG_TYPE_I32, false);
@@ -895,6 +936,11 @@ static inline TCGv_i64 tcg_global_mem_new_i64(TCGv_ptr reg, intptr_t offset,
     return temp_tcgv_i64(t);
 }
 
+static inline void tcg_global_set_restorable_i64(TCGv_i64 v)
+{
+    tcg_global_set_restorable_internal(tcgv_i64_temp(v));
+}
+
 static inline TCGv_i64 tcg_temp_new_i64(void)
 {
     TCGTemp *t = tcg_temp_new_internal(TCG_TYPE_I64, false);
@@ -210,10 +210,92 @@ plugin_register_cb_udata(qemu_plugin_id_t id, enum qemu_plugin_event ev,
     do_plugin_register_cb(id, ev, func, udata);
 }
 
+static void plugin_resize_scoreboard__locked(
+    struct qemu_plugin_scoreboard *score, size_t old_size, size_t new_size)
+{
+    void *data = qemu_memalign(PLUGIN_SCOREBOARD_ALIGN,
+                               new_size * score->stride);
+
+    memset(data, 0, new_size * score->stride);
+    if (score->data) {
+        memcpy(data, score->data, old_size * score->stride);
+        qemu_vfree(score->data);
+    }
+    score->data = data;
+}
+
+/*
+ * Make room for @cpu in all scoreboards. In system mode the first vCPU
+ * sizes them for max_cpus, before any vCPU runs. In user mode threads
+ * come and go: the generated code of the other vCPUs may be updating
+ * their entries, so stop them while the data moves.
+ */
+static void plugin_grow_scoreboards(CPUState *cpu)
+{
+    struct qemu_plugin_scoreboard *score;
+    bool exclusive = current_cpu && current_cpu != cpu;
+    int max_vcpus = qemu_plugin_n_max_vcpus();
+    size_t old_size, new_size;
+
+    WITH_QEMU_LOCK_GUARD(&plugin.lock) {
+        if (cpu->cpu_index < plugin.scoreboard_alloc_size) {
+            return;
+        }
+    }
+
+    if (exclusive) {
+        start_exclusive();
+    }
+    qemu_rec_mutex_lock(&plugin.lock);
+    old_size = plugin.scoreboard_alloc_size;
+    if (cpu->cpu_index >= old_size) {
+        new_size = MAX(old_size * 2, cpu->cpu_index + 1);
+        if (max_vcpus > 0) {
+            new_size = MAX(new_size, max_vcpus);
+        }
+        QLIST_FOREACH(score, &plugin.scoreboards, entry) {
+            plugin_resize_scoreboard__locked(score, old_size, new_size);
+        }
+        plugin.scoreboard_alloc_size = new_size;
+    }
+    qemu_rec_mutex_unlock(&plugin.lock);
+    if (exclusive) {
+        end_exclusive();
+    }
+}
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+{
+    struct qemu_plugin_scoreboard *score;
+
+    score = g_new0(struct qemu_plugin_scoreboard, 1);
+    score->element_size = element_size;
+    score->stride = ROUND_UP(MAX(element_size, 1),
+                             PLUGIN_SCOREBOARD_ALIGN);
+
+    QEMU_LOCK_GUARD(&plugin.lock);
+    plugin_resize_scoreboard__locked(score, 0,
+                                     MAX(plugin.scoreboard_alloc_size, 1));
+    QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
+    return score;
+}
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_REMOVE(score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    qemu_vfree(score->data);
+    g_free(score);
+}
+
 void qemu_plugin_vcpu_init_hook(CPUState *cpu)
 {
     bool success;
 
+    plugin_grow_scoreboards(cpu);
+
     qemu_rec_mutex_lock(&plugin.lock);
     plugin_cpu_update__locked(&cpu->cpu_index, NULL, NULL);
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
@@ -291,6 +373,25 @@ void plugin_register_inline_op(GArray **arr,
     dyn_cb->type = PLUGIN_CB_INLINE;
     dyn_cb->rw = rw;
     dyn_cb->inline_insn.op = op;
+    dyn_cb->inline_insn.entry.score = NULL;
+    dyn_cb->inline_insn.entry.offset = 0;
+    dyn_cb->inline_insn.imm = imm;
+}
+
+void plugin_register_inline_op_on_entry(GArray **arr,
+                                        enum qemu_plugin_mem_rw rw,
+                                        enum qemu_plugin_op op,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = NULL;
+    dyn_cb->type = PLUGIN_CB_INLINE;
+    dyn_cb->rw = rw;
+    dyn_cb->inline_insn.op = op;
+    dyn_cb->inline_insn.entry = entry;
     dyn_cb->inline_insn.imm = imm;
 }
 
@@ -307,6 +408,25 @@ void plugin_register_dyn_cb__udata(GArray **arr,
     dyn_cb->type = PLUGIN_CB_REGULAR;
 }
 
+void plugin_register_dyn_cond_cb__udata(GArray **arr,
+                                        qemu_plugin_vcpu_udata_cb_t cb,
+                                        enum qemu_plugin_cb_flags flags,
+                                        enum qemu_plugin_cond cond,
+                                        qemu_plugin_u64 entry,
+                                        uint64_t imm,
+                                        void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+
+    dyn_cb->userp = udata;
+    /* Note flags are discarded as unused. */
+    dyn_cb->f.vcpu_udata = cb;
+    dyn_cb->type = PLUGIN_CB_COND;
+    dyn_cb->cond.cond = cond;
+    dyn_cb->cond.entry = entry;
+    dyn_cb->cond.imm = imm;
+}
+
 void plugin_register_vcpu_mem_cb(GArray **arr,
                                  void *cb,
                                  enum qemu_plugin_cb_flags flags,
@@ -432,14 +552,23 @@ void qemu_plugin_flush_cb(void)
     plugin_cb__simple(QEMU_PLUGIN_EV_FLUSH);
 }
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb)
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index)
 {
+    qemu_plugin_u64 entry = cb->inline_insn.entry;
     uint64_t *val = cb->userp;
 
+    if (entry.score) {
+        val = entry.score->data + cpu_index * entry.score->stride +
+              entry.offset;
+    }
+
     switch (cb->inline_insn.op) {
     case QEMU_PLUGIN_INLINE_ADD_U64:
         *val += cb->inline_insn.imm;
         break;
+    case QEMU_PLUGIN_INLINE_STORE_U64:
+        *val = cb->inline_insn.imm;
+        break;
     default:
         g_assert_not_reached();
     }
@@ -467,7 +596,7 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                            vaddr, cb->userp);
             break;
         case PLUGIN_CB_INLINE:
-            exec_inline_op(cb);
+            exec_inline_op(cb, cpu->cpu_index);
             break;
         default:
             g_assert_not_reached();
@@ -552,6 +681,7 @@ static void __attribute__((__constructor__)) plugin_init(void)
     plugin.id_ht = g_hash_table_new(g_int64_hash, g_int64_equal);
     plugin.cpu_ht = g_hash_table_new(g_int_hash, g_int_equal);
     QTAILQ_INIT(&plugin.ctxs);
+    QLIST_INIT(&plugin.scoreboards);
     qht_init(&plugin.dyn_cb_arr_ht, plugin_dyn_cb_arr_cmp, 16,
              QHT_MODE_AUTO_RESIZE);
     atexit(qemu_plugin_atexit_cb);
@@ -146,11 +146,19 @@ ERST
 DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "-accel [accel=]accelerator[,prop[=value][,...]]\n"
     "                select accelerator (kvm, xen, hax, hvf, nvmm, whpx or tcg; use 'help' for a list)\n"
+    "                ebb-regalloc=on|off (keep TCG globals in registers across labels, default=off)\n"
     "                igd-passthru=on|off (enable Xen integrated Intel graphics passthrough, default=off)\n"
+    "                jmp-cache-bits=n (log2 of the TCG per-vCPU jump cache size, default=12)\n"
     "                kernel-irqchip=on|off|split controls accelerated irqchip support (default=on)\n"
     "                kvm-shadow-mem=size of KVM shadow MMU in bytes\n"
+    "                return-stack=on|off (predict guest function returns in TCG, default=off)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
+    "                tb-cache=file (TCG blocks translated in earlier runs)\n"
+    "                tb-evict=on|off (evict cold translations when the TCG cache is full, default=off)\n"
+    "                tb-prefetch=n (TCG threads translating code ahead of the vCPUs, default=0)\n"
+    "                tb-sample=hz (samples of the running TCG block per second and vCPU, default=0)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                vtlb-size=n (TCG softmmu victim TLB entries per MMU mode)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
 SRST
@@ -161,11 +169,25 @@ SRST
     specified, the next one is used if the previous one fails to
     initialize.
 
+    ``ebb-regalloc=on|off``
+        Lets the TCG register allocator keep guest registers in host
+        registers across the labels inside a translation block, when
+        all of the branches to a label agree on where they are. This
+        saves reloading them after every conditional sequence. The
+        default is off.
+
     ``igd-passthru=on|off``
         When Xen is in use, this option controls whether Intel
         integrated graphics devices can be passed through to the guest
         (default=off)
 
+    ``jmp-cache-bits=n``
+        Sets the size of the cache, private to each TCG vCPU, that maps
+        a guest virtual PC to the translation block executed there last,
+        to 2^n entries. It is 4-way set associative. Guests with many
+        hot indirect branch targets may benefit from a larger cache. n
+        ranges from 4 to 20, and defaults to 12.
+
     ``kernel-irqchip=on|off|split``
         Controls KVM in-kernel irqchip support. The default is full
         acceleration of the interrupt controllers. On x86, split irqchip
@@ -176,15 +198,66 @@ SRST
     ``kvm-shadow-mem=size``
         Defines the size of the KVM shadow MMU.
 
+    ``return-stack=on|off``
+        Keeps a small shadow stack of the guest return addresses, pushed
+        by call instructions, so that a function return can jump
+        straight to the translation block it predicts instead of looking
+        it up. Only targets that mark their calls and returns benefit.
+        The default is off.
+
     ``split-wx=on|off``
         Controls the use of split w^x mapping for the TCG code generation
         buffer. Some operating systems require this to be enabled, and in
         such a case this will default on. On other operating systems, this
         will default off, but one may enable this for testing or debugging.
 
+    ``tb-cache=file``
+        On exit, writes to file where the TCG translation blocks of the
+        run start, along with the contents of their guest pages. The
+        next run reads it back, and once a vCPU runs code from a page
+        with the same contents, the tb-prefetch threads translate the
+        other blocks known to start there. Generated code is not saved:
+        the blocks are still translated from guest memory, but mostly
+        off the vCPU threads. Implies ``tb-prefetch=1`` unless set.
+        Only available with system emulation. ``info jit`` tells how
+        many pages were found in file.
+
+    ``tb-evict=on|off``
+        When the TCG translation block cache fills up, throw away the
+        translations of one of its parts at a time, one not run recently
+        if possible, instead of all of them at once with every vCPU
+        stopped. The cache is split in more parts than usual to that end.
+        Flushes the guest asks for, for instance on an instruction cache
+        invalidation, then do not stop the other vCPUs either, unless
+        a TCG plugin is loaded. Only available with system emulation.
+        The default is off.
+
+    ``tb-prefetch=n``
+        Starts n threads, up to 8, that translate the blocks a vCPU may
+        jump to next while it runs the one just translated, so that it
+        finds them already there. Only direct jumps within the same
+        guest page are followed. Only available with system emulation.
+        The default is 0, which translates code only when it is run.
+
+    ``tb-sample=hz``
+        Notes which translation block each running vCPU is about to
+        execute, hz times per second of guest run time, up to 100000.
+        ``info tb-hot`` then lists the blocks with the most samples.
+        A rate of 1000 costs each vCPU a thousand extra exits from the
+        generated code per second. Only available with system emulation.
+        The default is 0, which samples nothing.
+
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``vtlb-size=n``
+        Sets the number of entries, from 1 to 256, of the fully
+        associative victim TLB that backs the softmmu TLB of each MMU
+        mode of a TCG vCPU. A guest whose working set keeps evicting
+        pages that are used again soon may benefit from a bigger one,
+        at the cost of a longer search on every TLB miss. Only
+        available with system emulation. The default is 8.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -249,9 +249,13 @@ void qemu_timer_notify_cb(void *opaque, QEMUClockType type)
         /*
          * A CPU is currently running; kick it back out to the
          * tcg_cpu_exec() loop so it will recalculate its
-         * icount deadline immediately.
+         * icount deadline immediately.  Guests reprogram their
+         * timers all the time, usually further away than the
+         * budget reaches: then there is nothing to recalculate.
          */
-        qemu_cpu_kick(current_cpu);
+        if (!icount_deadline_past_budget(current_cpu)) {
+            qemu_cpu_kick(current_cpu);
+        }
     } else if (first_cpu) {
         /*
          * qemu_cpu_kick is not enough to kick a halted CPU out of
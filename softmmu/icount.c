@@ -162,6 +162,34 @@ int64_t icount_to_ns(int64_t icount)
     return icount << qatomic_read(&timers_state.icount_time_shift);
 }
 
+/*
+ * Called from the vCPU thread when the QEMU_CLOCK_VIRTUAL deadline
+ * changes.  The vCPU only needs to leave its chain of TBs if the new
+ * deadline comes before the end of its budget: otherwise the timer
+ * still expires when the budget runs out, at the same icount a kick
+ * would have given it.
+ */
+bool icount_deadline_past_budget(CPUState *cpu)
+{
+    int64_t deadline, left;
+
+    /*
+     * Outside of cpu_exec() the budget is recomputed anyway, and
+     * without can_do_io the clock cannot be read here.  Replay wants
+     * its exits where the log has them.
+     */
+    if (!cpu->running || !cpu->can_do_io || cpu->icount_budget <= 0 ||
+        replay_mode != REPLAY_MODE_NONE) {
+        return false;
+    }
+
+    left = cpu_neg(cpu)->icount_decr.u16.low + cpu->icount_extra;
+    deadline = qemu_clock_deadline_ns_all(QEMU_CLOCK_VIRTUAL,
+                                          QEMU_TIMER_ATTR_ALL);
+
+    return deadline < 0 || deadline >= icount_to_ns(left);
+}
+
 /*
  * Correlation between real and virtual time is always going to be
  * fairly approximate, so ignore small variation.
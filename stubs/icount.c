@@ -30,6 +30,11 @@ int64_t icount_to_ns(int64_t icount)
     abort();
     return 0;
 }
+bool icount_deadline_past_budget(CPUState *cpu)
+{
+    abort();
+    return false;
+}
 int64_t icount_round(int64_t count)
 {
     abort();
@@ -24,6 +24,7 @@
 #include "target/arc/cpu.h"
 #include "target/arc/arconnect.h"
 #include "hw/irq.h"
+#include "qemu/main-loop.h"
 
 #define ICI_IRQ 19
 
@@ -100,13 +101,23 @@ enum arconnect_commands {
  */
 void arc_arconnect_init(ARCCPU *cpu)
 {
+    static bool lpa_lfs_initialized;
+
     cpu->env.arconnect.intrpt_status = 0;
 
-    /* Initialize all llock/scond lpa entries and respective mutexes */
-    int i;
-    for(i = 0; i < LPA_LFS_SIZE; i++) {
-        lpa_lfs[i].lpa_lf = 0;
-        qemu_mutex_init(&lpa_lfs[i].mutex);
+    /*
+     * Initialize all llock/scond lpa entries and respective mutexes.
+     * The table is shared by all the cores, so only do it for the first
+     * reset: with MTTCG the other cores may be running by the time a
+     * secondary core gets reset.  Resets happen under the BQL.
+     */
+    if (!lpa_lfs_initialized) {
+        int i;
+        for(i = 0; i < LPA_LFS_SIZE; i++) {
+            lpa_lfs[i].lpa_lf = 0;
+            qemu_mutex_init(&lpa_lfs[i].mutex);
+        }
+        lpa_lfs_initialized = true;
     }
 
     cpu->env.arconnect.lpa_lf = &(lpa_lfs[0]);
@@ -161,14 +172,31 @@ static void arconnect_intercore_intr_unit_cmd(CPUARCState *env, enum arconnect_c
 {
     ARCCPU *cpu = env_archcpu(env);
 
+    if (cmd != CMD_INTRPT_CHECK_SOURCE
+        && get_cpu_for_core(param & 0x1f) == NULL) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "[ICI %d] Command %d for missing core %d ignored\n",
+                      cpu->core_id, cmd, param & 0x1f);
+        return;
+    }
+
     switch(cmd) {
 
     case CMD_INTRPT_GENERATE_IRQ:
         {
           if(((param & 0x80) == 0) && ((param & 0x1f) != cpu->core_id)) {
             uint8_t core_id = param & 0x1f;
+            /* The target core's pic is not ours to touch without the BQL. */
+            bool unlocked = !qemu_mutex_iothread_locked();
+
             arcon_status_set(env, core_id, cpu->core_id);
+            if (unlocked) {
+                qemu_mutex_lock_iothread();
+            }
             qemu_set_irq(get_cpu_for_core(core_id)->env.irq[MCIP_IRQ], 1);
+            if (unlocked) {
+                qemu_mutex_unlock_iothread();
+            }
           }
             //uint8_t core_id = CMD_COREID(cmd);
             //CPUState *cs;
@@ -27,7 +27,6 @@
 struct lpa_lf_entry {
     QemuMutex mutex;
     target_ulong lpa_lf;
-    uint64_t read_value;
 };
 
 struct arc_arcconnect_info {
@@ -35,6 +34,9 @@ struct arc_arcconnect_info {
 
     struct lpa_lf_entry *lpa_lf;
     QemuMutex *locked_mutex;
+    /* Physical address and value read by this core's last LLOCK */
+    hwaddr lpa_lf_addr;
+    uint64_t lpa_lf_value;
 };
 
 #define LPA_LFS_ALIGNEMENT_BITS 2 /* Inforced alignement */
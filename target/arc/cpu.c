@@ -66,6 +66,9 @@ static Property arc_cpu_properties[] = {
     DEFINE_PROP_UINT32("num-banks", ARCCPU, cfg.rgf_num_banks, 0),
     DEFINE_PROP_BOOL("rtc-opt", ARCCPU, cfg.rtc_option, false),
     DEFINE_PROP_UINT32("freq_hz", ARCCPU, cfg.freq_hz, 4600000),
+    DEFINE_PROP_BOOL("cycle-model", ARCCPU, cfg.cycle_model, false),
+    DEFINE_PROP_BOOL("dual-issue", ARCCPU, cfg.dual_issue, false),
+    DEFINE_PROP_BOOL("superblocks", ARCCPU, cfg.superblocks, false),
 
     DEFINE_PROP_STRING("mmuv6-version", ARCCPU, cfg.mmuv6_version),
 
@@ -98,6 +101,29 @@ static void arc_cpu_synchronize_from_tb(CPUState *cs, const TranslationBlock *tb
     env->pc = tb->pc;
 }
 
+#ifndef CONFIG_USER_ONLY
+/*
+ * The translator keeps the delay slot state in env, so a block can only
+ * be translated ahead from a state outside of any delay slot.  It also
+ * reads LP_START/LP_END, which only change in TBs that end with
+ * DISAS_UPDATE: arc_tr_tb_stop() drops the successor of those, and the
+ * block that ends a loop is never translated ahead, as decode_opc()
+ * notes with translator_uses_cpu_state().
+ */
+static bool arc_cpu_prefetch_prepare(CPUState *cs, vaddr pc)
+{
+    ARCCPU *cpu = ARC_CPU(cs);
+    CPUARCState *env = &cpu->env;
+
+    if (env->next_insn_is_delayslot || env->in_delayslot_instruction ||
+        GET_STATUS_BIT(env->stat, PREVIOUS_IS_DELAYSLOTf)) {
+        return false;
+    }
+    arc_cpu_set_pc(cs, pc);
+    return true;
+}
+#endif
+
 static void arc_cpu_reset(DeviceState *dev)
 {
     CPUState *s = CPU(dev);
@@ -403,6 +429,7 @@ static struct TCGCPUOps arc_tcg_ops = {
     .tlb_fill = arc_cpu_tlb_fill,
     .cpu_exec_interrupt = arc_cpu_exec_interrupt,
     .do_interrupt = arc_cpu_do_interrupt,
+    .prefetch_prepare = arc_cpu_prefetch_prepare,
 #endif /* !CONFIG_USER_ONLY */
 };
 #endif /* CONFIG_TCG */
@@ -35,6 +35,12 @@ typedef struct CPUArchState CPUARCState;
 
 #include "hw/registerfields.h"
 
+/*
+ * ARC HS is weakly ordered: DMB is translated into tcg_gen_mb(), so
+ * there is no ordering to enforce on plain loads and stores.
+ */
+#define TCG_GUEST_DEFAULT_MO 0
+
 #define ARC_CPU_TYPE_SUFFIX "-" TYPE_ARC_CPU
 #define ARC_CPU_TYPE_NAME(name) (name ARC_CPU_TYPE_SUFFIX)
 #define CPU_RESOLVING_TYPE TYPE_ARC_CPU
@@ -259,6 +265,11 @@ struct CPUArchState {
 #define TMR_PD  (1 << 4)
     ARCTimer timer[2];    /* ARC CPU-Timer 0/1 */
 
+    /* Cycle model, only used with the "cycle-model" property. */
+    uint64_t cycles;           /* Cycles retired so far. */
+    uint64_t cycles_expire[2]; /* Cycle at which timer 0/1 expires. */
+    uint64_t cycles_deadline;  /* Earliest of cycles_expire. */
+
     /* TODO: Verify correctness of this types for both ARCv2 and v3. */
     ARCIrq irq_bank[256]; /* IRQ register bank */
     uint32_t irq_select;     /* AUX register */
@@ -267,6 +278,7 @@ struct CPUArchState {
     uint32_t icause[16];     /* Banked cause register */
     uint32_t aux_irq_hint;   /* AUX register, used to trigger soft irq */
     target_ulong aux_user_sp;
+    target_ulong aux_jli_base;
     uint32_t aux_irq_ctrl;
     uint32_t aux_rtc_ctrl;
     uint32_t aux_rtc_low;
@@ -310,6 +322,10 @@ struct CPUArchState {
     target_ulong exclusive_addr;
     target_ulong exclusive_val;
     target_ulong exclusive_val_hi;
+
+#ifdef TARGET_ARC64
+    uint64_t lddl_hi;   /* Upper half of an LDDL done by a helper. */
+#endif
 };
 
 struct ARCCPUConfig {
@@ -336,6 +352,9 @@ struct ARCCPUConfig {
     bool     has_timer_0;
     bool     has_timer_1;
     bool     rtc_option;
+    bool     cycle_model; /* Drive the timers from the cycle model. */
+    bool     dual_issue;  /* Pair simple ALU instructions. */
+    bool     superblocks; /* Translate past conditional branches. */
 
     char     *mmuv6_version;
 };
@@ -418,7 +437,7 @@ static inline void cpu_get_tb_cpu_state(CPUARCState *env, target_ulong *pc,
 
 /*
  * @brief vCPU is about to raise SIGSEV. Perform required cleanup
- * At the moment, this just means unlocking llock/scond mutexes and clearing LF
+ * At the moment, this just means clearing the llock/scond LF
  */
 void arc_cpu_record_sigsegv(CPUState *cs, vaddr addr,
                             MMUAccessType access_type,
@@ -426,7 +445,7 @@ void arc_cpu_record_sigsegv(CPUState *cs, vaddr addr,
 
 /*
  * @brief vCPU is about to raise SIGBUS. Perform required cleanup
- * At the moment, this just means unlocking llock/scond mutexes and clearing LF
+ * At the moment, this just means clearing the llock/scond LF
  */
 void arc_cpu_record_sigbus(CPUState *cs, vaddr addr,
                             MMUAccessType access_type,
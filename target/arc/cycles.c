@@ -0,0 +1,216 @@
+/*
+ * QEMU ARC CPU
+ *
+ * Copyright (c) 2022 Synopsys Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ */
+
+/*
+ * Cycle-approximate cost model.
+ *
+ * With the "cycle-model" CPU property, the translator gives every
+ * instruction a cost in cycles and the total for the TB is added to
+ * env->cycles when the TB is entered, much like icount charges its
+ * instruction count.  The timers and the RTC (timer.c) then count
+ * env->cycles instead of QEMU_CLOCK_VIRTUAL.
+ *
+ * The pipeline modelled is a simple in-order one:
+ *  - every instruction issues in one cycle, and with the "dual-issue"
+ *    property two independent ALU instructions issue together;
+ *  - the result of a load, multiply or FPU operation is late: reading
+ *    it from the very next instruction stalls;
+ *  - divides are iterative and hold the pipeline;
+ *  - a taken branch or jump refills the pipeline, which costs one cycle
+ *    less when its delay slot is used.
+ *
+ * Everything but the taken branch penalty is known at translation
+ * time.  A TB left early, through an exception, is still charged for
+ * all of its instructions.
+ */
+
+#include "qemu/osdep.h"
+#include "translate.h"
+#include "target/arc/decoder.h"
+#include "exec/helper-proto.h"
+
+#define ARC_CYCLES_TAKEN_BRANCH 2
+#define ARC_CYCLES_DELAY_SLOT   1
+
+/* Cycles after issue before the result of a class can be read. */
+static const uint8_t arc_cycles_latency[] = {
+    [LOAD]      = 1,
+    [LLOCK]     = 1,
+    [POP]       = 1,
+    [MPY]       = 2,
+    [ARC_FLOAT] = 3,
+    [FLOAT]     = 3,
+};
+
+/* Cycles, on top of the issue one, a class holds the pipeline for. */
+static const uint8_t arc_cycles_busy[] = {
+    [DIVREM]    = 16,
+};
+
+static uint8_t arc_cycles_lookup(const uint8_t *table, size_t size,
+                                 uint32_t class)
+{
+    return class < size ? table[class] : 0;
+}
+
+#define LATENCY(CLASS) \
+    arc_cycles_lookup(arc_cycles_latency, ARRAY_SIZE(arc_cycles_latency), \
+                      CLASS)
+#define BUSY(CLASS) \
+    arc_cycles_lookup(arc_cycles_busy, ARRAY_SIZE(arc_cycles_busy), CLASS)
+
+/* Can this instruction issue together with another one? */
+static bool arc_cycles_can_pair(const insn_t *insn)
+{
+    switch (insn->class) {
+    case ARITH:
+    case LOGICAL:
+    case MOVE:
+    case BITOP:
+        return !insn->limm_p;
+    default:
+        return false;
+    }
+}
+
+static int arc_cycles_dest(const insn_t *insn)
+{
+    if (insn->n_ops > 0 && (insn->operands[0].type & ARC_OPERAND_IR)) {
+        return insn->operands[0].value;
+    }
+    return -1;
+}
+
+/*
+ * Any register operand counts as a read: this also catches a write
+ * after write, which waits for the late result as well.
+ */
+static bool arc_cycles_reads(const insn_t *insn, int reg)
+{
+    int i;
+
+    for (i = 0; i < insn->n_ops; i++) {
+        if ((insn->operands[i].type & ARC_OPERAND_IR)
+            && insn->operands[i].value == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void arc_gen_cycles_tb_start(DisasContext *ctx)
+{
+    TCGv_i32 cost;
+    TCGv_i64 cycles, tmp;
+    TCGLabel *done;
+
+    ctx->cycles = 0;
+    ctx->cycles_dest = -1;
+    ctx->cycles_stall = 0;
+    ctx->cycles_pair = false;
+
+    if (!ctx->cycle_model) {
+        return;
+    }
+
+    cost = tcg_temp_new_i32();
+    cycles = tcg_temp_new_i64();
+    tmp = tcg_temp_new_i64();
+    done = gen_new_label();
+
+    /*
+     * The cost of the TB is not known yet: emit a dummy immediate and
+     * patch it in arc_gen_cycles_tb_stop(), like gen_tb_start() does.
+     */
+    tcg_gen_mov_i32(cost, tcg_constant_i32(0));
+    ctx->cycles_op = tcg_last_op();
+
+    tcg_gen_extu_i32_i64(tmp, cost);
+    tcg_gen_ld_i64(cycles, cpu_env, offsetof(CPUARCState, cycles));
+    tcg_gen_add_i64(cycles, cycles, tmp);
+    tcg_gen_st_i64(cycles, cpu_env, offsetof(CPUARCState, cycles));
+
+    tcg_gen_ld_i64(tmp, cpu_env, offsetof(CPUARCState, cycles_deadline));
+    tcg_gen_brcond_i64(TCG_COND_LTU, cycles, tmp, done);
+    gen_helper_cycles_expired(cpu_env);
+    gen_set_label(done);
+
+    tcg_temp_free_i32(cost);
+    tcg_temp_free_i64(cycles);
+    tcg_temp_free_i64(tmp);
+}
+
+void arc_gen_cycles_tb_stop(DisasContext *ctx)
+{
+    if (!ctx->cycle_model) {
+        return;
+    }
+
+    tcg_set_insn_param(ctx->cycles_op, 1,
+                       tcgv_i32_arg(tcg_constant_i32(ctx->cycles)));
+}
+
+/* Charge the instruction just decoded in CTX->insn. */
+void arc_cycles_insn(DisasContext *ctx)
+{
+    const insn_t *insn = &ctx->insn;
+    bool dep, pair;
+    uint32_t cost = 1;
+
+    if (!ctx->cycle_model) {
+        return;
+    }
+
+    pair = env_archcpu(ctx->env)->cfg.dual_issue && arc_cycles_can_pair(insn);
+    dep = ctx->cycles_dest >= 0 && arc_cycles_reads(insn, ctx->cycles_dest);
+    if (dep) {
+        cost += ctx->cycles_stall;
+    } else if (pair && ctx->cycles_pair) {
+        /* Issues along with the previous one, which then leads no more. */
+        cost = 0;
+    }
+    cost += BUSY(insn->class);
+
+    ctx->cycles += cost;
+    ctx->cycles_dest = arc_cycles_dest(insn);
+    ctx->cycles_stall = LATENCY(insn->class);
+    ctx->cycles_pair = pair && cost != 0;
+}
+
+/* Charge the refill of a taken branch, on the path that takes it. */
+void arc_gen_cycles_branch(const DisasContext *ctx, bool delay_slot)
+{
+    TCGv_i64 cycles;
+
+    if (!ctx->cycle_model) {
+        return;
+    }
+
+    cycles = tcg_temp_new_i64();
+    tcg_gen_ld_i64(cycles, cpu_env, offsetof(CPUARCState, cycles));
+    tcg_gen_addi_i64(cycles, cycles, ARC_CYCLES_TAKEN_BRANCH
+                     - (delay_slot ? ARC_CYCLES_DELAY_SLOT : 0));
+    tcg_gen_st_i64(cycles, cpu_env, offsetof(CPUARCState, cycles));
+    tcg_temp_free_i64(cycles);
+}
+
+
+/*-*-indent-tabs-mode:nil;tab-width:4;indent-line-function:'insert-tab'-*-*/
+/* vim: set ts=4 sw=4 et: */
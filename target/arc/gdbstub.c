@@ -25,11 +25,37 @@
 #include "irq.h"
 #include "gdbstub.h"
 #include "mpu.h"
-#include "exec/helper-proto.h"
 
-/* gets the register address for a particular processor */
-#define REG_ADDR(reg, processor_type) \
-    arc_aux_reg_address_for((reg), (processor_type))
+/*
+ * Aux registers are accessed through their getter and setter directly:
+ * going through helper_lr()/helper_sr() means looking the register up by
+ * address, for each register of each 'g' packet.
+ */
+static target_ulong gdb_aux_get(CPUARCState *env, enum arc_aux_reg_enum id)
+{
+    const struct arc_aux_reg_detail *detail =
+        arc_aux_reg_struct_for(id, env_archcpu(env)->family);
+
+    if (detail == NULL || detail->aux_reg->get_func == NULL) {
+        return 0;
+    }
+    return detail->aux_reg->get_func(detail, env);
+}
+
+static void gdb_aux_set(CPUARCState *env, enum arc_aux_reg_enum id,
+                        target_ulong val)
+{
+    const struct arc_aux_reg_detail *detail =
+        arc_aux_reg_struct_for(id, env_archcpu(env)->family);
+
+    if (detail == NULL || detail->aux_reg->set_func == NULL) {
+        return;
+    }
+    detail->aux_reg->set_func(detail, val, env);
+}
+
+#define AUX_GET(ID)      gdb_aux_get(env, (ID))
+#define AUX_SET(ID, VAL) gdb_aux_set(env, (ID), (VAL))
 
 /*
  * Select the correct bit length for handling data in common codes for
@@ -112,22 +138,22 @@ gdb_v2_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
         regval = env->pc;
         break;
     case V2_AUX_LPS:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_lp_start, cpu->family));
+        regval = AUX_GET(AUX_ID_lp_start);
         break;
     case V2_AUX_LPE:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_lp_end, cpu->family));
+        regval = AUX_GET(AUX_ID_lp_end);
         break;
     case V2_AUX_STATUS:
         regval = pack_status32(&env->stat);
         break;
     case V2_AUX_TIMER_BUILD:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_timer_build, cpu->family));
+        regval = AUX_GET(AUX_ID_timer_build);
         break;
     case V2_AUX_IRQ_BUILD:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_build, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_build);
         break;
     case V2_AUX_MPY_BUILD:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_mpy_build, cpu->family));
+        regval = AUX_GET(AUX_ID_mpy_build);
         break;
     case V2_AUX_VECBASE_BUILD:
         regval = cpu->vecbase_build;
@@ -136,54 +162,54 @@ gdb_v2_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
         regval = cpu->isa_config;
         break;
     case V2_AUX_TIMER_CNT0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_count0, cpu->family));
+        regval = AUX_GET(AUX_ID_count0);
         break;
     case V2_AUX_TIMER_CTRL0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_control0, cpu->family));
+        regval = AUX_GET(AUX_ID_control0);
         break;
     case V2_AUX_TIMER_LIM0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_limit0, cpu->family));
+        regval = AUX_GET(AUX_ID_limit0);
         break;
     case V2_AUX_TIMER_CNT1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_count1, cpu->family));
+        regval = AUX_GET(AUX_ID_count1);
         break;
     case V2_AUX_TIMER_CTRL1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_control1, cpu->family));
+        regval = AUX_GET(AUX_ID_control1);
         break;
     case V2_AUX_TIMER_LIM1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_limit1, cpu->family));
+        regval = AUX_GET(AUX_ID_limit1);
         break;
     /* MMUv4 */
     case V2_AUX_PID:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_pid, cpu->family));
+        regval = AUX_GET(AUX_ID_pid);
         break;
     case V2_AUX_TLBPD0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_tlbpd0, cpu->family));
+        regval = AUX_GET(AUX_ID_tlbpd0);
         break;
     case V2_AUX_TLBPD1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_tlbpd1, cpu->family));
+        regval = AUX_GET(AUX_ID_tlbpd1);
         break;
     case V2_AUX_TLB_INDEX:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_tlbindex, cpu->family));
+        regval = AUX_GET(AUX_ID_tlbindex);
         break;
     case V2_AUX_TLB_CMD:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_tlbcommand, cpu->family));
+        regval = AUX_GET(AUX_ID_tlbcommand);
         break;
     /* MPU */
     case V2_AUX_MPU_BUILD:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_mpu_build, cpu->family));
+        regval = AUX_GET(AUX_ID_mpu_build);
         break;
     case V2_AUX_MPU_EN:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_mpuen, cpu->family));
+        regval = AUX_GET(AUX_ID_mpuen);
         break;
     case V2_AUX_MPU_ECR:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_mpuic, cpu->family));
+        regval = AUX_GET(AUX_ID_mpuic);
         break;
     case V2_AUX_MPU_BASE0 ... V2_AUX_MPU_BASE15: {
         const uint8_t index = regnum - V2_AUX_MPU_BASE0;
         if (arc_mpu_is_rgn_reg_available(env, index)) {
             regval =
-                helper_lr(env, REG_ADDR(AUX_ID_mpurdb0 + index, cpu->family));
+                AUX_GET(AUX_ID_mpurdb0 + index);
         } else {
             regval = 0;
         }
@@ -193,7 +219,7 @@ gdb_v2_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
         const uint8_t index = regnum - V2_AUX_MPU_PERM0;
         if (arc_mpu_is_rgn_reg_available(env, index)) {
             regval =
-                helper_lr(env, REG_ADDR(AUX_ID_mpurdp0 + index, cpu->family));
+                AUX_GET(AUX_ID_mpurdp0 + index);
         } else {
             regval = 0;
         }
@@ -201,59 +227,59 @@ gdb_v2_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
     }
     /* exceptions */
     case V2_AUX_ERSTATUS:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_erstatus, cpu->family));
+        regval = AUX_GET(AUX_ID_erstatus);
         break;
     case V2_AUX_ERBTA:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_erbta, cpu->family));
+        regval = AUX_GET(AUX_ID_erbta);
         break;
     case V2_AUX_ECR:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_ecr, cpu->family));
+        regval = AUX_GET(AUX_ID_ecr);
         break;
     case V2_AUX_ERET:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_eret, cpu->family));
+        regval = AUX_GET(AUX_ID_eret);
         break;
     case V2_AUX_EFA:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_efa, cpu->family));
+        regval = AUX_GET(AUX_ID_efa);
         break;
     /* interrupt */
     case V2_AUX_ICAUSE:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_icause, cpu->family));
+        regval = AUX_GET(AUX_ID_icause);
         break;
     case V2_AUX_IRQ_CTRL:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_aux_irq_ctrl, cpu->family));
+        regval = AUX_GET(AUX_ID_aux_irq_ctrl);
         break;
     case V2_AUX_IRQ_ACT:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_aux_irq_act, cpu->family));
+        regval = AUX_GET(AUX_ID_aux_irq_act);
         break;
     case V2_AUX_IRQ_PRIO_PEND:
         regval = env->irq_priority_pending;
         break;
     case V2_AUX_IRQ_HINT:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_aux_irq_hint, cpu->family));
+        regval = AUX_GET(AUX_ID_aux_irq_hint);
         break;
     case V2_AUX_IRQ_SELECT:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_select, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_select);
         break;
     case V2_AUX_IRQ_ENABLE:
         regval = env->irq_bank[env->irq_select & 0xff].enable;
         break;
     case V2_AUX_IRQ_TRIGGER:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_trigger, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_trigger);
         break;
     case V2_AUX_IRQ_STATUS:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_status, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_status);
         break;
     case V2_AUX_IRQ_PULSE:
         regval = 0; /* write only for clearing the pulse triggered interrupt */
         break;
     case V2_AUX_IRQ_PENDING:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_pending, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_pending);
         break;
     case V2_AUX_IRQ_PRIO:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_priority, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_priority);
         break;
     case V2_AUX_BTA:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_bta, cpu->family));
+        regval = AUX_GET(AUX_ID_bta);
         break;
     default:
         assert(!"Unsupported auxiliary register is being read.");
@@ -265,7 +291,6 @@ gdb_v2_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
 static int
 gdb_v2_aux_write(CPUARCState *env, uint8_t *mem_buf, int regnum)
 {
-    ARCCPU *cpu = env_archcpu(env);
     target_ulong regval = ldl_p(mem_buf);
 
     switch (regnum) {
@@ -273,10 +298,10 @@ gdb_v2_aux_write(CPUARCState *env, uint8_t *mem_buf, int regnum)
         env->pc = regval;
         break;
     case V2_AUX_LPS:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_lp_start, cpu->family));
+        AUX_SET(AUX_ID_lp_start, regval);
         break;
     case V2_AUX_LPE:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_lp_end, cpu->family));
+        AUX_SET(AUX_ID_lp_end, regval);
         break;
     case V2_AUX_STATUS:
         unpack_status32(&env->stat, regval);
@@ -295,47 +320,47 @@ gdb_v2_aux_write(CPUARCState *env, uint8_t *mem_buf, int regnum)
         /* builds/configs/exceptions/irqs cannot be changed */
         break;
     case V2_AUX_TIMER_CNT0:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_count0, cpu->family));
+        AUX_SET(AUX_ID_count0, regval);
         break;
     case V2_AUX_TIMER_CTRL0:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_control0, cpu->family));
+        AUX_SET(AUX_ID_control0, regval);
         break;
     case V2_AUX_TIMER_LIM0:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_limit0, cpu->family));
+        AUX_SET(AUX_ID_limit0, regval);
         break;
     case V2_AUX_TIMER_CNT1:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_count1, cpu->family));
+        AUX_SET(AUX_ID_count1, regval);
         break;
     case V2_AUX_TIMER_CTRL1:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_control1, cpu->family));
+        AUX_SET(AUX_ID_control1, regval);
         break;
     case V2_AUX_TIMER_LIM1:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_limit1, cpu->family));
+        AUX_SET(AUX_ID_limit1, regval);
         break;
     /* MMUv4 */
     case V2_AUX_PID:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_pid, cpu->family));
+        AUX_SET(AUX_ID_pid, regval);
         break;
     case V2_AUX_TLBPD0:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_tlbpd0, cpu->family));
+        AUX_SET(AUX_ID_tlbpd0, regval);
         break;
     case V2_AUX_TLBPD1:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_tlbpd1, cpu->family));
+        AUX_SET(AUX_ID_tlbpd1, regval);
         break;
     case V2_AUX_TLB_INDEX:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_tlbindex, cpu->family));
+        AUX_SET(AUX_ID_tlbindex, regval);
         break;
     case V2_AUX_TLB_CMD:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_tlbcommand, cpu->family));
+        AUX_SET(AUX_ID_tlbcommand, regval);
         break;
     /* MPU */
     case V2_AUX_MPU_EN:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_mpuen, cpu->family));
+        AUX_SET(AUX_ID_mpuen, regval);
         break;
     case V2_AUX_MPU_BASE0 ... V2_AUX_MPU_BASE15: {
         const uint8_t index = regnum - V2_AUX_MPU_BASE0;
         if (arc_mpu_is_rgn_reg_available(env, index)) {
-            helper_sr(env, regval, REG_ADDR(AUX_ID_mpurdb0 + index, cpu->family));
+            AUX_SET(AUX_ID_mpurdb0 + index, regval);
         } else {
             return 0;
         }
@@ -344,7 +369,7 @@ gdb_v2_aux_write(CPUARCState *env, uint8_t *mem_buf, int regnum)
     case V2_AUX_MPU_PERM0 ... V2_AUX_MPU_PERM15: {
         const uint8_t index = regnum - V2_AUX_MPU_PERM0;
         if (arc_mpu_is_rgn_reg_available(env, index)) {
-            helper_sr(env, regval, REG_ADDR(AUX_ID_mpurdp0 + index, cpu->family));
+            AUX_SET(AUX_ID_mpurdp0 + index, regval);
         } else {
             return 0;
         }
@@ -352,47 +377,47 @@ gdb_v2_aux_write(CPUARCState *env, uint8_t *mem_buf, int regnum)
     }
     /* exceptions */
     case V2_AUX_ERSTATUS:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_erstatus, cpu->family));
+        AUX_SET(AUX_ID_erstatus, regval);
         break;
     case V2_AUX_ERBTA:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_erbta, cpu->family));
+        AUX_SET(AUX_ID_erbta, regval);
         break;
     case V2_AUX_ECR:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_ecr, cpu->family));
+        AUX_SET(AUX_ID_ecr, regval);
         break;
     case V2_AUX_ERET:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_eret, cpu->family));
+        AUX_SET(AUX_ID_eret, regval);
         break;
     case V2_AUX_EFA:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_efa, cpu->family));
+        AUX_SET(AUX_ID_efa, regval);
         break;
     /* interrupt */
     case V2_AUX_IRQ_CTRL:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_aux_irq_ctrl, cpu->family));
+        AUX_SET(AUX_ID_aux_irq_ctrl, regval);
         break;
     case V2_AUX_IRQ_ACT:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_aux_irq_act, cpu->family));
+        AUX_SET(AUX_ID_aux_irq_act, regval);
         break;
     case V2_AUX_IRQ_HINT:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_aux_irq_hint, cpu->family));
+        AUX_SET(AUX_ID_aux_irq_hint, regval);
         break;
     case V2_AUX_IRQ_SELECT:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_select, cpu->family));
+        AUX_SET(AUX_ID_irq_select, regval);
         break;
     case V2_AUX_IRQ_ENABLE:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_enable, cpu->family));
+        AUX_SET(AUX_ID_irq_enable, regval);
         break;
     case V2_AUX_IRQ_TRIGGER:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_trigger, cpu->family));
+        AUX_SET(AUX_ID_irq_trigger, regval);
         break;
     case V2_AUX_IRQ_PULSE:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_pulse_cancel, cpu->family));
+        AUX_SET(AUX_ID_irq_pulse_cancel, regval);
         break;
     case V2_AUX_IRQ_PRIO:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_priority, cpu->family));
+        AUX_SET(AUX_ID_irq_priority, regval);
         break;
     case V2_AUX_BTA:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_bta, cpu->family));
+        AUX_SET(AUX_ID_bta, regval);
         break;
     default:
         assert(!"Unsupported auxiliary register is being written.");
@@ -463,10 +488,10 @@ gdb_v3_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
         regval = pack_status32(&env->stat);
         break;
     case V3_AUX_TIMER_BUILD:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_timer_build, cpu->family));
+        regval = AUX_GET(AUX_ID_timer_build);
         break;
     case V3_AUX_IRQ_BUILD:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_build, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_build);
         break;
     case V3_AUX_VECBASE_BUILD:
         regval = cpu->vecbase_build;
@@ -475,85 +500,85 @@ gdb_v3_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
         regval = cpu->isa_config;
         break;
     case V3_AUX_TIMER_CNT0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_count0, cpu->family));
+        regval = AUX_GET(AUX_ID_count0);
         break;
     case V3_AUX_TIMER_CTRL0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_control0, cpu->family));
+        regval = AUX_GET(AUX_ID_control0);
         break;
     case V3_AUX_TIMER_LIM0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_limit0, cpu->family));
+        regval = AUX_GET(AUX_ID_limit0);
         break;
     case V3_AUX_TIMER_CNT1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_count1, cpu->family));
+        regval = AUX_GET(AUX_ID_count1);
         break;
     case V3_AUX_TIMER_CTRL1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_control1, cpu->family));
+        regval = AUX_GET(AUX_ID_control1);
         break;
     case V3_AUX_TIMER_LIM1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_limit1, cpu->family));
+        regval = AUX_GET(AUX_ID_limit1);
         break;
     /* exceptions */
     case V3_AUX_ERSTATUS:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_erstatus, cpu->family));
+        regval = AUX_GET(AUX_ID_erstatus);
         break;
     case V3_AUX_ERBTA:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_erbta, cpu->family));
+        regval = AUX_GET(AUX_ID_erbta);
         break;
     case V3_AUX_ECR:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_ecr, cpu->family));
+        regval = AUX_GET(AUX_ID_ecr);
         break;
     case V3_AUX_ERET:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_eret, cpu->family));
+        regval = AUX_GET(AUX_ID_eret);
         break;
     case V3_AUX_EFA:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_efa, cpu->family));
+        regval = AUX_GET(AUX_ID_efa);
         break;
     /* interrupt */
     case V3_AUX_ICAUSE:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_icause, cpu->family));
+        regval = AUX_GET(AUX_ID_icause);
         break;
     case V3_AUX_IRQ_CTRL:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_aux_irq_ctrl, cpu->family));
+        regval = AUX_GET(AUX_ID_aux_irq_ctrl);
         break;
     case V3_AUX_IRQ_ACT:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_aux_irq_act, cpu->family));
+        regval = AUX_GET(AUX_ID_aux_irq_act);
         break;
     case V3_AUX_IRQ_PRIO_PEND:
         regval = env->irq_priority_pending;
         break;
     case V3_AUX_IRQ_HINT:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_aux_irq_hint, cpu->family));
+        regval = AUX_GET(AUX_ID_aux_irq_hint);
         break;
     case V3_AUX_IRQ_SELECT:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_select, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_select);
         break;
     case V3_AUX_IRQ_ENABLE:
         regval = env->irq_bank[env->irq_select & 0xff].enable;
         break;
     case V3_AUX_IRQ_TRIGGER:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_trigger, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_trigger);
         break;
     case V3_AUX_IRQ_STATUS:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_status, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_status);
         break;
     case V3_AUX_IRQ_PULSE:
         regval = 0; /* write only for clearing the pulse triggered interrupt */
         break;
     case V3_AUX_IRQ_PRIO:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_irq_priority, cpu->family));
+        regval = AUX_GET(AUX_ID_irq_priority);
         break;
     case V3_AUX_BTA:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_bta, cpu->family));
+        regval = AUX_GET(AUX_ID_bta);
         break;
     /* MMUv6 */
     case V3_AUX_MMU_CTRL:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_mmu_ctrl, cpu->family));
+        regval = AUX_GET(AUX_ID_mmu_ctrl);
         break;
     case V3_AUX_RTP0:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_mmu_rtp0, cpu->family));
+        regval = AUX_GET(AUX_ID_mmu_rtp0);
         break;
     case V3_AUX_RTP1:
-        regval = helper_lr(env, REG_ADDR(AUX_ID_mmu_rtp1, cpu->family));
+        regval = AUX_GET(AUX_ID_mmu_rtp1);
         break;
     default:
         assert(!"Unsupported auxiliary register is being read.");
@@ -565,7 +590,6 @@ gdb_v3_aux_read(CPUARCState *env, GByteArray *mem_buf, int regnum)
 static int
 gdb_v3_aux_write(CPUARCState *env, uint8_t *mem_buf, int regnum)
 {
-    ARCCPU *cpu = env_archcpu(env);
     target_ulong regval = ARCV3_LOAD_MEM(mem_buf);
 
     switch (regnum) {
@@ -585,66 +609,66 @@ gdb_v3_aux_write(CPUARCState *env, uint8_t *mem_buf, int regnum)
         /* builds/configs/exceptions/irqs cannot be changed */
         break;
     case V3_AUX_TIMER_CNT0:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_count0, cpu->family));
+        AUX_SET(AUX_ID_count0, regval);
         break;
     case V3_AUX_TIMER_CTRL0:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_control0, cpu->family));
+        AUX_SET(AUX_ID_control0, regval);
         break;
     case V3_AUX_TIMER_LIM0:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_limit0, cpu->family));
+        AUX_SET(AUX_ID_limit0, regval);
         break;
     case V3_AUX_TIMER_CNT1:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_count1, cpu->family));
+        AUX_SET(AUX_ID_count1, regval);
         break;
     case V3_AUX_TIMER_CTRL1:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_control1, cpu->family));
+        AUX_SET(AUX_ID_control1, regval);
         break;
     case V3_AUX_TIMER_LIM1:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_limit1, cpu->family));
+        AUX_SET(AUX_ID_limit1, regval);
         break;
     /* exceptions */
     case V3_AUX_ERSTATUS:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_erstatus, cpu->family));
+        AUX_SET(AUX_ID_erstatus, regval);
         break;
     case V3_AUX_ERBTA:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_erbta, cpu->family));
+        AUX_SET(AUX_ID_erbta, regval);
         break;
     case V3_AUX_ECR:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_ecr, cpu->family));
+        AUX_SET(AUX_ID_ecr, regval);
         break;
     case V3_AUX_ERET:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_eret, cpu->family));
+        AUX_SET(AUX_ID_eret, regval);
         break;
     case V3_AUX_EFA:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_efa, cpu->family));
+        AUX_SET(AUX_ID_efa, regval);
         break;
     /* interrupt */
     case V3_AUX_IRQ_CTRL:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_aux_irq_ctrl, cpu->family));
+        AUX_SET(AUX_ID_aux_irq_ctrl, regval);
         break;
     case V3_AUX_IRQ_ACT:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_aux_irq_act, cpu->family));
+        AUX_SET(AUX_ID_aux_irq_act, regval);
         break;
     case V3_AUX_IRQ_HINT:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_aux_irq_hint, cpu->family));
+        AUX_SET(AUX_ID_aux_irq_hint, regval);
         break;
     case V3_AUX_IRQ_SELECT:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_select, cpu->family));
+        AUX_SET(AUX_ID_irq_select, regval);
         break;
     case V3_AUX_IRQ_ENABLE:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_enable, cpu->family));
+        AUX_SET(AUX_ID_irq_enable, regval);
         break;
     case V3_AUX_IRQ_TRIGGER:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_trigger, cpu->family));
+        AUX_SET(AUX_ID_irq_trigger, regval);
         break;
     case V3_AUX_IRQ_PULSE:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_pulse_cancel, cpu->family));
+        AUX_SET(AUX_ID_irq_pulse_cancel, regval);
         break;
     case V3_AUX_IRQ_PRIO:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_irq_priority, cpu->family));
+        AUX_SET(AUX_ID_irq_priority, regval);
         break;
     case V3_AUX_BTA:
-        helper_sr(env, regval, REG_ADDR(AUX_ID_bta, cpu->family));
+        AUX_SET(AUX_ID_bta, regval);
         break;
     default:
         assert(!"Unsupported minimal auxiliary register is being written.");
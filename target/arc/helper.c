@@ -42,10 +42,12 @@ void arc_cpu_do_interrupt(CPUState *cs)
     uint32_t     vectno;
     const char  *name;
 
+    /* Taking an interrupt or exception clears the lock flag. */
     struct lpa_lf_entry *entry = env->arconnect.lpa_lf;
     if(entry != NULL) {
-        qemu_mutex_unlock(&(entry->mutex));
+        qemu_mutex_lock(&(entry->mutex));
         entry->lpa_lf = 0;
+        qemu_mutex_unlock(&(entry->mutex));
     }
     /*
      * NOTE: Special LP_END exception. Immediately return code execution to
@@ -31,6 +31,7 @@ DEF_HELPER_2(fake_exception, void, env, tl)
 DEF_HELPER_2(set_status32, void, env, tl)
 DEF_HELPER_1(get_status32, tl, env)
 DEF_HELPER_3(set_status32_bit, void, env, tl, tl)
+DEF_HELPER_1(cycles_expired, void, env)
 
 DEF_HELPER_FLAGS_3(carry_add_flag, TCG_CALL_NO_RWG_SE, tl, tl, tl, tl)
 DEF_HELPER_FLAGS_3(overflow_add_flag, TCG_CALL_NO_RWG_SE, tl, tl, tl, tl)
@@ -53,6 +54,9 @@ DEF_HELPER_FLAGS_2(rotate_right32, TCG_CALL_NO_RWG_SE, i64, i64, i64)
 DEF_HELPER_FLAGS_2(asr_32, TCG_CALL_NO_RWG_SE, i64, i64, i64)
 
 DEF_HELPER_2(norml, i64, env, i64)
+
+DEF_HELPER_FLAGS_3(lddl_parallel, TCG_CALL_NO_WG, i64, env, tl, i32)
+DEF_HELPER_FLAGS_5(stdl_parallel, TCG_CALL_NO_WG, void, env, tl, i64, i64, i32)
 #endif
 
 DEF_HELPER_2(llock, tl, env, tl)
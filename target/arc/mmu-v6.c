@@ -44,7 +44,7 @@ struct mmu_version_info {
   const char vaddr_size;
 };
 
-struct mmu_version_info mmuv6_info[] = {
+static const struct mmu_version_info mmuv6_info[] = {
   [MMUV6_32_4K] = {
       .id = MMUV6_32_4K,
       .type = 0,
@@ -82,13 +82,16 @@ struct mmu_version_info mmuv6_info[] = {
   },
 };
 
-struct mmu_version_info *mmu_v6_version;
+/*
+ * The MMU state lives in env->mmu.v6, one copy per core. The accessor
+ * macros below expect a "mmu" pointer to it in scope.
+ */
 
 #ifndef CONFIG_USER_ONLY
 
-#define N_BITS_ON_LEVEL(LEVEL) (mmu_v6_version->nbits_per_level[LEVEL])
-#define NLEVELS() (mmu_v6_version->nlevels)
-#define VADDR_SIZE() (mmu_v6_version->vaddr_size)
+#define N_BITS_ON_LEVEL(LEVEL) (mmu->version->nbits_per_level[LEVEL])
+#define NLEVELS() (mmu->version->nlevels)
+#define VADDR_SIZE() (mmu->version->vaddr_size)
 
 #endif
 
@@ -100,29 +103,26 @@ struct mmu_version_info *mmu_v6_version;
   (EXCP).parameter = P; \
 }
 
-uint32_t mmu_ctrl;
-
 #define MMU_ENABLED_BIT 0
 #define MMU_ENABLED_MASK (1 << MMU_ENABLED_BIT)
-#define MMU_ENABLED ((mmu_ctrl & MMU_ENABLED_MASK) != 0)
-#define MMU_IN_USER_KERNEL_MODE ((mmu_ctrl >> 1) & 1)
+#define MMU_ENABLED ((mmu->ctrl & MMU_ENABLED_MASK) != 0)
+#define MMU_IN_USER_KERNEL_MODE ((mmu->ctrl >> 1) & 1)
 
-static void disable_mmuv6(void)
+static void disable_mmuv6(struct arc_mmuv6 *mmu)
 {
-    mmu_ctrl &= ~MMU_ENABLED_MASK;
+    mmu->ctrl &= ~MMU_ENABLED_MASK;
 }
-int mmuv6_enabled(void)
+int mmuv6_enabled(const CPUARCState *env)
 {
+    const struct arc_mmuv6 *mmu = &env->mmu.v6;
     return MMU_ENABLED;
 }
 
 
-uint32_t mmu_ttbcr;
-
-#define MMU_TTBCR_TNSZ(I) ((mmu_ttbcr        >> (I * 16)) & 0x1f)
-#define MMU_TTBCR_TNSH(I) (((mmu_ttbcr >> 4) >> (I * 16)) & 0x3)
+#define MMU_TTBCR_TNSZ(I) ((mmu->ttbcr        >> (I * 16)) & 0x1f)
+#define MMU_TTBCR_TNSH(I) (((mmu->ttbcr >> 4) >> (I * 16)) & 0x3)
 
-#define MMU_TTBCR_A1  ((mmu_ttbcr >> 15) & 0x1)
+#define MMU_TTBCR_A1  ((mmu->ttbcr >> 15) & 0x1)
 
 /*
 static void init_mmu_ttbcr(void)
@@ -131,13 +131,8 @@ static void init_mmu_ttbcr(void)
 }
 */
 
-uint64_t mmu_rtp0;
-uint64_t mmu_rtp1;
-
-uint64_t mmu_fault_status;
-
 //static target_ulong mask_for_root_address(char x) {
-//    switch(mmu_v6_version->id) {
+//    switch(mmu->version->id) {
 //    case MMUV6_52_64K:
 //        return (((1 << vaddr_size()) - 1) & (~((1 << x) - 1)));
 //        break;
@@ -156,7 +151,7 @@ uint64_t mmu_fault_status;
 /* TODO: This is for MMU48 only. */
 
 #ifndef CONFIG_USER_ONLY
-static char x_for_ttbc(unsigned char i)
+static char x_for_ttbc(const struct arc_mmuv6 *mmu, unsigned char i)
 {
     const char xs[MMUV6_VERSION_SIZE][2] = {
         [MMUV6_52_64K] = { 13, 16 },
@@ -164,7 +159,7 @@ static char x_for_ttbc(unsigned char i)
         [MMUV6_48_16K] = {4, 6 },
         [MMUV6_48_64K] = { 9, 13 },
     };
-    switch(mmu_v6_version->id) {
+    switch(mmu->version->id) {
     case MMUV6_32_4K:
         if(MMU_TTBCR_TNSZ(i) > 1)
             return (14 - MMU_TTBCR_TNSZ(i));
@@ -172,7 +167,7 @@ static char x_for_ttbc(unsigned char i)
             return (5 - MMU_TTBCR_TNSZ(i));
         break;
     default:
-        return xs[mmu_v6_version->id][i];
+        return xs[mmu->version->id][i];
         break;
     }
     assert("This should not happen !!!" == 0);
@@ -181,9 +176,9 @@ static char x_for_ttbc(unsigned char i)
 
 // Grab Root Table Address for RTPN
 #ifndef CONFIG_USER_ONLY
-static uint64_t root_address(uint64_t rtp)
+static uint64_t root_address(const struct arc_mmuv6 *mmu, uint64_t rtp)
 {
-    switch(mmu_v6_version->id) {
+    switch(mmu->version->id) {
     case MMUV6_52_64K:
         return rtp << 4;
     default:
@@ -195,18 +190,19 @@ static uint64_t root_address(uint64_t rtp)
 #endif
 
 #define MMU_RTPN_ROOT_ADDRESS(N) \
-    (root_address(mmu_rtp##N) & MASK_FOR_ROOT_ADDRESS(x_for_ttbc(N)))
+    (root_address(mmu, mmu->rtp##N) & MASK_FOR_ROOT_ADDRESS(x_for_ttbc(mmu, N)))
 
 /* TODO: This is for MMU48/52 only. */
 #define MMU_RTPN_ASID(VADDR, N) \
-  ((mmu_rtp##N >> 48) & 0xffff)
+  ((mmu->rtp##N >> 48) & 0xffff)
 
 /* Table descriptors accessor macros */
 
 #ifndef CONFIG_USER_ONLY
-static uint64_t pte_tbl_next_level_table_address(unsigned char l, uint64_t pte)
+static uint64_t pte_tbl_next_level_table_address(const struct arc_mmuv6 *mmu,
+                                                  unsigned char l, uint64_t pte)
 {
-    switch(mmu_v6_version->id) {
+    switch(mmu->version->id) {
     case MMUV6_52_64K:
         /* TODO: This expects reserver bits in PTE to be 0 */
         return (((pte & 0xf000ull) << 36) | (pte & 0x0000ffffffff0000));
@@ -252,9 +248,9 @@ static uint64_t pte_tbl_next_level_table_address(unsigned char l, uint64_t pte)
      (!PTE_IS_PAGE_DESCRIPTOR(PTE, LEVEL) && ((PTE & 0x3) == 3))
 
 #ifndef CONFIG_USER_ONLY
-static bool pte_is_invalid(char pte, char level)
+static bool pte_is_invalid(const struct arc_mmuv6 *mmu, char pte, char level)
 {
-    switch(mmu_v6_version->id) {
+    switch(mmu->version->id) {
 /* This versions of MMU do not allow a block entry in the first
    table level. */
     case MMUV6_48_4K:
@@ -313,6 +309,8 @@ mmuv6_tlb_command(CPUARCState *env, enum MMUv6_TLBCOMMAND command)
 target_ulong
 arc_mmuv6_aux_get(const struct arc_aux_reg_detail *aux_reg_detail, void *data)
 {
+  CPUARCState *env = (CPUARCState *) data;
+  struct arc_mmuv6 *mmu = &env->mmu.v6;
   target_ulong reg = 0;
   switch(aux_reg_detail->id)
   {
@@ -320,7 +318,7 @@ arc_mmuv6_aux_get(const struct arc_aux_reg_detail *aux_reg_detail, void *data)
       reg = 0;
       reg |= (0x10 << 24);   /* Version: 0x10 (MMUv6) */
                           /* Type:    1 (MMUv48) */
-      reg |= (mmu_v6_version->type << 21);
+      reg |= (mmu->version->type << 21);
       reg |= (0 << 9);    /* TC:      0 (no translation cache) */
       reg |= (0 << 6);    /* L2TLB:   0 (256 entries) */
       reg |= (1 << 3);    /* ITLB:    1 (4 entries) */
@@ -329,27 +327,27 @@ arc_mmuv6_aux_get(const struct arc_aux_reg_detail *aux_reg_detail, void *data)
       qemu_log_mask(CPU_LOG_MMU, "\n[MMUV3] BUILD read " TARGET_FMT_lu " \n\n", reg);
       break;
   case AUX_ID_mmu_rtp0:
-      reg = mmu_rtp0;
-      qemu_log_mask(CPU_LOG_MMU, "\n[MMUV3] RTP0 read %lx\n\n", mmu_rtp0);
+      reg = mmu->rtp0;
+      qemu_log_mask(CPU_LOG_MMU, "\n[MMUV3] RTP0 read %lx\n\n", mmu->rtp0);
       break;
   case AUX_ID_mmu_rtp0hi:
-      reg = (mmu_rtp0 >> 32);
+      reg = (mmu->rtp0 >> 32);
       break;
   case AUX_ID_mmu_rtp1:
-      qemu_log_mask(CPU_LOG_MMU, "\n[MMUV3] RTP1 read %lx\n\n", mmu_rtp1);
-      reg = mmu_rtp1;
+      qemu_log_mask(CPU_LOG_MMU, "\n[MMUV3] RTP1 read %lx\n\n", mmu->rtp1);
+      reg = mmu->rtp1;
       break;
   case AUX_ID_mmu_rtp1hi:
-      reg = (mmu_rtp1 >> 32);
+      reg = (mmu->rtp1 >> 32);
       break;
   case AUX_ID_mmu_ctrl:
-      reg = mmu_ctrl;
+      reg = mmu->ctrl;
       break;
   case AUX_ID_mmu_ttbcr:
-      reg = mmu_ttbcr;
+      reg = mmu->ttbcr;
       break;
   case AUX_ID_mmu_fault_status:
-      reg = mmu_fault_status;
+      reg = mmu->fault_status;
       break;
   default:
       break;
@@ -363,42 +361,43 @@ arc_mmuv6_aux_set(const struct arc_aux_reg_detail *aux_reg_detail,
 {
     CPUARCState *env = (CPUARCState *) data;
     CPUState *cs = env_cpu(env);
+    struct arc_mmuv6 *mmu = &env->mmu.v6;
     uint64_t u64_val = val;
 
     switch(aux_reg_detail->id)
     {
     case AUX_ID_mmu_rtp0:
         qemu_log_mask(CPU_LOG_MMU, "\n[MMUV3] RTP0 update %lx"
-                      " ==> " TARGET_FMT_lx "\n\n", mmu_rtp0, val);
-        if (mmu_rtp0 != u64_val)
+                      " ==> " TARGET_FMT_lx "\n\n", mmu->rtp0, val);
+        if (mmu->rtp0 != u64_val)
             tlb_flush(cs);
-        mmu_rtp0 =  u64_val;
+        mmu->rtp0 =  u64_val;
         break;
     case AUX_ID_mmu_rtp0hi:
-        if ((mmu_rtp0 >> 32) != u64_val)
+        if ((mmu->rtp0 >> 32) != u64_val)
             tlb_flush(cs);
-        mmu_rtp0 &= ~0xffffffff00000000;
-        mmu_rtp0 |= (u64_val << 32);
+        mmu->rtp0 &= ~0xffffffff00000000;
+        mmu->rtp0 |= (u64_val << 32);
         break;
     case AUX_ID_mmu_rtp1:
-        if (mmu_rtp1 != u64_val)
+        if (mmu->rtp1 != u64_val)
             tlb_flush(cs);
-        mmu_rtp1 =  u64_val;
+        mmu->rtp1 =  u64_val;
         break;
     case AUX_ID_mmu_rtp1hi:
-        if ((mmu_rtp1 >> 32) != u64_val)
+        if ((mmu->rtp1 >> 32) != u64_val)
             tlb_flush(cs);
-        mmu_rtp1 &= ~0xffffffff00000000;
-        mmu_rtp1 |= (u64_val << 32);
+        mmu->rtp1 &= ~0xffffffff00000000;
+        mmu->rtp1 |= (u64_val << 32);
         break;
     case AUX_ID_mmu_ctrl:
-        if (mmu_ctrl != val)
+        if (mmu->ctrl != val)
             tlb_flush(cs);
-        mmu_ctrl =  val;
+        mmu->ctrl =  val;
         qemu_log_mask(CPU_LOG_MMU, "mmu_ctrl = 0x" TARGET_FMT_lx "\n", val);
         break;
     case AUX_ID_mmu_ttbcr:
-        mmu_ttbcr = val;
+        mmu->ttbcr = val;
         break;
     case AUX_ID_mmuv6_tlbcommand:
         mmuv6_tlb_command(env, val);
@@ -416,14 +415,14 @@ arc_mmuv6_aux_set(const struct arc_aux_reg_detail *aux_reg_detail,
 #define ALL1_64BIT (0xffffffffffffffff)
 
 static uint64_t
-root_ptr_for_vaddr(uint64_t vaddr, bool *valid)
+root_ptr_for_vaddr(const struct arc_mmuv6 *mmu, uint64_t vaddr, bool *valid)
 {
     /* TODO: This is only for MMUv48 */
-    assert(mmu_v6_version->id != MMUV6_48_4K || (
+    assert(mmu->version->id != MMUV6_48_4K || (
            MMU_TTBCR_TNSZ(0) == MMU_TTBCR_TNSZ(1)
            && (MMU_TTBCR_TNSZ(0) == 16 || MMU_TTBCR_TNSZ(0) == 25)));
 
-    switch(mmu_v6_version->id) {
+    switch(mmu->version->id) {
     case MMUV6_52_64K:
     case MMUV6_48_4K:
     case MMUV6_48_16K:
@@ -463,6 +462,7 @@ root_ptr_for_vaddr(uint64_t vaddr, bool *valid)
 static bool
 protv_violation(CPUARCState *env, uint64_t pte, int level, int table_perm_overwride, enum mmu_access_type rwe)
 {
+    const struct arc_mmuv6 *mmu = &env->mmu.v6;
     bool in_kernel_mode = !(GET_STATUS_BIT(env->stat, Uf)); /* Read status for user mode. */
     bool trigger_prot_v = false;
 
@@ -570,7 +570,8 @@ page_table_traverse(CPUARCState *env,
     int l;
     int overwrite_permitions = 0;
     bool valid_root = true;
-    uint64_t root = root_ptr_for_vaddr(vaddr, &valid_root);
+    struct arc_mmuv6 *mmu = &env->mmu.v6;
+    uint64_t root = root_ptr_for_vaddr(mmu, vaddr, &valid_root);
     ARCCPU *cpu = env_archcpu (env);
     unsigned char remainig_bits = VADDR_SIZE();
 
@@ -601,12 +602,12 @@ page_table_traverse(CPUARCState *env,
             qemu_log_mask(CPU_LOG_MMU, "[MMUV3] == Level: %d, offset: %d, pte_addr: %lx ==> %lx\n", l, offset, pte_addr, pte);
         }
 
-        if(pte_is_invalid(pte, l)) {
+        if(pte_is_invalid(mmu, pte, l)) {
             if(rwe != MMU_MEM_IRRELEVANT_TYPE) {
                 qemu_log_mask(CPU_LOG_MMU, "[MMUV3] PTE seems invalid\n");
             }
 
-            mmu_fault_status = (l & 0x7);
+            mmu->fault_status = (l & 0x7);
             if(rwe == MMU_MEM_FETCH || rwe == MMU_MEM_IRRELEVANT_TYPE) {
                 SET_MMU_EXCEPTION(*excp, EXCP_IMMU_FAULT, 0x00, 0x00);
                 return -1;
@@ -623,7 +624,7 @@ page_table_traverse(CPUARCState *env,
                 break;
             } else {
                 qemu_log_mask(CPU_LOG_MMU, "[MMUV3] PTE AF is not set\n");
-                mmu_fault_status = (l & 0x7);
+                mmu->fault_status = (l & 0x7);
                 if(rwe == MMU_MEM_FETCH || rwe == MMU_MEM_IRRELEVANT_TYPE) {
                     SET_MMU_EXCEPTION(*excp, EXCP_IMMU_FAULT, 0x10, 0x00);
                     return -1;
@@ -652,7 +653,7 @@ page_table_traverse(CPUARCState *env,
             }
         }
 
-        if(pte_is_invalid(pte, l)) {
+        if(pte_is_invalid(mmu, pte, l)) {
             if(rwe == MMU_MEM_FETCH || rwe == MMU_MEM_IRRELEVANT_TYPE) {
                 SET_MMU_EXCEPTION(*excp, EXCP_IMMU_FAULT, 0x00, 0x00);
                 return -1;
@@ -662,7 +663,7 @@ page_table_traverse(CPUARCState *env,
             }
         }
 
-        root = pte_tbl_next_level_table_address(l, pte);
+        root = pte_tbl_next_level_table_address(mmu, l, pte);
     }
 
     if(found_block_descriptor) {
@@ -693,21 +694,28 @@ page_table_traverse(CPUARCState *env,
 void arc_mmu_init_v6(CPUARCState *env)
 {
     ARCCPU *cpu = env_archcpu(env);
+    struct arc_mmuv6 *mmu = &env->mmu.v6;
+
+    mmu->ctrl = 0;
+    mmu->ttbcr = 0;
+    mmu->rtp0 = 0;
+    mmu->rtp1 = 0;
+    mmu->fault_status = 0;
 
     switch(cpu->family) {
     case ARC_OPCODE_ARC64:
-        //mmu_v6_version = &mmuv6_info[MMUV6_48_4K];
+        //mmu->version = &mmuv6_info[MMUV6_48_4K];
 
         if(cpu->cfg.mmuv6_version == NULL) {
-            mmu_v6_version = &mmuv6_info[MMUV6_48_4K];
+            mmu->version = &mmuv6_info[MMUV6_48_4K];
         } else if(!g_strcmp0(cpu->cfg.mmuv6_version, "48_4k")) {
-            mmu_v6_version = &mmuv6_info[MMUV6_48_4K];
+            mmu->version = &mmuv6_info[MMUV6_48_4K];
         } else if(!g_strcmp0(cpu->cfg.mmuv6_version, "48_16k")) {
-            mmu_v6_version = &mmuv6_info[MMUV6_48_16K];
+            mmu->version = &mmuv6_info[MMUV6_48_16K];
         } else if(!g_strcmp0(cpu->cfg.mmuv6_version, "48_64k")) {
-            mmu_v6_version = &mmuv6_info[MMUV6_48_64K];
+            mmu->version = &mmuv6_info[MMUV6_48_64K];
         } else if(!g_strcmp0(cpu->cfg.mmuv6_version, "52_64k")) {
-            mmu_v6_version = &mmuv6_info[MMUV6_52_64K];
+            mmu->version = &mmuv6_info[MMUV6_52_64K];
         } else {
             assert("MMUV6 mmuv6_version is invalid !!!" == 0);
         }
@@ -715,7 +723,7 @@ void arc_mmu_init_v6(CPUARCState *env)
     case ARC_OPCODE_ARC32:
         if (cpu->cfg.mmuv6_version == NULL ||
             !g_strcmp0(cpu->cfg.mmuv6_version, "32_4k")) {
-            mmu_v6_version = &mmuv6_info[MMUV6_32_4K];
+            mmu->version = &mmuv6_info[MMUV6_32_4K];
         } else {
             assert("MMUV6 mmuv6_version is invalid !!!" == 0);
         }
@@ -735,6 +743,7 @@ arc_mmuv6_translate(CPUARCState *env,
 		            target_ulong vaddr, enum mmu_access_type rwe,
                     int *prot, struct mem_exception *excp)
 {
+    const struct arc_mmuv6 *mmu = &env->mmu.v6;
     target_ulong paddr;
 
     /* This is really required. Fail in non singlestep without in_asm. */
@@ -764,6 +773,8 @@ static int mmuv6_decide_action(const CPUARCState *env,
                   target_ulong       addr,
                   int                mmu_idx)
 {
+  const struct arc_mmuv6 *mmu = &env->mmu.v6;
+
   if (MMU_ENABLED)
     return MMU_ACTION;
   else
@@ -903,7 +914,7 @@ hwaddr arc_mmu_debug_translate_v6(CPUARCState *env, vaddr addr)
 {
     struct mem_exception excp;
 
-    if(mmuv6_enabled()) {
+    if(mmuv6_enabled(env)) {
         return arc_mmuv6_translate(env, addr, MMU_MEM_IRRELEVANT_TYPE, NULL, &excp);
     } else {
         return addr;
@@ -912,7 +923,7 @@ hwaddr arc_mmu_debug_translate_v6(CPUARCState *env, vaddr addr)
 #endif /* CONFIG_USER_ONLY */
 
 void arc_mmu_disable_v6(CPUARCState *env) {
-    disable_mmuv6();
+    disable_mmuv6(&env->mmu.v6);
 }
 
 /*-*-indent-tabs-mode:nil;tab-width:4;indent-line-function:'insert-tab'-*-*/
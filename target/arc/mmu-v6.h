@@ -23,15 +23,25 @@
 
 #include "target/arc/mmu-common.h"
 
+struct mmu_version_info;
+
 struct arc_mmuv6 {
     struct mmuv6_exception {
       int32_t number;
       uint8_t causecode;
       uint8_t parameter;
     } exception;
+
+    const struct mmu_version_info *version;
+
+    uint32_t ctrl;
+    uint32_t ttbcr;
+    uint64_t rtp0;
+    uint64_t rtp1;
+    uint64_t fault_status;
 };
 
-int mmuv6_enabled(void);
+int mmuv6_enabled(const CPUARCState *env);
 
 
 #endif /* ARC64_MMUV6_H */
@@ -654,49 +654,43 @@ static int decide_action(const CPUARCState *env,
                          target_ulong       addr,
                          int                mmu_idx)
 {
-    static ACTION table[2][2][2][2] = { };
-    static bool is_initialized;
-    const bool is_user = (mmu_idx == 1);
-    const bool is_mmu_range = ((addr >= MMU_VA_START) && (addr < MMU_VA_END));
-
-    if (!is_initialized) {
-        /* Both MMU and MPU disabled */
 #define T true
 #define F false
-
-        table[F][F][F][F] = DIRECT_ACTION;
-        table[F][F][F][T] = DIRECT_ACTION;
-        table[F][F][T][F] = DIRECT_ACTION;
-        table[F][F][T][T] = DIRECT_ACTION;
+    /* Read-only, so it can be shared by all the vCPU threads. */
+    static const ACTION table[2][2][2][2] = {
+        /* Both MMU and MPU disabled */
+        [F][F][F][F] = DIRECT_ACTION,
+        [F][F][F][T] = DIRECT_ACTION,
+        [F][F][T][F] = DIRECT_ACTION,
+        [F][F][T][T] = DIRECT_ACTION,
 
         /* Only MPU */
-        table[F][T][F][F] = MPU_ACTION;
-        table[F][T][F][T] = MPU_ACTION;
-        table[F][T][T][F] = MPU_ACTION;
-        table[F][T][T][T] = MPU_ACTION;
+        [F][T][F][F] = MPU_ACTION,
+        [F][T][F][T] = MPU_ACTION,
+        [F][T][T][F] = MPU_ACTION,
+        [F][T][T][T] = MPU_ACTION,
 
         /* Only MMU; non-mmu range; kernel access */
-        table[T][F][F][F] = DIRECT_ACTION;
+        [T][F][F][F] = DIRECT_ACTION,
         /* Only MMU; non-mmu range; user access */
-        table[T][F][F][T] = EXCEPTION_ACTION;
+        [T][F][F][T] = EXCEPTION_ACTION,
 
         /* Only MMU; mmu range; both modes access */
-        table[T][F][T][F] = MMU_ACTION;
-        table[T][F][T][T] = MMU_ACTION;
+        [T][F][T][F] = MMU_ACTION,
+        [T][F][T][T] = MMU_ACTION,
 
         /* Both MMU and MPU enabled; non-mmu range */
-        table[T][T][F][F] = MPU_ACTION;
-        table[T][T][F][T] = MPU_ACTION;
+        [T][T][F][F] = MPU_ACTION,
+        [T][T][F][T] = MPU_ACTION,
 
         /* Both MMU and MPU enabled; mmu range */
-        table[T][T][T][F] = MMU_ACTION;
-        table[T][T][T][T] = MMU_ACTION;
-
+        [T][T][T][F] = MMU_ACTION,
+        [T][T][T][T] = MMU_ACTION,
+    };
 #undef T
 #undef F
-
-        is_initialized = true;
-    }
+    const bool is_user = (mmu_idx == 1);
+    const bool is_mmu_range = ((addr >= MMU_VA_START) && (addr < MMU_VA_END));
 
     return table[env->mmu.v3.enabled][env->mpu.enabled][is_mmu_range][is_user];
 }
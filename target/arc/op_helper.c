@@ -33,7 +33,9 @@
 #include "sysemu/sysemu.h"
 #include "exec/exec-all.h"
 #include "target/arc/arconnect.h"
+#include "target/arc/timer.h"
 #include "qemu/log.h"
+#include "qemu/atomic128.h"
 
 
 static target_ulong get_status32(CPUARCState *env)
@@ -76,105 +78,219 @@ static void set_status32(CPUARCState *env, target_ulong value)
 #endif
 }
 
+/*
+ * LLOCK/SCOND are modelled with a table of lock flags indexed by a hash
+ * of the physical address, shared by all cores.  An entry mutex is only
+ * held to test and update the flag, never across a guest memory access:
+ * besides faults, an access may leave the helper through
+ * cpu_loop_exit_atomic() or a watchpoint.
+ *
+ * The address and value read by LLOCK are kept per core, in
+ * env->arconnect; the shared flag only lets one core's SCOND clear the
+ * reservation of the others.  SCOND claims the flag, clearing it under
+ * the mutex, and then does its store with a cmpxchg against the value
+ * its own LLOCK read.  Of two cores racing on the same entry only one
+ * can claim it.  A plain store done by another core in the meantime is
+ * not seen by the lock flag table, but it does make the cmpxchg fail.
+ */
+static void lpa_lf_set(CPUARCState *env, hwaddr haddr, uint64_t value)
+{
+    struct lpa_lf_entry *entry = &lpa_lfs[LPA_LFS_ENTRY_FOR_PA(haddr)];
+
+    haddr &= ~LPA_LFS_ALIGNEMENT_MASK;
+    env->arconnect.lpa_lf_addr = haddr;
+    env->arconnect.lpa_lf_value = value;
+
+    qemu_mutex_lock(&entry->mutex);
+    entry->lpa_lf = haddr + 1;  /* least significant bit is LF flag */
+    qemu_mutex_unlock(&entry->mutex);
+
+    env->arconnect.locked_mutex = &entry->mutex;
+    env->arconnect.lpa_lf = entry;
+}
+
+/*
+ * Clear the lock flag, returning true if it was set for @haddr by this
+ * core's last LLOCK, which read *@value.
+ */
+static bool lpa_lf_claim(CPUARCState *env, hwaddr haddr, uint64_t *value)
+{
+    struct lpa_lf_entry *entry = env->arconnect.lpa_lf;
+    bool claimed;
+
+    if (entry == NULL) {
+        /* No LLOCK was ever executed on this core. */
+        return false;
+    }
+    haddr &= ~LPA_LFS_ALIGNEMENT_MASK;
+
+    qemu_mutex_lock(&entry->mutex);
+    claimed = env->arconnect.lpa_lf_addr == haddr
+              && entry->lpa_lf == haddr + 1;
+    entry->lpa_lf &= -2;
+    qemu_mutex_unlock(&entry->mutex);
+
+    *value = env->arconnect.lpa_lf_value;
+    return claimed;
+}
+
+/*
+ * SCOND of a 4 or 8 byte @value at @addr, returning 0 on success and 1
+ * on failure, as the STATUS32.Z flag wants it.
+ */
+static target_ulong do_scond(CPUARCState *env, target_ulong addr,
+                             uint64_t value, MemOp size, uintptr_t ra)
+{
+    CPUState *cs = env_cpu(env);
+    int mmu_idx = cpu_mmu_index(env, false);
+    bool parallel = (cs->tcg_cflags & CF_PARALLEL) &&
+                    !cpu_in_exclusive_context(cs);
+    MemOpIdx oi = make_memop_idx(size | MO_LE | MO_ALIGN, mmu_idx);
+    uint64_t expected, old;
+    hwaddr haddr;
+    void *host;
+    bool serialize;
+    int flags;
+
+    arc_get_physical_addr(cs, &haddr, addr, MMU_MEM_WRITE, false, ra);
+    probe_write(env, addr, memop_size(size), mmu_idx, ra);
+
+    if (parallel) {
+        /*
+         * Serialize what cannot be done with a host cmpxchg now, before
+         * the flag is claimed: cpu_exec_step_atomic() runs the insn
+         * again, and would find it cleared.
+         */
+        flags = probe_access_flags(env, addr, MMU_DATA_STORE, mmu_idx,
+                                   false, &host, ra);
+        serialize = flags & (TLB_MMIO | TLB_WATCHPOINT);
+#ifndef CONFIG_ATOMIC64
+        /* No 64-bit host cmpxchg either */
+        serialize |= size == MO_64;
+#endif
+        if (serialize) {
+            cpu_loop_exit_atomic(cs, ra);
+        }
+
+        if (!lpa_lf_claim(env, haddr, &expected)) {
+            return 1;
+        }
+        if (size == MO_32) {
+            old = cpu_atomic_cmpxchgl_le_mmu(env, addr, expected, value,
+                                             oi, ra);
+            return (uint32_t)old != (uint32_t)expected;
+        }
+#ifdef CONFIG_ATOMIC64
+        old = cpu_atomic_cmpxchgq_le_mmu(env, addr, expected, value, oi, ra);
+        return old != expected;
+#else
+        g_assert_not_reached();
+#endif
+    }
+
+    /* We're executing in a serial context -- no need to be atomic.  */
+    if (size == MO_32) {
+        old = cpu_ldl_le_data_ra(env, addr, ra);
+    } else {
+        old = cpu_ldq_le_data_ra(env, addr, ra);
+    }
+    if (!lpa_lf_claim(env, haddr, &expected)) {
+        return 1;
+    }
+    if (size == MO_32) {
+        if ((uint32_t)old != (uint32_t)expected) {
+            return 1;
+        }
+        cpu_stl_le_data_ra(env, addr, value, ra);
+    } else {
+        if (old != expected) {
+            return 1;
+        }
+        cpu_stq_le_data_ra(env, addr, value, ra);
+    }
+    return 0;
+}
+
 target_ulong helper_llock(CPUARCState *env, target_ulong addr)
 {
     assert((addr & 0x3) == 0);
     hwaddr haddr;
     CPUState *cs = env_cpu(env);
     arc_get_physical_addr(cs, &haddr, addr, MMU_MEM_READ, false, GETPC());
-    struct lpa_lf_entry *entry = &lpa_lfs[LPA_LFS_ENTRY_FOR_PA(haddr)];
     qemu_log_mask(LOG_UNIMP, "0x" TARGET_FMT_lx "LLOCK at addr 0x" TARGET_FMT_lx " at index %d\n",
                   env->pc,
                   (target_ulong) haddr, (int) LPA_LFS_ENTRY_FOR_PA(haddr));
-    qemu_mutex_lock(&entry->mutex);
-    env->arconnect.locked_mutex = &entry->mutex;
-    env->arconnect.lpa_lf = entry;
 
     target_ulong ret = cpu_ldl_data_ra(env, addr, GETPC());
-    entry->lpa_lf = (haddr & (~LPA_LFS_ALIGNEMENT_MASK));
-    entry->lpa_lf += 1;     /* least significant bit is LF flag */
-    entry->read_value = ret;
-    qemu_mutex_unlock(&entry->mutex);
+    lpa_lf_set(env, haddr, ret);
     return ret;
 }
 
 target_ulong helper_getlf(CPUARCState *env)
 {
-    return (env->arconnect.lpa_lf != NULL && env->arconnect.lpa_lf->lpa_lf & 0x01);
+    return (env->arconnect.lpa_lf != NULL
+            && qatomic_read(&env->arconnect.lpa_lf->lpa_lf)
+               == env->arconnect.lpa_lf_addr + 1);
 }
 
 target_ulong helper_scond(CPUARCState *env, target_ulong addr, target_ulong value)
 {
     assert((addr & 0x3) == 0);
-    hwaddr haddr;
-    CPUState *cs = env_cpu(env);
-    arc_get_physical_addr(cs, &haddr, addr, MMU_MEM_WRITE, false, GETPC());
-    qemu_log_mask(LOG_UNIMP, "0x" TARGET_FMT_lx "SCOND at addr 0x" TARGET_FMT_lx " at index %d\n",
-                  env->pc,
-                  (target_ulong) haddr, (int) LPA_LFS_ENTRY_FOR_PA(haddr));
-    qemu_mutex_lock(env->arconnect.locked_mutex);
-    struct lpa_lf_entry *entry = env->arconnect.lpa_lf;
-    haddr = (haddr & (~LPA_LFS_ALIGNEMENT_MASK));
-    target_ulong ret = 1;
-    target_ulong rvalue = cpu_ldl_data_ra(env, addr, GETPC());
-    if(entry->lpa_lf == (haddr + 1) && (entry->read_value == rvalue)) {
-        ret  = 0;
-        cpu_stl_data_ra(env, addr, value, GETPC());
-        qemu_log_mask(LOG_UNIMP, "SCOND success with value 0x" TARGET_FMT_lx "\n", value);
-    }
-    else
-        {
-          qemu_log_mask(LOG_UNIMP, "SCOND fail with value 0x" TARGET_FMT_lx "\n", value);
+    target_ulong ret = do_scond(env, addr, (uint32_t)value, MO_32, GETPC());
 
-        }
-    entry->lpa_lf &= -2;
-    qemu_mutex_unlock(&entry->mutex);
+    qemu_log_mask(LOG_UNIMP, "0x" TARGET_FMT_lx "SCOND at addr 0x"
+                  TARGET_FMT_lx " %s with value 0x" TARGET_FMT_lx "\n",
+                  env->pc, addr, ret == 0 ? "success" : "fail", value);
     return ret;
 }
 
+#if defined(TARGET_ARC64)
+/*
+ * Single copy atomic LDDL/STDL, only used for 16-byte aligned accesses
+ * when other vCPUs run in parallel and the host has 128-bit atomics.
+ */
+uint64_t helper_lddl_parallel(CPUARCState *env, target_ulong addr,
+                              uint32_t opidx)
+{
+    Int128 ret;
+
+    assert(HAVE_ATOMIC128);
+    ret = cpu_atomic_ldo_le_mmu(env, addr, opidx, GETPC());
+    env->lddl_hi = int128_gethi(ret);
+    return int128_getlo(ret);
+}
+
+void helper_stdl_parallel(CPUARCState *env, target_ulong addr,
+                          uint64_t lo, uint64_t hi, uint32_t opidx)
+{
+    assert(HAVE_ATOMIC128);
+    cpu_atomic_sto_le_mmu(env, addr, int128_make128(lo, hi), opidx, GETPC());
+}
+#endif
+
 #if defined(TARGET_ARC64)
 target_ulong helper_llockl(CPUARCState *env, target_ulong addr)
 {
-    assert((addr & 0x3) == 0);
+    assert((addr & 0x7) == 0);
     target_ulong haddr;
     CPUState *cs = env_cpu(env);
     arc_get_physical_addr(cs, &haddr, addr, MMU_MEM_READ, false, GETPC());
-    struct lpa_lf_entry *entry = &lpa_lfs[LPA_LFS_ENTRY_FOR_PA(haddr)];
     qemu_log_mask(LOG_UNIMP, "0x" TARGET_FMT_lx "LLOCKL at addr 0x" TARGET_FMT_lx " at index %d\n",
                   env->pc,
                   (target_ulong) haddr, (int) LPA_LFS_ENTRY_FOR_PA(haddr));
-    qemu_mutex_lock(&entry->mutex);
-    env->arconnect.locked_mutex = &entry->mutex;
-    env->arconnect.lpa_lf = entry;
 
     target_ulong ret = cpu_ldq_data_ra(env, addr, GETPC());
-    entry->lpa_lf = (haddr & (~LPA_LFS_ALIGNEMENT_MASK));
-    entry->lpa_lf += 1;     /* least significant bit is LF flag */
-    entry->read_value = ret;
-    qemu_mutex_unlock(&entry->mutex);
+    lpa_lf_set(env, haddr, ret);
     return ret;
 }
 target_ulong helper_scondl(CPUARCState *env, target_ulong addr, target_ulong value)
 {
-    assert((addr & 0x3) == 0);
-    target_ulong haddr;
-    CPUState *cs = env_cpu(env);
-    arc_get_physical_addr(cs, &haddr, addr, MMU_MEM_WRITE, false, GETPC());
-    qemu_log_mask(LOG_UNIMP, "0x" TARGET_FMT_lx "SCONDL at addr 0x" TARGET_FMT_lx " at index %d\n",
-                  env->pc,
-                  (target_ulong) haddr, (int) LPA_LFS_ENTRY_FOR_PA(haddr));
-    struct lpa_lf_entry *entry = env->arconnect.lpa_lf;
-    qemu_mutex_lock(env->arconnect.locked_mutex);
-    target_ulong ret = 1;
-    haddr = (haddr & (~LPA_LFS_ALIGNEMENT_MASK));
-    target_ulong rvalue = cpu_ldq_data_ra(env, addr, GETPC());
-    if(entry->lpa_lf == (haddr + 1) && (entry->read_value == rvalue)) {
-        ret = 0;
-        cpu_stq_data_ra(env, addr, value, GETPC());
-        qemu_log_mask(LOG_UNIMP, "SCONDL success\n");
-    }
-    entry->lpa_lf &= -2;
-    qemu_mutex_unlock(&entry->mutex);
+    assert((addr & 0x7) == 0);
+    target_ulong ret = do_scond(env, addr, value, MO_64, GETPC());
+
+    qemu_log_mask(LOG_UNIMP, "0x" TARGET_FMT_lx "SCONDL at addr 0x"
+                  TARGET_FMT_lx " %s\n",
+                  env->pc, addr, ret == 0 ? "success" : "fail");
     return ret;
 }
 
@@ -186,41 +302,16 @@ uint64_t helper_llockd(CPUARCState *env, target_ulong addr)
     hwaddr haddr;
     CPUState *cs = env_cpu(env);
     arc_get_physical_addr(cs, &haddr, addr, MMU_MEM_READ, false, GETPC());
-    struct lpa_lf_entry *entry = &lpa_lfs[LPA_LFS_ENTRY_FOR_PA(haddr)];
-    qemu_mutex_lock(&entry->mutex);
-    env->arconnect.locked_mutex = &entry->mutex;
-    env->arconnect.lpa_lf = entry;
 
     uint64_t ret = cpu_ldq_data_ra(env, addr, GETPC());
-
-    entry->lpa_lf = (haddr & (~LPA_LFS_ALIGNEMENT_MASK));
-    entry->lpa_lf += 1;     /* least significant bit is LF flag */
-    entry->read_value = ret;
-
-    qemu_mutex_unlock(&entry->mutex);
+    lpa_lf_set(env, haddr, ret);
 
     return ret;
 }
 target_ulong helper_scondd(CPUARCState *env, target_ulong addr, uint64_t value)
 {
     assert((addr & 0x7) == 0);
-    hwaddr haddr;
-    CPUState *cs = env_cpu(env);
-    arc_get_physical_addr(cs, &haddr, addr, MMU_MEM_WRITE, false, GETPC());
-    struct lpa_lf_entry *entry = env->arconnect.lpa_lf;
-    qemu_mutex_lock(env->arconnect.locked_mutex);
-    target_ulong ret = 1;
-    addr = (addr & (~LPA_LFS_ALIGNEMENT_MASK));
-
-    uint64_t rvalue = cpu_ldq_data_ra(env, addr, GETPC());
-
-    if(entry->lpa_lf == (haddr + 1) && entry->read_value == rvalue) {
-        ret = 0;
-        cpu_stq_data_ra(env, addr, value, GETPC());
-    }
-    entry->lpa_lf &= -2;
-    qemu_mutex_unlock(&entry->mutex);
-    return ret;
+    return do_scond(env, addr, value, MO_64, GETPC());
 }
 #endif
 
@@ -298,6 +389,7 @@ void QEMU_NORETURN helper_halt(CPUARCState *env, target_ulong npc)
         env->pc = npc;
         cs->halted = 1;
         cs->exception_index = EXCP_HLT;
+        arc_cycles_idle(env);
     }
     cpu_loop_exit(cs);
 }
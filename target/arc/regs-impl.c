@@ -30,8 +30,8 @@
 
 static target_ulong get_identity(CPUARCState *env)
 {
-    target_ulong chipid = 0xffff, arcnum = 0, arcver, res;
     ARCCPU *cpu = env_archcpu(env);
+    target_ulong chipid = 0xffff, arcnum = cpu->core_id, arcver, res;
 
     switch (cpu->family) {
     case ARC_OPCODE_ARC700:
@@ -56,23 +56,21 @@ static target_ulong get_identity(CPUARCState *env)
 
     }
 
-    /* TODO: in SMP, arcnum depends on the cpu instance. */
     res = ((chipid & 0xFFFF) << 16) | ((arcnum & 0xFF) << 8) | (arcver & 0xFF);
     return res;
 }
 
 
 
-/* TODO: Move this to thread safe data structure. */
-target_ulong jli_base;
-
 target_ulong
 arc_jli_regs_get(const struct arc_aux_reg_detail *aux_reg_detail,
              void *data)
 {
+    CPUARCState *env = (CPUARCState *) data;
+
     switch (aux_reg_detail->id) {
     case AUX_ID_jli_base:
-        return jli_base;
+        return env->aux_jli_base;
         break;
     default:
         assert(0);
@@ -84,9 +82,11 @@ void
 arc_jli_regs_set(const struct arc_aux_reg_detail *aux_reg_detail,
              target_ulong val, void *data)
 {
+    CPUARCState *env = (CPUARCState *) data;
+
     switch (aux_reg_detail->id) {
     case AUX_ID_jli_base:
-        jli_base = val & (~((target_ulong) 3));
+        env->aux_jli_base = val & (~((target_ulong) 3));
         break;
     default:
         assert(0);
@@ -102,6 +102,27 @@ arc_aux_reg_address_for(enum arc_aux_reg_enum aux_reg_def,
     return 0;
 }
 
+/*
+ * Same result as arc_aux_reg_struct_for_address(), but going through the
+ * few details of AUX_REG_DEF instead of scanning all of them.
+ */
+struct arc_aux_reg_detail *
+arc_aux_reg_struct_for(enum arc_aux_reg_enum aux_reg_def, int isa_mask)
+{
+    struct arc_aux_reg_detail *detail = arc_aux_regs[aux_reg_def].first;
+    struct arc_aux_reg_detail *default_ret = NULL;
+
+    for (; detail != NULL; detail = detail->next) {
+        if (detail->cpu == ARC_OPCODE_DEFAULT) {
+            default_ret = detail;
+        } else if ((detail->cpu & isa_mask) != 0) {
+            return detail;
+        }
+    }
+
+    return default_ret;
+}
+
 struct arc_aux_reg_detail *
 arc_aux_reg_struct_for_address(int address, int isa_mask)
 {
@@ -113,6 +113,7 @@ extern const char *arc_aux_reg_name[ARC_AUX_REGS_DETAIL_LAST];
 void arc_aux_regs_init(void);
 int arc_aux_reg_address_for(enum arc_aux_reg_enum, int);
 struct arc_aux_reg_detail *arc_aux_reg_struct_for_address(int, int);
+struct arc_aux_reg_detail *arc_aux_reg_struct_for(enum arc_aux_reg_enum, int);
 
 target_ulong __not_implemented_getter(const struct arc_aux_reg_detail *,
                                       void *);
@@ -161,6 +161,7 @@ void arc_gen_set_debug(const DisasCtxt *ctx, bool value);
 #define setPC(NEW_PC)                                   \
     do {                                                \
         if(ctx->insn.d == 0) {                          \
+            arc_gen_cycles_branch(ctx, false);          \
             gen_goto_tb(ctx, 1, NEW_PC);                    \
             ret = ret == DISAS_NEXT ? DISAS_NORETURN : ret; \
         } else {                                        \
@@ -168,8 +169,12 @@ void arc_gen_set_debug(const DisasCtxt *ctx, bool value);
         }                                               \
     } while (0)
 
-#define setBLINK(BLINK_ADDR) \
-  tcg_gen_mov_tl(cpu_blink, BLINK_ADDR);
+/* Only calls set BLINK: tell the return stack about them. */
+#define setBLINK(BLINK_ADDR)                    \
+    do {                                        \
+        tcg_gen_mov_tl(cpu_blink, BLINK_ADDR);  \
+        tcg_gen_push_return(BLINK_ADDR);        \
+    } while (0)
 
 #ifdef TARGET_ARC32
 
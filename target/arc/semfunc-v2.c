@@ -7540,7 +7540,14 @@ arc_gen_EX (DisasCtxt *ctx, TCGv b, TCGv c)
 }
 
 
-//#define ARM_LIKE_LLOCK_SCOND
+/*
+ * In user mode there are neither physical addresses nor other bus masters
+ * to track, so LLOCK/SCOND are done inline with a guest load and a host
+ * cmpxchg instead of calling the lpa_lfs based helpers.
+ */
+#ifdef CONFIG_USER_ONLY
+#define ARM_LIKE_LLOCK_SCOND
+#endif
 
 extern TCGv cpu_exclusive_addr;
 extern TCGv cpu_exclusive_val;
@@ -7557,7 +7564,8 @@ arc_gen_LLOCK(DisasCtxt *ctx, TCGv dest, TCGv src)
 #ifndef ARM_LIKE_LLOCK_SCOND
     gen_helper_llock(dest, cpu_env, src);
 #else
-    tcg_gen_qemu_ld_tl(cpu_exclusive_val, src, ctx->mem_idx, MO_UL);
+    tcg_gen_qemu_ld_tl(cpu_exclusive_val, src, ctx->mem_idx,
+                       MO_UL | MO_ALIGN);
     tcg_gen_mov_tl(dest, cpu_exclusive_val);
     tcg_gen_mov_tl(cpu_exclusive_addr, src);
 #endif
@@ -7582,7 +7590,7 @@ arc_gen_LLOCKD(DisasCtxt *ctx, TCGv dest, TCGv src)
 #ifndef ARM_LIKE_LLOCK_SCOND
     gen_helper_llockd(temp_1, cpu_env, src);
 #else
-    tcg_gen_qemu_ld_i64(temp_1, src, ctx->mem_idx, MO_UQ);
+    tcg_gen_qemu_ld_i64(temp_1, src, ctx->mem_idx, MO_UQ | MO_ALIGN);
     tcg_gen_mov_tl(cpu_exclusive_addr, src);
 
     tcg_gen_shri_i64(temp_2, temp_1, 32);
@@ -7634,7 +7642,7 @@ arc_gen_SCOND(DisasCtxt *ctx, TCGv addr, TCGv value)
     tcg_gen_br(done_label);
 
     gen_set_label(fail_label);
-    tcg_gen_movi_tl(cpu_Zf, 1);
+    tcg_gen_movi_tl(cpu_Zf, 0);
     gen_set_label(done_label);
     tcg_gen_movi_tl(cpu_exclusive_addr, -1);
 #endif
@@ -7676,7 +7684,7 @@ arc_gen_SCONDD(DisasCtxt *ctx, TCGv addr, TCGv value)
     TCGLabel *done_label = gen_new_label();
 
     tcg_gen_ext_i32_i64(temp_3, cpu_exclusive_val_hi);
-    tcg_gen_ext_i32_i64(temp_4, cpu_exclusive_val);
+    tcg_gen_extu_i32_i64(temp_4, cpu_exclusive_val);
     tcg_gen_shli_i64(temp_3, temp_3, 32);
 
     tcg_gen_brcond_tl(TCG_COND_NE, addr, cpu_exclusive_addr, fail_label);
@@ -7688,7 +7696,7 @@ arc_gen_SCONDD(DisasCtxt *ctx, TCGv addr, TCGv value)
 
     tcg_gen_atomic_cmpxchg_i64(tmp, cpu_exclusive_addr, exclusive_val,
                                temp_1, ctx->mem_idx,
-                               MO_UL | MO_ALIGN);
+                               MO_UQ | MO_ALIGN);
     tcg_gen_setcond_i64(TCG_COND_NE, tmp, tmp, exclusive_val);
     tcg_gen_trunc_i64_tl(tmp1, tmp);
     setZFlag(tmp1);
@@ -7698,7 +7706,7 @@ arc_gen_SCONDD(DisasCtxt *ctx, TCGv addr, TCGv value)
     tcg_gen_br(done_label);
 
     gen_set_label(fail_label);
-    tcg_gen_movi_tl(cpu_Zf, 1);
+    tcg_gen_movi_tl(cpu_Zf, 0);
     gen_set_label(done_label);
     tcg_gen_movi_tl(cpu_exclusive_addr, -1);
 #endif
@@ -7908,7 +7908,14 @@ arc_gen_EX (DisasCtxt *ctx, TCGv b, TCGv c)
 }
 
 
-#undef ARM_LIKE_LLOCK_SCOND
+/*
+ * In user mode there are neither physical addresses nor other bus masters
+ * to track, so LLOCK/SCOND are done inline with a guest load and a host
+ * cmpxchg instead of calling the lpa_lfs based helpers.
+ */
+#ifdef CONFIG_USER_ONLY
+#define ARM_LIKE_LLOCK_SCOND
+#endif
 
 extern TCGv cpu_exclusive_addr;
 extern TCGv cpu_exclusive_val;
@@ -7924,7 +7931,8 @@ arc_gen_LLOCK(DisasCtxt *ctx, TCGv dest, TCGv src)
 #ifndef ARM_LIKE_LLOCK_SCOND
     gen_helper_llock(dest, cpu_env, src);
 #else
-    tcg_gen_qemu_ld_tl(cpu_exclusive_val, src, ctx->mem_idx, MO_UL);
+    tcg_gen_qemu_ld_tl(cpu_exclusive_val, src, ctx->mem_idx,
+                       MO_UL | MO_ALIGN);
     tcg_gen_mov_tl(dest, cpu_exclusive_val);
     tcg_gen_mov_tl(cpu_exclusive_addr, src);
 #endif
@@ -7943,7 +7951,8 @@ arc_gen_LLOCKL(DisasCtxt *ctx, TCGv dest, TCGv src)
 #ifndef ARM_LIKE_LLOCK_SCOND
     gen_helper_llockl(dest, cpu_env, src);
 #else
-    tcg_gen_qemu_ld_tl(cpu_exclusive_val, src, ctx->mem_idx, MO_UQ);
+    tcg_gen_qemu_ld_tl(cpu_exclusive_val, src, ctx->mem_idx,
+                       MO_UQ | MO_ALIGN);
     tcg_gen_mov_tl(dest, cpu_exclusive_val);
     tcg_gen_mov_tl(cpu_exclusive_addr, src);
 #endif
@@ -7984,7 +7993,7 @@ arc_gen_SCOND(DisasCtxt *ctx, TCGv addr, TCGv value)
     tcg_gen_br(done_label);
 
     gen_set_label(fail_label);
-    tcg_gen_movi_tl(cpu_Zf, 1);
+    tcg_gen_movi_tl(cpu_Zf, 0);
     gen_set_label(done_label);
     tcg_gen_movi_tl(cpu_exclusive_addr, -1);
 #endif
@@ -8025,7 +8034,7 @@ arc_gen_SCONDL(DisasCtxt *ctx, TCGv addr, TCGv value)
     tcg_gen_br(done_label);
 
     gen_set_label(fail_label);
-    tcg_gen_movi_tl(cpu_Zf, 1);
+    tcg_gen_movi_tl(cpu_Zf, 0);
     gen_set_label(done_label);
     tcg_gen_movi_tl(cpu_exclusive_addr, -1);
 #endif
@@ -27,49 +27,90 @@
 #include "timer.h"
 #include "qemu/main-loop.h"
 #include "qemu/log.h"
+#include "exec/helper-proto.h"
 
 #define NANOSECONDS_PER_SECOND 1000000000LL
 #define TIMER_PERIOD(hz) (1000000000LL / (hz))
 #define TIMEOUT_LIMIT 1000000
 
 #define FREQ_HZ (env_archcpu(env)->freq_hz)
+#define CYCLE_MODEL (env_archcpu(env)->cfg.cycle_model)
 
 #define CYCLES_TO_NS(VAL) (muldiv64(VAL, NANOSECONDS_PER_SECOND, FREQ_HZ))
 #define NS_TO_CYCLE(VAL)  (muldiv64(VAL, FREQ_HZ, NANOSECONDS_PER_SECOND))
 
-static uint64_t get_ns(CPUARCState *env)
+/*
+ * Timestamps of the timers and the RTC.  With the cycle model they are
+ * what the translated code has charged in env->cycles, so that COUNT is
+ * never converted to nanoseconds and back; otherwise they are
+ * QEMU_CLOCK_VIRTUAL nanoseconds.
+ */
+static uint64_t get_clk(CPUARCState *env)
 {
 #ifndef CONFIG_USER_ONLY
+    if (CYCLE_MODEL) {
+        return env->cycles;
+    }
     return qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
 #else
     return cpu_get_host_ticks();
 #endif
 }
 
-static uint32_t get_t_count(CPUARCState *env, uint32_t t)
+static uint64_t clk_to_cycles(CPUARCState *env, uint64_t val)
 {
 #ifndef CONFIG_USER_ONLY
-    return NS_TO_CYCLE(qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) - env->timer[t].last_clk);
-#else
-    return cpu_get_host_ticks() - env->timer[t].last_clk;
+    if (!CYCLE_MODEL) {
+        return NS_TO_CYCLE(val);
+    }
 #endif
+    return val;
+}
+
+static uint64_t cycles_to_clk(CPUARCState *env, uint64_t val)
+{
+#ifndef CONFIG_USER_ONLY
+    if (!CYCLE_MODEL) {
+        return CYCLES_TO_NS(val);
+    }
+#endif
+    return val;
+}
+
+static uint32_t get_t_count(CPUARCState *env, uint32_t t)
+{
+    return clk_to_cycles(env, get_clk(env) - env->timer[t].last_clk);
 }
 
 #define T_COUNT(T) (get_t_count(env, T))
 
+#ifndef CONFIG_USER_ONLY
+/* Recompute the cycle the translated code has to call us back at. */
+static void cpu_arc_cycles_update_deadline(CPUARCState *env)
+{
+    env->cycles_deadline = MIN(env->cycles_expire[0], env->cycles_expire[1]);
+}
+#endif
+
 /* Update the next timeout time as difference between Count and Limit */
 static void cpu_arc_timer_update(CPUARCState *env, uint32_t timer)
 {
     uint32_t delta;
     uint32_t t_count = T_COUNT(timer);
 #ifndef CONFIG_USER_ONLY
-    uint64_t now = get_ns(env);
+    uint64_t now = get_clk(env);
 #endif
 
     delta = env->timer[timer].T_Limit - t_count;
 
 #ifndef CONFIG_USER_ONLY
-    timer_mod_ns(env->cpu_timer[timer], now + CYCLES_TO_NS((uint64_t)delta));
+    if (CYCLE_MODEL) {
+        env->cycles_expire[timer] = env->cycles + MAX(delta, 1);
+        cpu_arc_cycles_update_deadline(env);
+    } else {
+        timer_mod_ns(env->cpu_timer[timer],
+                     now + CYCLES_TO_NS((uint64_t)delta));
+    }
 #endif
 
     qemu_log_mask(LOG_UNIMP,
@@ -95,7 +136,7 @@ static void cpu_arc_timer_expire(CPUARCState *env, uint32_t timer)
         qemu_mutex_lock_iothread();
     }
     env->timer[timer].T_Cntrl |= TMR_IP;
-    env->timer[timer].last_clk = get_ns(env);
+    env->timer[timer].last_clk = get_clk(env);
     if (unlocked) {
         qemu_mutex_unlock_iothread();
     }
@@ -148,13 +189,17 @@ static void cpu_rtc_count_update(CPUARCState *env)
     uint64_t llreg;
 
     assert((env_archcpu(env)->timer_build & TB_RTC) && env->cpu_rtc);
-    now = get_ns(env);
+    now = get_clk(env);
 
     if (!(env->aux_rtc_ctrl & 0x01)) {
         return;
     }
 
-    llreg = ((now - env->last_clk_rtc) / TIMER_PERIOD(FREQ_HZ));
+    if (CYCLE_MODEL) {
+        llreg = now - env->last_clk_rtc;
+    } else {
+        llreg = ((now - env->last_clk_rtc) / TIMER_PERIOD(FREQ_HZ));
+    }
     llreg += env->aux_rtc_low + ((uint64_t)env->aux_rtc_high << 32);
     env->aux_rtc_high = llreg >> 32;
     env->aux_rtc_low = (uint32_t) llreg;
@@ -172,9 +217,13 @@ static void cpu_rtc_update(CPUARCState *env)
     uint64_t next;
 
     assert(env->cpu_rtc);
-    now = get_ns(env);
+    now = get_clk(env);
 
-    if (!(env->aux_rtc_ctrl & 0x01)) {
+    /*
+     * The callback is only there to wrap the 64-bit count around, which
+     * the cycle model does not bother with.
+     */
+    if (!(env->aux_rtc_ctrl & 0x01) || CYCLE_MODEL) {
         return;
     }
 
@@ -208,7 +257,7 @@ static void arc_rtc_cb(void *opaque)
 
     env->aux_rtc_high = 0;
     env->aux_rtc_low = 0;
-    env->last_clk_rtc = get_ns(env);
+    env->last_clk_rtc = get_clk(env);
     cpu_rtc_update(env);
 }
 #endif
@@ -219,6 +268,7 @@ static void cpu_arc_count_reset(CPUARCState *env, uint32_t timer)
     assert(timer == 0 || timer == 1);
     env->timer[timer].T_Cntrl = 0;
     env->timer[timer].T_Limit = 0x00ffffff;
+    env->cycles_expire[timer] = UINT64_MAX;
 }
 
 /* Get the counter value. */
@@ -237,7 +287,7 @@ static void cpu_arc_count_set(CPUARCState *env, uint32_t timer, uint32_t val)
     if (unlocked) {
         qemu_mutex_lock_iothread();
     }
-    env->timer[timer].last_clk = get_ns(env) - CYCLES_TO_NS(val);
+    env->timer[timer].last_clk = get_clk(env) - cycles_to_clk(env, val);
     cpu_arc_timer_update(env, timer);
     if (unlocked) {
         qemu_mutex_unlock_iothread();
@@ -284,11 +334,23 @@ static void cpu_arc_control_set(CPUARCState *env,
     }
 }
 
-/* Get The RTC count value. */
+/*
+ * Get The RTC count value. Reading the count updates it, and so does
+ * the RTC callback from the main loop thread.
+ */
 static uint32_t arc_rtc_count_get(CPUARCState *env, bool lower)
 {
+    uint32_t ret;
+    bool unlocked = !qemu_mutex_iothread_locked();
+    if (unlocked) {
+        qemu_mutex_lock_iothread();
+    }
     cpu_rtc_count_update(env);
-    return lower ? env->aux_rtc_low : env->aux_rtc_high;
+    ret = lower ? env->aux_rtc_low : env->aux_rtc_high;
+    if (unlocked) {
+        qemu_mutex_unlock_iothread();
+    }
+    return ret;
 }
 
 /* Set the RTC control bits. */
@@ -300,7 +362,7 @@ static void arc_rtc_ctrl_set(CPUARCState *env, uint32_t val)
     if (val & 0x02) {
         env->aux_rtc_low = 0;
         env->aux_rtc_high = 0;
-        env->last_clk_rtc = get_ns(env);
+        env->last_clk_rtc = get_clk(env);
     }
     if (!(val & 0x01)) {
         timer_del(env->cpu_rtc);
@@ -308,7 +370,7 @@ static void arc_rtc_ctrl_set(CPUARCState *env, uint32_t val)
 
     /* Restart RTC, update last clock. */
     if ((env->aux_rtc_ctrl & 0x01) == 0 && (val & 0x01)) {
-        env->last_clk_rtc = get_ns(env);
+        env->last_clk_rtc = get_clk(env);
     }
 
     env->aux_rtc_ctrl = 0xc0000000 | (val & 0x01);
@@ -340,8 +402,8 @@ cpu_arc_clock_init(ARCCPU *cpu)
     }
 #endif
 
-    env->timer[0].last_clk = get_ns(env);
-    env->timer[1].last_clk = get_ns(env);
+    env->timer[0].last_clk = get_clk(env);
+    env->timer[1].last_clk = get_clk(env);
 }
 
 void
@@ -367,6 +429,51 @@ arc_resetTIMER(ARCCPU *cpu)
     if (env_archcpu(env)->timer_build & TB_T1) {
         cpu_arc_count_reset(env, 1);
     }
+
+#ifndef CONFIG_USER_ONLY
+    cpu_arc_cycles_update_deadline(env);
+#endif
+}
+
+/*
+ * Called from the start of a TB, with the cycle model, once
+ * env->cycles has reached env->cycles_deadline: run the callbacks of
+ * the timers that expired, as the main loop would have done.
+ */
+void helper_cycles_expired(CPUARCState *env)
+{
+#ifndef CONFIG_USER_ONLY
+    bool unlocked = !qemu_mutex_iothread_locked();
+    if (unlocked) {
+        qemu_mutex_lock_iothread();
+    }
+    if (env->cycles >= env->cycles_expire[0]) {
+        env->cycles_expire[0] = UINT64_MAX;
+        arc_timer0_cb(env);
+    }
+    if (env->cycles >= env->cycles_expire[1]) {
+        env->cycles_expire[1] = UINT64_MAX;
+        arc_timer1_cb(env);
+    }
+    cpu_arc_cycles_update_deadline(env);
+    if (unlocked) {
+        qemu_mutex_unlock_iothread();
+    }
+#endif
+}
+
+/*
+ * A core that goes to sleep with the cycle model would otherwise never
+ * see its timers expire: skip the idle cycles up to the next one.
+ */
+void arc_cycles_idle(CPUARCState *env)
+{
+#ifndef CONFIG_USER_ONLY
+    if (CYCLE_MODEL && env->cycles_deadline != UINT64_MAX) {
+        env->cycles = MAX(env->cycles, env->cycles_deadline);
+        helper_cycles_expired(env);
+    }
+#endif
 }
 
 /* Function implementation for reading/writing aux regs. */
@@ -23,5 +23,6 @@
 
 void arc_initializeTIMER(ARCCPU *);
 void arc_resetTIMER(ARCCPU *);
+void arc_cycles_idle(CPUARCState *);
 
 #endif
@@ -22,6 +22,7 @@
 #include "translate.h"
 #include "qemu/qemu-print.h"
 #include "tcg/tcg-op-gvec.h"
+#include "qemu/atomic128.h"
 #include "target/arc/semfunc.h"
 #include "target/arc/arc-common.h"
 
@@ -84,6 +85,8 @@ void gen_goto_tb(const DisasContext *ctx, int n, TCGv dest)
     /* TODO: is this really needed !!! */
     if (ctx->base.singlestep_enabled) {
         gen_helper_debug(cpu_env);
+    } else if (ctx->guest_return) {
+        tcg_gen_lookup_and_goto_ptr_ret();
     } else {
         tcg_gen_exit_tb(NULL, 0);
     }
@@ -107,16 +110,17 @@ static void gen_gotoi_tb(DisasContext *ctx, int n, target_ulong dest)
 }
 
 /*
- * @brief Check if a QEMU mutex lock and LockFlag could be held, if so unlock
- * mutex and clear flag
+ * @brief Clear the LockFlag held by this cpu, if any. The entry mutexes are
+ * never held outside of the llock/scond helpers.
  */
 static void
 arc_cpu_release_llockscond_locks(ARCCPU *cpu) {
     struct lpa_lf_entry *entry = cpu->env.arconnect.lpa_lf;
     QemuMutex *locked_mutex = cpu->env.arconnect.locked_mutex;
     if (locked_mutex != NULL && entry != NULL) {
-        qemu_mutex_unlock(locked_mutex);
+        qemu_mutex_lock(locked_mutex);
         entry->lpa_lf = 0;
+        qemu_mutex_unlock(locked_mutex);
     }
 }
 
@@ -125,7 +129,7 @@ void arc_cpu_record_sigsegv(CPUState *cs, vaddr addr,
                             bool maperr, uintptr_t ra) {
     /*
      * An invalid llock/scond memory access can bring us here, so we need to
-     * unlock any available locks to prevent deadlock state
+     * drop the lock flag this cpu may still hold
      */
     arc_cpu_release_llockscond_locks(ARC_CPU(cs));
 }
@@ -135,11 +139,13 @@ void arc_cpu_record_sigbus(CPUState *cs, vaddr addr,
                             uintptr_t ra) {
     /*
      * An invalid llock/scond memory access can bring us here, so we need to
-     * unlock any available locks to prevent deadlock state
+     * drop the lock flag this cpu may still hold
      */
     arc_cpu_release_llockscond_locks(ARC_CPU(cs));
 }
 
+static void init_constants(void);
+
 void arc_translate_init(void)
 {
     int i;
@@ -199,12 +205,26 @@ void arc_translate_init(void)
 #undef ARC_REG_OFFS
 #undef NEW_ARC_REG
 
+    /*
+     * restore_state_to_opc() sets both from the insn_start data, so the
+     * NPC written by every instruction need not reach env before each
+     * load or store that follows it.
+     */
+    tcg_global_set_restorable(cpu_pc);
+    tcg_global_set_restorable(cpu_npc);
+
     cpu_exclusive_addr = tcg_global_mem_new(cpu_env,
         offsetof(CPUARCState, exclusive_addr), "exclusive_addr");
     cpu_exclusive_val = tcg_global_mem_new(cpu_env,
         offsetof(CPUARCState, exclusive_val), "exclusive_val");
     cpu_exclusive_val_hi = tcg_global_mem_new(cpu_env,
         offsetof(CPUARCState, exclusive_val_hi), "exclusive_val_hi");
+
+    /*
+     * Done here rather than lazily on the first decode: with MTTCG
+     * several vCPU threads may be translating at the same time.
+     */
+    init_constants();
 }
 
 static void arc_tr_init_disas_context(DisasContextBase *dcbase,
@@ -214,14 +234,24 @@ static void arc_tr_init_disas_context(DisasContextBase *dcbase,
 
     dc->base.is_jmp = DISAS_NEXT;
     dc->mem_idx = dc->base.tb->flags & 1;
+    dc->cycle_model = ARC_CPU(cs)->cfg.cycle_model;
+    /*
+     * Both icount and the cycle model charge the whole TB when it is
+     * entered, which a side exit would get wrong.
+     */
+    dc->superblock = ARC_CPU(cs)->cfg.superblocks && !dc->cycle_model
+                     && !(tb_cflags(dc->base.tb) & CF_USE_ICOUNT);
+    dc->guest_return = false;
+    dc->delayed_return = false;
 }
 static void arc_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
 {
-    /* place holder for now */
+    DisasContext *dc = container_of(dcbase, DisasContext, base);
+
     /* TODO: Make sure you really need to guard it. */
-    //DisasContext *dc = container_of(dcbase, DisasContext, base);
     //dc->possible_delayslot_instruction = dc->env->stat.DEf;
 
+    arc_gen_cycles_tb_start(dc);
 }
 
 static void arc_tr_insn_start(DisasContextBase *dcbase, CPUState *cpu)
@@ -419,57 +449,47 @@ static enum arc_opcode_map arc_map_opcode(const struct arc_opcode *opcode)
 #undef CONSTANT
 #undef SEMANTIC_FUNCTION
     default:
-        /* TODO: This should be later taken out since default behaviour should
-           be an invalid instruction exception. */
-        qemu_log_mask(LOG_UNIMP,
-                      "Instruction %s is not mapped to semantic function.\n",
-                      opcode->name);
-        assert("This should not happen" == 0);
+        return MAP_NONE;
     }
-
-    return MAP_NONE;
 }
 
+#define MAX_SEMFUNC_OPS 10
+
 /* Code support for constant values coming from semantic function mapping. */
 struct constant_operands {
-    uint8_t operand_number;
-    uint32_t default_value;
-    struct constant_operands *next;
+    uint16_t mask;      /* Operands that have a constant value. */
+    uint32_t value[MAX_SEMFUNC_OPS];
 };
 
-struct constant_operands *map_constant_operands[MAP_LAST];
+static struct constant_operands map_constant_operands[MAP_LAST];
+
+/*
+ * What arc_decode() needs to know about an opcode to call its semantic
+ * function, worked out once for all of arc_opcodes[] by init_constants().
+ */
+struct arc_opcode_plan {
+    enum arc_opcode_map mapping;
+    uint8_t n_ops;      /* Number of operands of the semantic function. */
+    const struct constant_operands *constants;
+};
+
+static struct arc_opcode_plan arc_opcode_plans[OPCODE_SIZE];
 
 static void add_constant_operand(enum arc_opcode_map mapping,
                                  uint8_t operand_number,
                                  uint32_t value)
 {
-    struct constant_operands **t = &(map_constant_operands[mapping]);
-    while (*t != NULL) {
-        t = &((*t)->next);
-    }
-    *t = (struct constant_operands *) g_new(struct constant_operands, 1);
+    struct constant_operands *co = &map_constant_operands[mapping];
 
-    (*t)->operand_number = operand_number;
-    (*t)->default_value = value;
-    (*t)->next = NULL;
-}
-
-static struct constant_operands *
-constant_entry_for(enum arc_opcode_map mapping,
-                   uint8_t operand_number)
-{
-    struct constant_operands *t = map_constant_operands[mapping];
-    while (t != NULL) {
-        if (t->operand_number == operand_number) {
-            return t;
-        }
-        t = t->next;
-    }
-    return NULL;
+    assert(operand_number < MAX_SEMFUNC_OPS);
+    co->mask |= 1 << operand_number;
+    co->value[operand_number] = value;
 }
 
 static void init_constants(void)
 {
+    int i;
+
 #define SEMANTIC_FUNCTION(...)
 #define MAPPING(...)
 #define CONSTANT(NAME, MNEMONIC, OP_NUM, VALUE) \
@@ -478,6 +498,17 @@ static void init_constants(void)
 #undef MAPPING
 #undef CONSTANT
 #undef SEMANTIC_FUNCTION
+
+    for (i = 0; i < OPCODE_SIZE; i++) {
+        struct arc_opcode_plan *plan = &arc_opcode_plans[i];
+
+        plan->mapping = arc_map_opcode(&arc_opcodes[i]);
+        if (plan->mapping != MAP_NONE) {
+            plan->n_ops = number_of_ops_semfunc[plan->mapping];
+            plan->constants = &map_constant_operands[plan->mapping];
+            assert(plan->n_ops <= MAX_SEMFUNC_OPS);
+        }
+    }
 }
 
 static void arc_debug_opcode(const struct arc_opcode *opcode,
@@ -489,17 +520,15 @@ static void arc_debug_opcode(const struct arc_opcode *opcode,
                   msg, opcode->name, ctx->cpc);
 }
 
-static TCGv arc_decode_operand(const struct arc_opcode *opcode,
-                               DisasContext *ctx,
+static TCGv arc_decode_operand(DisasContext *ctx,
                                unsigned char nop,
-                               enum arc_opcode_map mapping)
+                               const struct arc_opcode_plan *plan)
 {
     TCGv ret;
 
     if (nop >= ctx->insn.n_ops) {
-        struct constant_operands *co = constant_entry_for(mapping, nop);
-        assert(co != NULL);
-        ret = tcg_const_local_tl(co->default_value);
+        assert(plan->constants->mask & (1 << nop));
+        ret = tcg_const_local_tl(plan->constants->value[nop]);
         return ret;
     } else {
         operand_t operand = ctx->insn.operands[nop];
@@ -1037,6 +1066,108 @@ arc_gen_ADDHL(DisasCtxt *ctx, TCGv a, TCGv b, TCGv c)
     return DISAS_NEXT;
 }
 
+/*
+ * 128-bit accesses are done as two 64-bit ones, which is atomic enough
+ * as long as a single vCPU runs at a time.  Otherwise a 16-byte aligned
+ * access must be single copy atomic: it goes through a helper using the
+ * host 128-bit atomics or, without those, the instruction is restarted
+ * in the exclusive context.  Unaligned accesses are never atomic.
+ */
+static void arc_gen_ld128_pair(const DisasCtxt *ctx, TCGv lo, TCGv hi,
+                               TCGv addr)
+{
+    TCGv addr_hi = tcg_temp_new();
+
+    tcg_gen_qemu_ld_tl(lo, addr, ctx->mem_idx, MO_UQ);
+    tcg_gen_addi_tl(addr_hi, addr, 8);
+    tcg_gen_qemu_ld_tl(hi, addr_hi, ctx->mem_idx, MO_UQ);
+    tcg_temp_free(addr_hi);
+}
+
+static void arc_gen_st128_pair(const DisasCtxt *ctx, TCGv lo, TCGv hi,
+                               TCGv addr)
+{
+    TCGv addr_hi = tcg_temp_new();
+
+    tcg_gen_qemu_st_tl(lo, addr, ctx->mem_idx, MO_UQ);
+    tcg_gen_addi_tl(addr_hi, addr, 8);
+    tcg_gen_qemu_st_tl(hi, addr_hi, ctx->mem_idx, MO_UQ);
+    tcg_temp_free(addr_hi);
+}
+
+/*
+ * Emit a branch to the returned label when ADDR is not 16-byte aligned,
+ * or NULL if the access can simply be split.  Restarts the instruction
+ * in the exclusive context if the host lacks 128-bit atomics.
+ */
+static TCGLabel *arc_gen_128_unaligned(const DisasCtxt *ctx, TCGv addr)
+{
+    TCGLabel *unaligned;
+    TCGv tmp;
+
+    if (!(tb_cflags(ctx->base.tb) & CF_PARALLEL)) {
+        return NULL;
+    }
+    if (!HAVE_ATOMIC128) {
+        gen_helper_exit_atomic(cpu_env);
+        return NULL;
+    }
+
+    unaligned = gen_new_label();
+    tmp = tcg_temp_new();
+    tcg_gen_andi_tl(tmp, addr, 15);
+    tcg_gen_brcondi_tl(TCG_COND_NE, tmp, 0, unaligned);
+    tcg_temp_free(tmp);
+    return unaligned;
+}
+
+static void arc_gen_ld128(const DisasCtxt *ctx, TCGv lo, TCGv hi, TCGv addr)
+{
+    TCGLabel *unaligned = arc_gen_128_unaligned(ctx, addr);
+    TCGLabel *done;
+    TCGv_i32 oi;
+
+    if (unaligned == NULL) {
+        arc_gen_ld128_pair(ctx, lo, hi, addr);
+        return;
+    }
+
+    done = gen_new_label();
+    oi = tcg_const_i32(make_memop_idx(MO_LE | MO_128 | MO_ALIGN,
+                                      ctx->mem_idx));
+    gen_helper_lddl_parallel(lo, cpu_env, addr, oi);
+    tcg_gen_ld_i64(hi, cpu_env, offsetof(CPUARCState, lddl_hi));
+    tcg_temp_free_i32(oi);
+    tcg_gen_br(done);
+
+    gen_set_label(unaligned);
+    arc_gen_ld128_pair(ctx, lo, hi, addr);
+    gen_set_label(done);
+}
+
+static void arc_gen_st128(const DisasCtxt *ctx, TCGv lo, TCGv hi, TCGv addr)
+{
+    TCGLabel *unaligned = arc_gen_128_unaligned(ctx, addr);
+    TCGLabel *done;
+    TCGv_i32 oi;
+
+    if (unaligned == NULL) {
+        arc_gen_st128_pair(ctx, lo, hi, addr);
+        return;
+    }
+
+    done = gen_new_label();
+    oi = tcg_const_i32(make_memop_idx(MO_LE | MO_128 | MO_ALIGN,
+                                      ctx->mem_idx));
+    gen_helper_stdl_parallel(cpu_env, addr, lo, hi, oi);
+    tcg_temp_free_i32(oi);
+    tcg_gen_br(done);
+
+    gen_set_label(unaligned);
+    arc_gen_st128_pair(ctx, lo, hi, addr);
+    gen_set_label(done);
+}
+
 /*
  * 128-bit load.
  * FIXME: There is a mixture of decoder stuffs in here.
@@ -1105,9 +1236,7 @@ arc_gen_LDDL(DisasCtxt *ctx, TCGv base, TCGv offset, TCGv dest_lo)
 
     /* Load the data. */
     if (ctx->insn.operands[0].type & ARC_OPERAND_IR) {
-        tcg_gen_qemu_ld_tl(data_lo, addr, ctx->mem_idx, MO_UQ);
-        tcg_gen_addi_tl(addr, addr, 8);
-        tcg_gen_qemu_ld_tl(data_hi, addr, ctx->mem_idx, MO_UQ);
+        arc_gen_ld128(ctx, data_lo, data_hi, addr);
     }
 
     /*
@@ -1218,9 +1347,7 @@ arc_gen_STDL(DisasCtxt *ctx, TCGv base, TCGv offset, TCGv src)
     }
 
     /* Store the data. */
-    tcg_gen_qemu_st_tl(data_lo, addr, ctx->mem_idx, MO_UQ);
-    tcg_gen_addi_tl(addr, addr, 8);
-    tcg_gen_qemu_st_tl(data_hi, addr, ctx->mem_idx, MO_UQ);
+    arc_gen_st128(ctx, data_lo, data_hi, addr);
 
     if (ctx->insn.aa == 2) { /* Post-memory access increment. */
         tcg_gen_add_tl(addr, base, offset);
@@ -1454,21 +1581,15 @@ arc_gen_WLFC(DisasCtxt *ctx, TCGv c)
 static int arc_decode(DisasContext *ctx, const struct arc_opcode *opcode)
 {
     int ret = DISAS_NEXT;
-    enum arc_opcode_map mapping;
-    static bool initialized;
-
-    if (initialized == false) {
-        init_constants();
-        initialized = true;
-    }
+    const struct arc_opcode_plan *plan =
+        &arc_opcode_plans[opcode - arc_opcodes];
+    enum arc_opcode_map mapping = plan->mapping;
 
-    /* Do the mapping. */
-    mapping = arc_map_opcode(opcode);
     if (mapping != MAP_NONE) {
-        TCGv ops[10];
+        TCGv ops[MAX_SEMFUNC_OPS];
         int i;
-        for (i = 0; i < number_of_ops_semfunc[mapping]; i++) {
-            ops[i] = arc_decode_operand(opcode, ctx, i, mapping);
+        for (i = 0; i < plan->n_ops; i++) {
+            ops[i] = arc_decode_operand(ctx, i, plan);
         }
 
         /*
@@ -1509,7 +1630,7 @@ static int arc_decode(DisasContext *ctx, const struct arc_opcode *opcode)
 #undef SEMANTIC_FUNCTION_CALL_2
 #undef SEMANTIC_FUNCTION_CALL_3
 
-        for (i = 0; i < number_of_ops_semfunc[mapping]; i++) {
+        for (i = 0; i < plan->n_ops; i++) {
             operand_t operand = ctx->insn.operands[i];
             if (!(operand.type & ARC_OPERAND_LIMM) &&
                 !(operand.type & ARC_OPERAND_IR)) {
@@ -1525,6 +1646,57 @@ static int arc_decode(DisasContext *ctx, const struct arc_opcode *opcode)
     return ret;
 }
 
+/*
+ * With the "superblocks" property, translation carries on past a
+ * conditional branch without delay slot.  Its taken path leaves the TB
+ * through setPC(), like any other branch, while the fall through path
+ * stays in it: fewer, longer TBs, which the optimizer and the register
+ * allocator see as a whole.
+ */
+static bool arc_superblock_side_exit(const DisasContext *ctx)
+{
+    if (!ctx->superblock || ctx->insn.d) {
+        return false;
+    }
+
+    switch (ctx->insn.class) {
+    case BRCC:
+    case BBIT0:
+    case BBIT1:
+        return true;
+    case BRANCH:
+    case JUMP:
+        return ctx->insn.cc != ARC_COND_AL && ctx->insn.cc != ARC_COND_RA;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Function returns, J [BLINK] and LEAVE_S, jump through the return stack
+ * of "-accel tcg,return-stack=on", which the calls that set BLINK push
+ * to.  The jump of a return with delay slot is generated after the delay
+ * slot instruction, as long as it is in the same TB.
+ */
+static bool arc_insn_is_return(const DisasContext *ctx,
+                               const struct arc_opcode *opcode)
+{
+    const operand_t *op = &ctx->insn.operands[0];
+
+    switch (arc_opcode_plans[opcode - arc_opcodes].mapping) {
+    case MAP_j_J:
+    case MAP_j_s_J:
+    case MAP_jeq_s_J:
+    case MAP_jne_s_J:
+        return ctx->insn.n_ops > 0 && (op->type & ARC_OPERAND_IR)
+               && op->value == 31;
+    case MAP_leave_s_LEAVE:
+        return true;
+    default:
+        return false;
+    }
+}
+
 void decode_opc(CPUARCState *env, DisasContext *ctx)
 {
     ctx->env = env;
@@ -1541,7 +1713,14 @@ void decode_opc(CPUARCState *env, DisasContext *ctx)
     }
 
 
+    ctx->guest_return = arc_insn_is_return(ctx, opcode);
     ctx->base.is_jmp = arc_decode(ctx, opcode);
+    ctx->side_exit = ctx->base.is_jmp == DISAS_NORETURN
+                     && arc_superblock_side_exit(ctx);
+    if (ctx->guest_return && ctx->insn.d) {
+        ctx->delayed_return = true;
+    }
+    ctx->guest_return = false;
 
     /*
      * Either decoder knows that this is a delayslot
@@ -1555,7 +1734,9 @@ void decode_opc(CPUARCState *env, DisasContext *ctx)
     if(env->in_delayslot_instruction == true
        || GET_STATUS_BIT(env->stat, PREVIOUS_IS_DELAYSLOTf)) {
         TCGv temp_DEf = tcg_temp_local_new();
+        translator_uses_cpu_state(&ctx->base);
         ctx->base.is_jmp = DISAS_NORETURN;
+        ctx->side_exit = false;
 
         TCG_CLR_STATUS_FIELD_BIT(cpu_pstate, PREVIOUS_IS_DELAYSLOTf);
 
@@ -1564,7 +1745,11 @@ void decode_opc(CPUARCState *env, DisasContext *ctx)
         TCG_GET_STATUS_FIELD_MASKED(temp_DEf, cpu_pstate, DEf);
         tcg_gen_brcondi_tl(TCG_COND_EQ, temp_DEf, 0, DEf_not_set_label1);
         TCG_CLR_STATUS_FIELD_BIT(cpu_pstate, DEf);
+        arc_gen_cycles_branch(ctx, true);
+        ctx->guest_return = ctx->delayed_return;
         gen_goto_tb(ctx, 1, cpu_bta);
+        ctx->guest_return = false;
+        ctx->delayed_return = false;
         gen_set_label(DEf_not_set_label1);
 
         tcg_temp_free(temp_DEf);
@@ -1585,22 +1770,24 @@ void decode_opc(CPUARCState *env, DisasContext *ctx)
 #else
     if(1 && env->lpe == ctx->npc) {
 
-        DisasJumpType ret = ctx->base.is_jmp;
-
         TCGLabel *zol_end = gen_new_label();
         TCGLabel *zol_else = gen_new_label();
         TCGv lps = tcg_temp_local_new();
 
+        /* LP_START and LP_END are not part of the TB flags */
+        translator_uses_cpu_state(&ctx->base);
         tcg_gen_brcondi_tl(TCG_COND_GTU, cpu_lpc, 1, zol_else);
           tcg_gen_movi_tl(cpu_lpc, 0);
           tcg_gen_br(zol_end);
         gen_set_label(zol_else);
           tcg_gen_subi_tl(cpu_lpc, cpu_lpc, 1);
           tcg_gen_movi_tl(lps, env->lps);
-          setPC(lps);
+          /* Not setPC(): going round the loop has no branch penalty. */
+          gen_goto_tb(ctx, 1, lps);
         gen_set_label(zol_end);
 
         ctx->base.is_jmp = DISAS_NORETURN;
+        ctx->side_exit = false;
 
         tcg_temp_free(lps);
     }
@@ -1619,12 +1806,18 @@ static void arc_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
 
     dc->cpc = dc->base.pc_next;
     decode_opc(env, dc);
+    arc_cycles_insn(dc);
 
     dc->base.pc_next = dc->npc;
     tcg_gen_movi_tl(cpu_npc, dc->npc);
 
     if (dc->base.is_jmp == DISAS_NORETURN) {
-        gen_gotoi_tb(dc, 0, dc->npc);
+        if (dc->side_exit) {
+            /* Not taken: carry on with the next instruction. */
+            dc->base.is_jmp = DISAS_NEXT;
+        } else {
+            gen_gotoi_tb(dc, 0, dc->npc);
+        }
     }
 
     target_ulong page_start;
@@ -1652,8 +1845,16 @@ static void arc_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
 
     switch (dc->base.is_jmp) {
     case DISAS_TOO_MANY:
+        gen_gotoi_tb(dc, 0, dc->base.pc_next);
+        break;
     case DISAS_UPDATE:
         gen_gotoi_tb(dc, 0, dc->base.pc_next);
+        /*
+         * The TB ended on a state change, such as LP_START/LP_END that
+         * the translator bakes in: tb-prefetch must not translate the
+         * next block from the state of before.
+         */
+        translator_forget_succ(&dc->base, dc->base.pc_next);
         break;
     case DISAS_BRANCH_IN_DELAYSLOT:
     case DISAS_NORETURN:
@@ -1666,6 +1867,8 @@ static void arc_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
         (dc->base.tb->cflags & CF_LAST_IO)) {
         dc->base.is_jmp = DISAS_NORETURN;
     }
+
+    arc_gen_cycles_tb_stop(dc);
 }
 
 static void arc_tr_disas_log(const DisasContextBase *dcbase, CPUState *cpu)
@@ -1701,6 +1904,8 @@ void restore_state_to_opc(CPUARCState *env,
                           target_ulong *data)
 {
     env->pc = data[0];
+    /* The NPC left by the previous instruction, if any, in the TB. */
+    env->npc = data[0];
 }
 
 void arc_cpu_dump_state(CPUState *cs, FILE *f, int flags)
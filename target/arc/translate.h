@@ -69,6 +69,22 @@ typedef struct DisasContext {
     TCGv     tmp_reg;
     TCGLabel *label;
 
+    /* Cycle model, see cycles.c. */
+    bool     cycle_model;
+    TCGOp    *cycles_op;    /* Op to patch with the cost of the TB. */
+    uint32_t cycles;        /* Cost of the TB so far. */
+    int      cycles_dest;   /* Register written by the previous insn. */
+    uint8_t  cycles_stall;  /* Stall when reading it right away. */
+    bool     cycles_pair;   /* The previous insn can pair with this one. */
+
+    /* Superblocks, see arc_superblock_side_exit(). */
+    bool     superblock;
+    bool     side_exit;     /* The insn left the TB on its taken path only. */
+
+    /* Return prediction, see arc_insn_is_return(). */
+    bool     guest_return;  /* gen_goto_tb() is a function return. */
+    bool     delayed_return; /* So is the jump after the delay slot. */
+
 } DisasContext;
 
 
@@ -143,6 +159,12 @@ void decode_opc(CPUARCState *env, DisasContext *ctx);
 void arc_gen_excp(const DisasCtxt *ctx, target_ulong index,
                   target_ulong causecode, target_ulong param);
 
+/* Cycle model, see cycles.c. */
+void arc_gen_cycles_tb_start(DisasContext *ctx);
+void arc_gen_cycles_tb_stop(DisasContext *ctx);
+void arc_cycles_insn(DisasContext *ctx);
+void arc_gen_cycles_branch(const DisasContext *ctx, bool delay_slot);
+
 #endif
 
 
@@ -65,6 +65,8 @@ DEF_HELPER_1(clac, void, env)
 DEF_HELPER_1(stac, void, env)
 DEF_HELPER_3(boundw, void, env, tl, int)
 DEF_HELPER_3(boundl, void, env, tl, int)
+DEF_HELPER_5(rep_movs, void, env, tl, tl, i32, i32)
+DEF_HELPER_4(rep_stos, void, env, tl, i32, i32)
 
 #ifndef CONFIG_USER_ONLY
 DEF_HELPER_1(rsm, void, env)
@@ -181,3 +181,93 @@ void helper_boundl(CPUX86State *env, target_ulong a0, int v)
         raise_exception_ra(env, EXCP05_BOUND, GETPC());
     }
 }
+
+/*
+ * REP MOVS and REP STOS: copy or fill the elements that stay within one
+ * page of each operand, and within the wrap around of its address
+ * register, in one go, then advance ESI, EDI and ECX past them.  Whatever
+ * is left, including an element that crosses a page and everything with
+ * a backward direction flag, is done one element at a time by the
+ * translated code.
+ */
+static target_ulong rep_addr_mask(int aflag)
+{
+    switch (aflag) {
+    case MO_16:
+        return 0xffff;
+    case MO_32:
+        return 0xffffffff;
+    default:
+        return -1;
+    }
+}
+
+static void rep_set_reg(CPUX86State *env, int reg, target_ulong val,
+                        int aflag)
+{
+    switch (aflag) {
+    case MO_16:
+        env->regs[reg] = (env->regs[reg] & ~0xffff) | (val & 0xffff);
+        break;
+    case MO_32:
+        env->regs[reg] = (uint32_t)val;
+        break;
+    default:
+        env->regs[reg] = val;
+        break;
+    }
+}
+
+/* The bytes from the linear address @addr of register @reg on. */
+static target_ulong rep_bytes_left(target_ulong addr, target_ulong reg,
+                                   target_ulong mask)
+{
+    target_ulong n = -(addr | TARGET_PAGE_MASK);
+    target_ulong wrap = -reg & mask;
+
+    return wrap && wrap < n ? wrap : n;
+}
+
+void helper_rep_movs(CPUX86State *env, target_ulong src, target_ulong dst,
+                     uint32_t ot, uint32_t aflag)
+{
+    target_ulong mask = rep_addr_mask(aflag);
+    target_ulong n;
+
+    if (env->df < 0) {
+        return;
+    }
+    n = MIN(rep_bytes_left(src, env->regs[R_ESI], mask),
+            rep_bytes_left(dst, env->regs[R_EDI], mask)) >> ot;
+    n = MIN(n, env->regs[R_ECX] & mask);
+    if (n == 0) {
+        return;
+    }
+
+    guest_memcpy(env, dst, src, n << ot, ot, cpu_mmu_index(env, false),
+                 GETPC());
+    rep_set_reg(env, R_ESI, env->regs[R_ESI] + (n << ot), aflag);
+    rep_set_reg(env, R_EDI, env->regs[R_EDI] + (n << ot), aflag);
+    rep_set_reg(env, R_ECX, env->regs[R_ECX] - n, aflag);
+}
+
+void helper_rep_stos(CPUX86State *env, target_ulong dst, uint32_t ot,
+                     uint32_t aflag)
+{
+    target_ulong mask = rep_addr_mask(aflag);
+    target_ulong n;
+
+    if (env->df < 0) {
+        return;
+    }
+    n = rep_bytes_left(dst, env->regs[R_EDI], mask) >> ot;
+    n = MIN(n, env->regs[R_ECX] & mask);
+    if (n == 0) {
+        return;
+    }
+
+    guest_memset(env, dst, env->regs[R_EAX], n << ot, ot,
+                 cpu_mmu_index(env, false), GETPC());
+    rep_set_reg(env, R_EDI, env->regs[R_EDI] + (n << ot), aflag);
+    rep_set_reg(env, R_ECX, env->regs[R_ECX] - n, aflag);
+}
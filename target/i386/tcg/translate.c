@@ -1268,8 +1268,67 @@ static inline void gen_repz_ ## op(DisasContext *s, MemOp ot,              \
     gen_jmp(s, cur_eip);                                                      \
 }
 
-GEN_REPZ(movs)
-GEN_REPZ(stos)
+/*
+ * REP MOVS and REP STOS first let a helper copy or fill all the elements
+ * that stay within one page of each operand, and then do one element in
+ * the usual way, which covers an element that crosses a page as well as
+ * a backward direction flag, that the helpers leave alone.  This is not
+ * done for single stepping or icount, which see every iteration.
+ */
+static bool gen_repz_bulk_ok(DisasContext *s)
+{
+    return s->jmp_opt && !(tb_cflags(s->base.tb) & CF_USE_ICOUNT);
+}
+
+static void gen_repz_movs(DisasContext *s, MemOp ot,
+                          target_ulong cur_eip, target_ulong next_eip)
+{
+    TCGLabel *l2;
+
+    gen_update_cc_op(s);
+    l2 = gen_jz_ecx_string(s, next_eip);
+    if (gen_repz_bulk_ok(s)) {
+        TCGv src = tcg_temp_new();
+
+        gen_string_movl_A0_ESI(s);
+        tcg_gen_mov_tl(src, s->A0);
+        gen_string_movl_A0_EDI(s);
+        gen_helper_rep_movs(cpu_env, src, s->A0, tcg_constant_i32(ot),
+                            tcg_constant_i32(s->aflag));
+        tcg_temp_free(src);
+        gen_op_jz_ecx(s, s->aflag, l2);
+    }
+    gen_movs(s, ot);
+    gen_op_add_reg_im(s, s->aflag, R_ECX, -1);
+    /* a loop would cause two single step exceptions if ECX = 1
+       before rep string_insn */
+    if (s->repz_opt) {
+        gen_op_jz_ecx(s, s->aflag, l2);
+    }
+    gen_jmp(s, cur_eip);
+}
+
+static void gen_repz_stos(DisasContext *s, MemOp ot,
+                          target_ulong cur_eip, target_ulong next_eip)
+{
+    TCGLabel *l2;
+
+    gen_update_cc_op(s);
+    l2 = gen_jz_ecx_string(s, next_eip);
+    if (gen_repz_bulk_ok(s)) {
+        gen_string_movl_A0_EDI(s);
+        gen_helper_rep_stos(cpu_env, s->A0, tcg_constant_i32(ot),
+                            tcg_constant_i32(s->aflag));
+        gen_op_jz_ecx(s, s->aflag, l2);
+    }
+    gen_stos(s, ot);
+    gen_op_add_reg_im(s, s->aflag, R_ECX, -1);
+    if (s->repz_opt) {
+        gen_op_jz_ecx(s, s->aflag, l2);
+    }
+    gen_jmp(s, cur_eip);
+}
+
 GEN_REPZ(lods)
 GEN_REPZ(ins)
 GEN_REPZ(outs)
@@ -1210,6 +1210,8 @@ void riscv_translate_init(void)
     }
 
     cpu_pc = tcg_global_mem_new(cpu_env, offsetof(CPURISCVState, pc), "pc");
+    /* restore_state_to_opc() recomputes it. */
+    tcg_global_set_restorable(cpu_pc);
     cpu_vl = tcg_global_mem_new(cpu_env, offsetof(CPURISCVState, vl), "vl");
     cpu_vstart = tcg_global_mem_new(cpu_env, offsetof(CPURISCVState, vstart),
                             "vstart");
@@ -1068,7 +1068,7 @@ static inline uint32_t do_mvcl(CPUS390XState *env,
 {
     const int mmu_idx = cpu_mmu_index(env, false);
     int len = MIN(*destlen, -(*dest | TARGET_PAGE_MASK));
-    S390Access srca, desta;
+    S390Access desta;
     int i, cc;
 
     if (*destlen == *srclen) {
@@ -1092,16 +1092,13 @@ static inline uint32_t do_mvcl(CPUS390XState *env,
         len = MIN(MIN(*srclen, -(*src | TARGET_PAGE_MASK)), len);
         *destlen -= len;
         *srclen -= len;
-        srca = access_prepare(env, *src, len, MMU_DATA_LOAD, mmu_idx, ra);
-        desta = access_prepare(env, *dest, len, MMU_DATA_STORE, mmu_idx, ra);
-        access_memmove(env, &desta, &srca, ra);
+        guest_memmove(env, *dest, *src, len, MO_8, mmu_idx, ra);
         *src = wrap_address(env, *src + len);
         *dest = wrap_address(env, *dest + len);
     } else if (wordsize == 1) {
         /* Pad the remaining area */
         *destlen -= len;
-        desta = access_prepare(env, *dest, len, MMU_DATA_STORE, mmu_idx, ra);
-        access_memset(env, &desta, pad, ra);
+        guest_memset(env, *dest, pad, len, MO_8, mmu_idx, ra);
         *dest = wrap_address(env, *dest + len);
     } else {
         desta = access_prepare(env, *dest, len, MMU_DATA_STORE, mmu_idx, ra);
@@ -1131,7 +1128,6 @@ uint32_t HELPER(mvcl)(CPUS390XState *env, uint32_t r1, uint32_t r2)
     uint64_t src = get_address(env, r2);
     uint8_t pad = env->regs[r2 + 1] >> 24;
     CPUState *cs = env_cpu(env);
-    S390Access srca, desta;
     uint32_t cc, cur_len;
 
     if (is_destructive_overlap(env, dest, src, MIN(srclen, destlen))) {
@@ -1160,17 +1156,11 @@ uint32_t HELPER(mvcl)(CPUS390XState *env, uint32_t r1, uint32_t r2)
     while (destlen) {
         cur_len = MIN(destlen, -(dest | TARGET_PAGE_MASK));
         if (!srclen) {
-            desta = access_prepare(env, dest, cur_len, MMU_DATA_STORE, mmu_idx,
-                                   ra);
-            access_memset(env, &desta, pad, ra);
+            guest_memset(env, dest, pad, cur_len, MO_8, mmu_idx, ra);
         } else {
             cur_len = MIN(MIN(srclen, -(src | TARGET_PAGE_MASK)), cur_len);
 
-            srca = access_prepare(env, src, cur_len, MMU_DATA_LOAD, mmu_idx,
-                                  ra);
-            desta = access_prepare(env, dest, cur_len, MMU_DATA_STORE, mmu_idx,
-                                   ra);
-            access_memmove(env, &desta, &srca, ra);
+            guest_memmove(env, dest, src, cur_len, MO_8, mmu_idx, ra);
             src = wrap_address(env, src + cur_len);
             srclen -= cur_len;
             env->regs[r2 + 1] = deposit64(env->regs[r2 + 1], 0, 24, srclen);
@@ -693,8 +693,22 @@ static void finish_folding(OptContext *ctx, TCGOp *op)
 
     /*
      * For an opcode that ends a BB, reset all temp data.
-     * We do no cross-BB optimization.
+     * We do no cross-BB optimization, but for the fall-through path of a
+     * conditional branch: it starts with the values the globals and the
+     * local temps had before the branch, only the normal temps die.
      */
+    if (def->flags & TCG_OPF_COND_BRANCH) {
+        TCGContext *s = ctx->tcg;
+
+        for (i = s->nb_globals; i < s->nb_temps; i++) {
+            if (test_bit(i, ctx->temps_used.l) &&
+                s->temps[i].kind == TEMP_NORMAL) {
+                reset_ts(&s->temps[i]);
+            }
+        }
+        ctx->prev_mb = NULL;
+        return;
+    }
     if (def->flags & TCG_OPF_BB_END) {
         memset(&ctx->temps_used, 0, sizeof(ctx->temps_used));
         ctx->prev_mb = NULL;
@@ -2022,6 +2036,118 @@ static bool fold_xor(OptContext *ctx, TCGOp *op)
     return fold_masks(ctx, op);
 }
 
+/*
+ * A store to env is dead when a later store of the same basic block
+ * overwrites it and nothing in between may read it.  Walk backward,
+ * keeping the ranges of env that are about to be overwritten: helpers,
+ * guest memory accesses, which may raise an exception, and the end of
+ * the block may read any of env, and so may a host load through any
+ * pointer but env itself.
+ */
+#define DEAD_ENV_RANGES 16
+
+typedef struct EnvRange {
+    intptr_t start;
+    intptr_t end;
+} EnvRange;
+
+static void remove_dead_env_stores(TCGContext *s)
+{
+    TCGTemp *env = tcgv_ptr_temp(cpu_env);
+    EnvRange dead[DEAD_ENV_RANGES];
+    int nb_dead = 0;
+    TCGOp *op, *op_prev;
+
+    QTAILQ_FOREACH_REVERSE_SAFE(op, &s->ops, link, op_prev) {
+        intptr_t start, end;
+        int i, size;
+
+        switch (op->opc) {
+        CASE_OP_32_64(st8):
+            size = 1;
+            goto do_store;
+        CASE_OP_32_64(st16):
+            size = 2;
+            goto do_store;
+        case INDEX_op_st_i32:
+        case INDEX_op_st32_i64:
+            size = 4;
+            goto do_store;
+        case INDEX_op_st_i64:
+            size = 8;
+        do_store:
+            if (arg_temp(op->args[1]) != env) {
+                break;
+            }
+            start = op->args[2];
+            end = start + size;
+            for (i = 0; i < nb_dead; i++) {
+                if (dead[i].start <= start && end <= dead[i].end) {
+                    break;
+                }
+            }
+            if (i < nb_dead) {
+                tcg_op_remove(s, op);
+            } else if (nb_dead < DEAD_ENV_RANGES) {
+                dead[nb_dead].start = start;
+                dead[nb_dead].end = end;
+                nb_dead++;
+            }
+            break;
+
+        CASE_OP_32_64(ld8u):
+        CASE_OP_32_64(ld8s):
+            size = 1;
+            goto do_load;
+        CASE_OP_32_64(ld16u):
+        CASE_OP_32_64(ld16s):
+            size = 2;
+            goto do_load;
+        case INDEX_op_ld_i32:
+        case INDEX_op_ld32u_i64:
+        case INDEX_op_ld32s_i64:
+            size = 4;
+            goto do_load;
+        case INDEX_op_ld_i64:
+            size = 8;
+        do_load:
+            if (arg_temp(op->args[1]) != env) {
+                nb_dead = 0;
+                break;
+            }
+            start = op->args[2];
+            end = start + size;
+            for (i = 0; i < nb_dead; ) {
+                if (dead[i].start < end && start < dead[i].end) {
+                    dead[i] = dead[--nb_dead];
+                } else {
+                    i++;
+                }
+            }
+            break;
+
+        case INDEX_op_discard:
+        case INDEX_op_insn_start:
+        case INDEX_op_st_vec:
+            break;
+
+        case INDEX_op_mb:
+        case INDEX_op_ld_vec:
+        case INDEX_op_dupm_vec:
+            nb_dead = 0;
+            break;
+
+        default:
+            if (tcg_op_defs[op->opc].flags & (TCG_OPF_BB_END |
+                                               TCG_OPF_SIDE_EFFECTS |
+                                               TCG_OPF_NOT_PRESENT)) {
+                nb_dead = 0;
+            }
+            break;
+        }
+    }
+}
+
 /* Propagate constants and copies, fold constant expressions. */
 void tcg_optimize(TCGContext *s)
 {
@@ -2237,4 +2363,6 @@ void tcg_optimize(TCGContext *s)
             finish_folding(&ctx, op);
         }
     }
+
+    remove_dead_env_stores(s);
 }
@@ -40,11 +40,30 @@ struct tcg_region_tree {
     /* padding to avoid false sharing is computed at run-time */
 };
 
+enum {
+    TCG_REGION_FREE,
+    TCG_REGION_USED,        /* being filled by a TCG context */
+    TCG_REGION_FULL,
+    TCG_REGION_RETIRING,    /* TBs invalidated, still maybe in use */
+};
+
+struct tcg_region_info {
+    int state;
+    size_t size_full;       /* contribution to agg_size_full */
+    uint64_t fill_seq;      /* order in which regions filled up */
+};
+
 /*
  * We divide code_gen_buffer into equally-sized "regions" that TCG threads
  * dynamically allocate from as demand dictates. Given appropriate region
  * sizing, this minimizes flushes even when some TCG threads generate a lot
  * more code than others.
+ *
+ * With eviction enabled, full regions are not only reclaimed all at once by
+ * tb_flush: one of them at a time can be retired, its TBs invalidated, and
+ * then handed back here once no vCPU can be executing its code any more.
+ * See tcg_region_evict_begin().  A tb_flush that does not stop the vCPUs
+ * retires all full regions that way, see tcg_region_retire_all().
  */
 struct tcg_region_state {
     QemuMutex lock;
@@ -56,10 +75,16 @@ struct tcg_region_state {
     size_t size; /* size of one region */
     size_t stride; /* .size + guard size */
     size_t total_size; /* size of entire buffer, >= n * stride */
+    bool evict; /* full regions may be evicted one at a time */
 
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    struct tcg_region_info *info;
+    size_t n_free; /* free regions, some maybe below current */
+    uint64_t fill_seq; /* source of tcg_region_info.fill_seq */
+    size_t n_retiring; /* regions RETIRING */
+    unsigned int reset_count; /* bumped by tcg_region_reset_all */
 };
 
 static struct tcg_region_state region;
@@ -167,10 +192,12 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+/*
+ * Return the index of the region containing @p, which may point to either
+ * the rw or the rx view of the buffer, or -1 if it is not in the buffer.
+ */
+ssize_t tcg_region_index(const void *p)
 {
-    size_t region_idx;
-
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
      * a signal handler over which the caller has no control.
@@ -178,20 +205,33 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
     if (!in_code_gen_buffer(p)) {
         p -= tcg_splitwx_diff;
         if (!in_code_gen_buffer(p)) {
-            return NULL;
+            return -1;
         }
     }
 
     if (p < region.start_aligned) {
-        region_idx = 0;
+        return 0;
     } else {
         ptrdiff_t offset = p - region.start_aligned;
 
         if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
+            return region.n - 1;
         }
+        return offset / region.stride;
+    }
+}
+
+size_t tcg_region_count(void)
+{
+    return region.n;
+}
+
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
+    ssize_t region_idx = tcg_region_index(p);
+
+    if (region_idx < 0) {
+        return NULL;
     }
     return region_trees + region_idx * tree_size;
 }
@@ -287,6 +327,16 @@ size_t tcg_nb_tbs(void)
     return nb_tbs;
 }
 
+/* Call @func on each TB of region @idx, as g_tree_foreach() would. */
+void tcg_region_tb_foreach(size_t idx, GTraverseFunc func, gpointer user_data)
+{
+    struct tcg_region_tree *rt = region_trees + idx * tree_size;
+
+    qemu_mutex_lock(&rt->lock);
+    g_tree_foreach(rt->tree, func, user_data);
+    qemu_mutex_unlock(&rt->lock);
+}
+
 static void tcg_region_tree_reset_all(void)
 {
     size_t i;
@@ -335,11 +385,24 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
-        return true;
+    size_t i = region.current;
+
+    if (i < region.n) {
+        region.current++;
+    } else {
+        /* Past the first pass, only regions given back by eviction remain */
+        for (i = 0; i < region.n; i++) {
+            if (region.info[i].state == TCG_REGION_FREE) {
+                break;
+            }
+        }
+        if (i == region.n) {
+            return true;
+        }
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
+    region.info[i].state = TCG_REGION_USED;
+    region.n_free--;
+    tcg_region_assign(s, i);
     return false;
 }
 
@@ -351,12 +414,16 @@ bool tcg_region_alloc(TCGContext *s)
 {
     bool err;
     /* read the region size now; alloc__locked will overwrite it on success */
-    size_t size_full = s->code_gen_buffer_size;
+    size_t size_full = s->code_gen_buffer_size - TCG_HIGHWATER;
+    size_t full = tcg_region_index(s->code_gen_buffer);
 
     qemu_mutex_lock(&region.lock);
     err = tcg_region_alloc__locked(s);
     if (!err) {
-        region.agg_size_full += size_full - TCG_HIGHWATER;
+        region.agg_size_full += size_full;
+        region.info[full].state = TCG_REGION_FULL;
+        region.info[full].size_full = size_full;
+        region.info[full].fill_seq = region.fill_seq++;
     }
     qemu_mutex_unlock(&region.lock);
     return err;
@@ -388,6 +455,13 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    for (i = 0; i < region.n; i++) {
+        region.info[i].state = TCG_REGION_FREE;
+    }
+    region.n_free = region.n;
+    /* Evictions in flight are void: see tcg_region_evict_end() */
+    qatomic_set(&region.n_retiring, 0);
+    region.reset_count++;
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -398,12 +472,149 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
-static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
+/*
+ * Should a region be evicted ahead of need?  Checked without the lock
+ * before each translation, so the answer may be slightly stale.
+ */
+bool tcg_region_evict_wanted(void)
+{
+    return region.evict && !qatomic_read(&region.n_retiring)
+           && qatomic_read(&region.n_free) <= region.n / 8;
+}
+
+/* Is an eviction in flight, i.e. is a region about to become free? */
+bool tcg_region_evict_pending(void)
+{
+    return qatomic_read(&region.n_retiring);
+}
+
+bool tcg_region_evict_enabled(void)
+{
+    return region.evict;
+}
+
+/*
+ * Pick a full region to evict and mark it as retiring.  The least recently
+ * filled region that is not set in the @hot bitmap is chosen, or failing
+ * that the least recently filled one.  Returns the index of the region,
+ * or -1 if there is none or some region is still retiring.
+ *
+ * The caller must then invalidate all TBs of the region and make sure that
+ * no vCPU still uses them, before returning the region with
+ * tcg_region_evict_end(@idx, *@token).
+ */
+ssize_t tcg_region_evict_begin(const unsigned long *hot, unsigned int *token)
+{
+    ssize_t victim = -1, cold = -1;
+    size_t i;
+
+    if (!region.evict) {
+        return -1;
+    }
+
+    qemu_mutex_lock(&region.lock);
+    if (region.n_retiring) {
+        goto out;
+    }
+    for (i = 0; i < region.n; i++) {
+        const struct tcg_region_info *r = &region.info[i];
+
+        if (r->state != TCG_REGION_FULL) {
+            continue;
+        }
+        if (victim < 0 || r->fill_seq < region.info[victim].fill_seq) {
+            victim = i;
+        }
+        if (!test_bit(i, hot)
+            && (cold < 0 || r->fill_seq < region.info[cold].fill_seq)) {
+            cold = i;
+        }
+    }
+    if (cold >= 0) {
+        victim = cold;
+    }
+    if (victim >= 0) {
+        region.info[victim].state = TCG_REGION_RETIRING;
+        qatomic_set(&region.n_retiring, 1);
+        *token = region.reset_count;
+    }
+ out:
+    qemu_mutex_unlock(&region.lock);
+    return victim;
+}
+
+/*
+ * Retire all full regions at once, for a tb_flush that does not stop the
+ * vCPUs.  Sets in @retired the regions retired, each of which must then be
+ * handed back with tcg_region_evict_end().
+ */
+void tcg_region_retire_all(unsigned long *retired, unsigned int *token)
+{
+    size_t i, n = 0;
+
+    qemu_mutex_lock(&region.lock);
+    for (i = 0; i < region.n; i++) {
+        if (region.info[i].state == TCG_REGION_FULL) {
+            region.info[i].state = TCG_REGION_RETIRING;
+            set_bit(i, retired);
+            n++;
+        }
+    }
+    qatomic_set(&region.n_retiring, region.n_retiring + n);
+    *token = region.reset_count;
+    qemu_mutex_unlock(&region.lock);
+}
+
+/*
+ * Hand region @idx back for allocation.  Nothing is done if the whole
+ * buffer was reset in the meantime, the region then being free already.
+ */
+void tcg_region_evict_end(size_t idx, unsigned int token)
+{
+    struct tcg_region_tree *rt = region_trees + idx * tree_size;
+
+    qemu_mutex_lock(&region.lock);
+    if (token == region.reset_count) {
+        g_assert(region.info[idx].state == TCG_REGION_RETIRING);
+
+        qemu_mutex_lock(&rt->lock);
+        /* Increment the refcount first so that destroy acts as a reset */
+        g_tree_ref(rt->tree);
+        g_tree_destroy(rt->tree);
+        qemu_mutex_unlock(&rt->lock);
+
+        region.info[idx].state = TCG_REGION_FREE;
+        region.agg_size_full -= region.info[idx].size_full;
+        region.n_free++;
+        qatomic_set(&region.n_retiring, region.n_retiring - 1);
+    }
+    qemu_mutex_unlock(&region.lock);
+}
+
+/*
+ * Number of regions to aim for when full regions are evicted one at a time,
+ * rather than all flushed together: the smaller they are, the less code is
+ * thrown away per eviction.
+ */
+#define TCG_REGION_EVICT_N  32
+
+static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus,
+                            unsigned n_workers, bool evict)
 {
 #ifdef CONFIG_USER_ONLY
     return 1;
 #else
     size_t n_regions;
+    unsigned n_threads;
+
+    /*
+     * Eviction needs regions to spare beyond the ones being filled, even
+     * with a single vCPU thread.  Keep them at least 2 pages large.
+     */
+    if (evict) {
+        n_regions = MAX(TCG_REGION_EVICT_N, (max_cpus + n_workers) * 2);
+        return MIN(n_regions, tb_size / (2 * qemu_real_host_page_size));
+    }
 
     /*
      * It is likely that some vCPUs will translate more code than others,
@@ -411,20 +622,22 @@ static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
      * being of reasonable size. If that's not possible we make do by evenly
      * dividing the code_gen_buffer among the vCPUs.
      */
-    /* Use a single region if all we have is one vCPU thread */
-    if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
+    n_threads = (qemu_tcg_mttcg_enabled() ? max_cpus : 1) + n_workers;
+
+    /* Use a single region if all we have is one TCG thread */
+    if (n_threads == 1) {
         return 1;
     }
 
     /*
-     * Try to have more regions than max_cpus, with each region being >= 2 MB.
-     * If we can't, then just allocate one region per vCPU thread.
+     * Try to have more regions than TCG threads, with each region being
+     * >= 2 MB.  If we can't, then just allocate one region per thread.
      */
     n_regions = tb_size / (2 * MiB);
-    if (n_regions <= max_cpus) {
-        return max_cpus;
+    if (n_regions <= n_threads) {
+        return n_threads;
     }
-    return MIN(n_regions, max_cpus * 8);
+    return MIN(n_regions, n_threads * 8);
 #endif
 }
 
@@ -709,8 +922,11 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
  * and then assigning regions to TCG threads so that the threads can translate
  * code in parallel without synchronization.
  *
- * In softmmu the number of TCG threads is bounded by max_cpus, so we use at
- * least max_cpus regions in MTTCG. In !MTTCG we use a single region.
+ * In softmmu the number of TCG threads is bounded by max_cpus, plus the
+ * @n_workers translating ahead of the vCPUs, so we use at least that many
+ * regions. In !MTTCG without workers we use a single region, unless
+ * @evict asks for full regions to be recycled one at a time rather than by
+ * flushing the whole buffer.
  * Note that the TCG options from the command-line (i.e. -accel accel=tcg,[...])
  * must have been parsed before calling this function, since it calls
  * qemu_tcg_mttcg_enabled().
@@ -727,7 +943,8 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
  * in practice. Multi-threaded guests share most if not all of their translated
  * code, which makes parallel code generation less appealing than in softmmu.
  */
-void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
+void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus,
+                     unsigned n_workers, bool evict)
 {
     const size_t page_size = qemu_real_host_page_size;
     size_t region_size;
@@ -765,7 +982,7 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
      * As a result of this we might end up with a few extra pages at the end of
      * the buffer; we will assign those to the last region.
      */
-    region.n = tcg_n_regions(tb_size, max_cpus);
+    region.n = tcg_n_regions(tb_size, max_cpus, n_workers, evict);
     region_size = tb_size / region.n;
     region_size = QEMU_ALIGN_DOWN(region_size, page_size);
 
@@ -786,6 +1003,10 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
 
     /* init the region struct */
     qemu_mutex_init(&region.lock);
+    region.info = g_new0(struct tcg_region_info, region.n);
+    region.n_free = region.n;
+    /* With a single region, there would never be one to spare */
+    region.evict = evict && region.n > 1;
 
     /*
      * Set guard pages in the rw buffer, as that's the one into which
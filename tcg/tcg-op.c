@@ -2761,6 +2761,33 @@ void tcg_gen_lookup_and_goto_ptr(void)
     tcg_temp_free_ptr(ptr);
 }
 
+void tcg_gen_lookup_and_goto_ptr_ret(void)
+{
+    TCGv_ptr ptr;
+
+    if (!tcg_ctx->return_stack) {
+        tcg_gen_lookup_and_goto_ptr();
+        return;
+    }
+    if (tcg_ctx->tb_cflags & CF_NO_GOTO_PTR) {
+        tcg_gen_exit_tb(NULL, 0);
+        return;
+    }
+
+    plugin_gen_disable_mem_helpers();
+    ptr = tcg_temp_new_ptr();
+    gen_helper_lookup_tb_ptr_ret(ptr, cpu_env);
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(ptr));
+    tcg_temp_free_ptr(ptr);
+}
+
+void tcg_gen_push_return(TCGv addr)
+{
+    if (tcg_ctx->return_stack) {
+        gen_helper_push_return(cpu_env, addr);
+    }
+}
+
 static inline MemOp tcg_canonicalize_memop(MemOp op, bool is64, bool st)
 {
     /* Trigger the asserts within as early as possible.  */
@@ -568,7 +568,7 @@ static void process_op_defs(TCGContext *s);
 static TCGTemp *tcg_global_reg_new_internal(TCGContext *s, TCGType type,
                                             TCGReg reg, const char *name);
 
-static void tcg_context_init(unsigned max_cpus)
+static void tcg_context_init(unsigned max_threads)
 {
     TCGContext *s = &tcg_init_ctx;
     int op, total_args, n, i;
@@ -672,15 +672,15 @@ static void tcg_context_init(unsigned max_cpus)
      * In user-mode we simply share the init context among threads, since we
      * use a single region. See the documentation tcg_region_init() for the
      * reasoning behind this.
-     * In softmmu we will have at most max_cpus TCG threads.
+     * In softmmu we will have at most max_threads TCG threads.
      */
 #ifdef CONFIG_USER_ONLY
     tcg_ctxs = &tcg_ctx;
     tcg_cur_ctxs = 1;
     tcg_max_ctxs = 1;
 #else
-    tcg_max_ctxs = max_cpus;
-    tcg_ctxs = g_new0(TCGContext *, max_cpus);
+    tcg_max_ctxs = max_threads;
+    tcg_ctxs = g_new0(TCGContext *, max_threads);
 #endif
 
     tcg_debug_assert(!tcg_regset_test_reg(s->reserved_regs, TCG_AREG0));
@@ -688,10 +688,15 @@ static void tcg_context_init(unsigned max_cpus)
     cpu_env = temp_tcgv_ptr(ts);
 }
 
-void tcg_init(size_t tb_size, int splitwx, unsigned max_cpus)
+/*
+ * @n_workers is the number of threads that translate besides the vCPU
+ * threads, see tb-prefetch.c.
+ */
+void tcg_init(size_t tb_size, int splitwx, unsigned max_cpus,
+              unsigned n_workers, bool evict)
 {
-    tcg_context_init(max_cpus);
-    tcg_region_init(tb_size, splitwx, max_cpus);
+    tcg_context_init(max_cpus + n_workers);
+    tcg_region_init(tb_size, splitwx, max_cpus, n_workers, evict);
 }
 
 /*
@@ -823,6 +828,7 @@ void tcg_func_start(TCGContext *s)
     QTAILQ_INIT(&s->ops);
     QTAILQ_INIT(&s->free_ops);
     QSIMPLEQ_INIT(&s->labels);
+    s->emit_before_op = NULL;
 }
 
 static TCGTemp *tcg_temp_alloc(TCGContext *s)
@@ -938,6 +944,18 @@ TCGTemp *tcg_global_mem_new_internal(TCGType type, TCGv_ptr base,
     return ts;
 }
 
+void tcg_global_set_restorable_internal(TCGTemp *ts)
+{
+    /* liveness_pass_2 keeps its own view of indirect globals. */
+    tcg_debug_assert(ts->kind == TEMP_GLOBAL && !ts->indirect_reg);
+
+    ts->restorable = 1;
+    if (ts->base_type != ts->type) {
+        /* The high half of a 64-bit global on a 32-bit host. */
+        ts[1].restorable = 1;
+    }
+}
+
 TCGTemp *tcg_temp_new_internal(TCGType type, bool temp_local)
 {
     TCGContext *s = tcg_ctx;
@@ -1686,6 +1704,16 @@ static void tcg_reg_alloc_start(TCGContext *s)
     }
 
     memset(s->reg_to_temp, 0, sizeof(s->reg_to_temp));
+
+    if (s->ebb_regalloc) {
+        TCGLabel *l;
+
+        QSIMPLEQ_FOREACH(l, &s->labels, next) {
+            l->ebb_regs = NULL;
+            l->ebb_refs = 0;
+        }
+        s->ebb_unreachable = false;
+    }
 }
 
 static char *tcg_get_arg_str_ptr(TCGContext *s, char *buf, int buf_size,
@@ -2168,26 +2196,28 @@ static void process_op_defs(TCGContext *s)
     }
 }
 
-void tcg_op_remove(TCGContext *s, TCGOp *op)
+/* The label a branch op refers to, NULL for any other op.  */
+static TCGLabel *tcg_op_label(const TCGOp *op)
 {
-    TCGLabel *label;
-
     switch (op->opc) {
     case INDEX_op_br:
-        label = arg_label(op->args[0]);
-        label->refs--;
-        break;
+        return arg_label(op->args[0]);
     case INDEX_op_brcond_i32:
     case INDEX_op_brcond_i64:
-        label = arg_label(op->args[3]);
-        label->refs--;
-        break;
+        return arg_label(op->args[3]);
     case INDEX_op_brcond2_i32:
-        label = arg_label(op->args[5]);
-        label->refs--;
-        break;
+        return arg_label(op->args[5]);
     default:
-        break;
+        return NULL;
+    }
+}
+
+void tcg_op_remove(TCGContext *s, TCGOp *op)
+{
+    TCGLabel *label = tcg_op_label(op);
+
+    if (label) {
+        label->refs--;
     }
 
     QTAILQ_REMOVE(&s->ops, op, link);
@@ -2233,7 +2263,12 @@ static TCGOp *tcg_op_alloc(TCGOpcode opc)
 TCGOp *tcg_emit_op(TCGOpcode opc)
 {
     TCGOp *op = tcg_op_alloc(opc);
-    QTAILQ_INSERT_TAIL(&tcg_ctx->ops, op, link);
+
+    if (tcg_ctx->emit_before_op) {
+        QTAILQ_INSERT_BEFORE(tcg_ctx->emit_before_op, op, link);
+    } else {
+        QTAILQ_INSERT_TAIL(&tcg_ctx->ops, op, link);
+    }
     return op;
 }
 
@@ -2404,6 +2439,27 @@ static void la_global_sync(TCGContext *s, int ng)
     }
 }
 
+/*
+ * liveness analysis: sync globals back to memory before an op that may
+ * raise an exception, but for those restore_state_to_opc() recomputes.
+ */
+static void la_global_sync_exc(TCGContext *s, int ng)
+{
+    int i;
+
+    for (i = 0; i < ng; ++i) {
+        int state = s->temps[i].state;
+
+        if (s->temps[i].restorable) {
+            continue;
+        }
+        s->temps[i].state = state | TS_MEM;
+        if (state == TS_DEAD) {
+            la_reset_pref(&s->temps[i]);
+        }
+    }
+}
+
 /*
  * liveness analysis: conditional branch: all temps are dead,
  * globals and local temps should be synced.
@@ -2436,6 +2492,71 @@ static void la_bb_sync(TCGContext *s, int ng, int nt)
     }
 }
 
+/*
+ * liveness analysis: label, when extended basic blocks are enabled.
+ * Temps are dead and local temps in memory as at any end of basic block,
+ * but globals are only synced, so that the branches to the label may
+ * keep them in registers.  Their state is recorded for la_branch().
+ * Indirect globals are always reloaded, liveness_pass_2 relies on it.
+ */
+static void la_label(TCGContext *s, TCGLabel *l, int ng, int nt)
+{
+    int i;
+
+    la_global_sync(s, ng);
+
+    l->la_globals = tcg_malloc(ng);
+    for (i = 0; i < ng; ++i) {
+        TCGTemp *ts = &s->temps[i];
+
+        if (ts->indirect_reg) {
+            ts->state = TS_DEAD | TS_MEM;
+            la_reset_pref(ts);
+        }
+        l->la_globals[i] = ts->state;
+    }
+
+    for (i = ng; i < nt; ++i) {
+        TCGTemp *ts = &s->temps[i];
+
+        switch (ts->kind) {
+        case TEMP_LOCAL:
+            ts->state = TS_DEAD | TS_MEM;
+            break;
+        case TEMP_NORMAL:
+        case TEMP_CONST:
+            ts->state = TS_DEAD;
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        la_reset_pref(ts);
+    }
+}
+
+/*
+ * liveness analysis: branch to a label, when extended basic blocks are
+ * enabled.  The globals live at the label are live at the branch too.
+ * A label not seen yet is the target of a backward branch, and gets
+ * all of the globals from memory.
+ */
+static void la_branch(TCGContext *s, TCGLabel *l, int ng)
+{
+    int i;
+
+    if (!l->la_globals) {
+        return;
+    }
+    for (i = 0; i < ng; ++i) {
+        TCGTemp *ts = &s->temps[i];
+
+        if ((ts->state & TS_DEAD) && !(l->la_globals[i] & TS_DEAD)) {
+            ts->state &= ~TS_DEAD;
+            la_reset_pref(ts);
+        }
+    }
+}
+
 /* liveness analysis: sync globals back to memory and kill.  */
 static void la_global_kill(TCGContext *s, int ng)
 {
@@ -2485,6 +2606,15 @@ static void liveness_pass_1(TCGContext *s)
         s->temps[i].state_ptr = prefs + i;
     }
 
+    if (s->ebb_regalloc) {
+        TCGLabel *l;
+
+        /* This pass may run twice.  */
+        QSIMPLEQ_FOREACH(l, &s->labels, next) {
+            l->la_globals = NULL;
+        }
+    }
+
     /* ??? Should be redundant with the exit_tb that ends the TB.  */
     la_func_end(s, nb_globals, nb_temps);
 
@@ -2714,10 +2844,18 @@ static void liveness_pass_1(TCGContext *s)
                 la_func_end(s, nb_globals, nb_temps);
             } else if (def->flags & TCG_OPF_COND_BRANCH) {
                 la_bb_sync(s, nb_globals, nb_temps);
+                if (s->ebb_regalloc) {
+                    la_branch(s, tcg_op_label(op), nb_globals);
+                }
+            } else if (s->ebb_regalloc && opc == INDEX_op_set_label) {
+                la_label(s, arg_label(op->args[0]), nb_globals, nb_temps);
             } else if (def->flags & TCG_OPF_BB_END) {
                 la_bb_end(s, nb_globals, nb_temps);
+                if (s->ebb_regalloc && opc == INDEX_op_br) {
+                    la_branch(s, tcg_op_label(op), nb_globals);
+                }
             } else if (def->flags & TCG_OPF_SIDE_EFFECTS) {
-                la_global_sync(s, nb_globals);
+                la_global_sync_exc(s, nb_globals);
                 if (def->flags & TCG_OPF_CALL_CLOBBER) {
                     la_cross_call(s, nb_temps);
                 }
@@ -3165,6 +3303,11 @@ static void temp_sync(TCGContext *s, TCGTemp *ts, TCGRegSet allocated_regs,
             tcg_abort();
         }
         ts->mem_coherent = 1;
+#ifdef CONFIG_PROFILER
+        if (ts->val_type != TEMP_VAL_MEM) {
+            qatomic_set(&s->prof.spill_count, s->prof.spill_count + 1);
+        }
+#endif
     }
     if (free_or_dead) {
         temp_free_or_dead(s, ts, free_or_dead);
@@ -3293,6 +3436,9 @@ static void temp_load(TCGContext *s, TCGTemp *ts, TCGRegSet desired_regs,
                             preferred_regs, ts->indirect_base);
         tcg_out_ld(s, ts->type, reg, ts->mem_base->reg, ts->mem_offset);
         ts->mem_coherent = 1;
+#ifdef CONFIG_PROFILER
+        qatomic_set(&s->prof.reload_count, s->prof.reload_count + 1);
+#endif
         break;
     case TEMP_VAL_DEAD:
     default:
@@ -3339,9 +3485,23 @@ static void sync_globals(TCGContext *s, TCGRegSet allocated_regs)
     }
 }
 
+/* As sync_globals, before an op that may raise an exception. */
+static void sync_globals_exc(TCGContext *s, TCGRegSet allocated_regs)
+{
+    int i, n;
+
+    for (i = 0, n = s->nb_globals; i < n; i++) {
+        TCGTemp *ts = &s->temps[i];
+        tcg_debug_assert(ts->val_type != TEMP_VAL_REG
+                         || ts->kind == TEMP_FIXED
+                         || ts->mem_coherent
+                         || ts->restorable);
+    }
+}
+
 /* at the end of a basic block, we assume all temporaries are dead and
-   all globals are stored at their canonical location. */
-static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
+   local temps are stored at their canonical location. */
+static void temps_bb_end(TCGContext *s, TCGRegSet allocated_regs)
 {
     int i;
 
@@ -3365,10 +3525,94 @@ static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
             g_assert_not_reached();
         }
     }
+}
 
+/* at the end of a basic block, we assume all temporaries are dead and
+   all globals are stored at their canonical location. */
+static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
+{
+    temps_bb_end(s, allocated_regs);
     save_globals(s, allocated_regs);
 }
 
+static TCGTemp *reg_global(TCGContext *s, int reg)
+{
+    TCGTemp *ts = s->reg_to_temp[reg];
+
+    return ts && ts->kind == TEMP_GLOBAL ? ts : NULL;
+}
+
+/*
+ * At a branch, when extended basic blocks are enabled: record which
+ * globals are in which registers, keeping only those that all of the
+ * branches to the label agree on so far.
+ */
+static void tcg_reg_alloc_branch(TCGContext *s, TCGLabel *l)
+{
+    TCGTemp **regs = l->ebb_regs;
+    int i;
+
+    if (l->has_value) {
+        /* Backward branch: the label got the globals from memory.  */
+        return;
+    }
+
+    if (!regs) {
+        regs = tcg_malloc(sizeof(TCGTemp *) * TCG_TARGET_NB_REGS);
+        l->ebb_regs = regs;
+        for (i = 0; i < TCG_TARGET_NB_REGS; i++) {
+            regs[i] = reg_global(s, i);
+        }
+    } else {
+        for (i = 0; i < TCG_TARGET_NB_REGS; i++) {
+            if (regs[i] != reg_global(s, i)) {
+                regs[i] = NULL;
+            }
+        }
+    }
+    l->ebb_refs++;
+}
+
+/*
+ * At a label, when extended basic blocks are enabled: temps are dead
+ * and local temps in memory as at any end of basic block.  A global
+ * stays in its register if every way into the label, including the
+ * fall through unless it is unreachable, has it there.  Liveness made
+ * sure that the globals are synced on all of them.
+ */
+static void tcg_reg_alloc_label(TCGContext *s, TCGLabel *l)
+{
+    TCGTemp **keep = l->ebb_refs == l->refs ? l->ebb_regs : NULL;
+    bool fallthrough = !s->ebb_unreachable;
+    int i;
+
+    temps_bb_end(s, s->reserved_regs);
+
+    for (i = 0; i < TCG_TARGET_NB_REGS; i++) {
+        TCGTemp *ts = reg_global(s, i);
+
+        if (ts && !(fallthrough && keep && keep[i] == ts)) {
+            tcg_debug_assert(ts->mem_coherent);
+            temp_free_or_dead(s, ts, -1);
+        }
+    }
+
+    if (keep && !fallthrough) {
+        for (i = 0; i < TCG_TARGET_NB_REGS; i++) {
+            TCGTemp *ts = keep[i];
+
+            if (ts) {
+                tcg_debug_assert(s->reg_to_temp[i] == NULL);
+                ts->val_type = TEMP_VAL_REG;
+                ts->reg = i;
+                ts->mem_coherent = 1;
+                s->reg_to_temp[i] = ts;
+            }
+        }
+    }
+    s->ebb_unreachable = false;
+}
+
 /*
  * At a conditional branch, we assume all temporaries are dead and
  * all globals and local temps are synced to their location.
@@ -3740,8 +3984,19 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
 
     if (def->flags & TCG_OPF_COND_BRANCH) {
         tcg_reg_alloc_cbranch(s, i_allocated_regs);
+        if (s->ebb_regalloc) {
+            tcg_reg_alloc_branch(s, tcg_op_label(op));
+        }
+    } else if (s->ebb_regalloc && op->opc == INDEX_op_br) {
+        tcg_reg_alloc_cbranch(s, i_allocated_regs);
+        tcg_reg_alloc_branch(s, tcg_op_label(op));
+        s->ebb_unreachable = true;
     } else if (def->flags & TCG_OPF_BB_END) {
         tcg_reg_alloc_bb_end(s, i_allocated_regs);
+        if (s->ebb_regalloc && (op->opc == INDEX_op_exit_tb ||
+                                op->opc == INDEX_op_goto_ptr)) {
+            s->ebb_unreachable = true;
+        }
     } else {
         if (def->flags & TCG_OPF_CALL_CLOBBER) {
             /* XXX: permit generic clobber register list ? */ 
@@ -3754,7 +4009,7 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
         if (def->flags & TCG_OPF_SIDE_EFFECTS) {
             /* sync globals if the op has side effects and might trigger
                an exception. */
-            sync_globals(s, i_allocated_regs);
+            sync_globals_exc(s, i_allocated_regs);
         }
         
         /* satisfy the output constraints */
@@ -4105,6 +4360,8 @@ void tcg_profile_snapshot(TCGProfile *prof, bool counters, bool table)
             PROF_ADD(prof, orig, opt_time);
             PROF_ADD(prof, orig, restore_count);
             PROF_ADD(prof, orig, restore_time);
+            PROF_ADD(prof, orig, spill_count);
+            PROF_ADD(prof, orig, reload_count);
         }
         if (table) {
             int i;
@@ -4330,7 +4587,11 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb)
             temp_dead(s, arg_temp(op->args[0]));
             break;
         case INDEX_op_set_label:
-            tcg_reg_alloc_bb_end(s, s->reserved_regs);
+            if (s->ebb_regalloc) {
+                tcg_reg_alloc_label(s, arg_label(op->args[0]));
+            } else {
+                tcg_reg_alloc_bb_end(s, s->reserved_regs);
+            }
             tcg_out_label(s, arg_label(op->args[0]));
             break;
         case INDEX_op_call:
@@ -4429,6 +4690,10 @@ void tcg_dump_info(GString *buf)
                            (double)s->code_out_len / tb_div_count);
     g_string_append_printf(buf, "avg search data/TB  %0.1f\n",
                            (double)s->search_out_len / tb_div_count);
+    g_string_append_printf(buf, "avg spills/TB       %0.1f\n",
+                           (double)s->spill_count / tb_div_count);
+    g_string_append_printf(buf, "avg reloads/TB      %0.1f\n",
+                           (double)s->reload_count / tb_div_count);
     
     g_string_append_printf(buf, "cycles/op           %0.1f\n",
                            s->op_count ? (double)tot / s->op_count : 0);
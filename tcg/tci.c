@@ -127,6 +127,46 @@ static void tci_args_rrs(uint32_t insn, TCGReg *r0, TCGReg *r1, int32_t *i2)
     *i2 = sextract32(insn, 16, 16);
 }
 
+/* A host load or store, with an offset of up to 32 bits: the address. */
+static void *tci_args_ldst(uint32_t insn, const uint32_t **tb_ptr,
+                           const tcg_target_ulong *regs, TCGReg *r0)
+{
+    TCGReg r1;
+    int32_t ofs;
+
+    tci_args_rrs(insn, r0, &r1, &ofs);
+    if (unlikely(ofs == TCI_LDST_OFS_LONG)) {
+        ofs = *(*tb_ptr)++;
+    }
+    return (void *)(regs[r1] + ofs);
+}
+
+/* Compare and branch, with the displacement in the word after the insn. */
+static void tci_args_rrcl(uint32_t insn, const uint32_t **tb_ptr,
+                          TCGReg *r0, TCGReg *r1, TCGCond *c2, void **l3)
+{
+    int32_t diff = *(*tb_ptr)++;
+
+    *r0 = extract32(insn, 8, 4);
+    *r1 = extract32(insn, 12, 4);
+    *c2 = extract32(insn, 16, 4);
+    *l3 = (void *)*tb_ptr + diff;
+}
+
+static void tci_args_rrrrcl(uint32_t insn, const uint32_t **tb_ptr,
+                            TCGReg *r0, TCGReg *r1, TCGReg *r2, TCGReg *r3,
+                            TCGCond *c4, void **l5)
+{
+    int32_t diff = *(*tb_ptr)++;
+
+    *r0 = extract32(insn, 8, 4);
+    *r1 = extract32(insn, 12, 4);
+    *r2 = extract32(insn, 16, 4);
+    *r3 = extract32(insn, 20, 4);
+    *c4 = extract32(insn, 24, 4);
+    *l5 = (void *)*tb_ptr + diff;
+}
+
 static void tci_args_rrbb(uint32_t insn, TCGReg *r0, TCGReg *r1,
                           uint8_t *i2, uint8_t *i3)
 {
@@ -289,6 +329,90 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
     return result;
 }
 
+/* Load from host memory, with the size, sign and byte order of MOP. */
+static uint64_t tci_host_ld(const void *haddr, MemOp mop)
+{
+    switch (mop & (MO_BSWAP | MO_SSIZE)) {
+    case MO_UB:
+        return ldub_p(haddr);
+    case MO_SB:
+        return ldsb_p(haddr);
+    case MO_LEUW:
+        return lduw_le_p(haddr);
+    case MO_LESW:
+        return ldsw_le_p(haddr);
+    case MO_LEUL:
+        return (uint32_t)ldl_le_p(haddr);
+    case MO_LESL:
+        return (int32_t)ldl_le_p(haddr);
+    case MO_LEUQ:
+        return ldq_le_p(haddr);
+    case MO_BEUW:
+        return lduw_be_p(haddr);
+    case MO_BESW:
+        return ldsw_be_p(haddr);
+    case MO_BEUL:
+        return (uint32_t)ldl_be_p(haddr);
+    case MO_BESL:
+        return (int32_t)ldl_be_p(haddr);
+    case MO_BEUQ:
+        return ldq_be_p(haddr);
+    default:
+        g_assert_not_reached();
+    }
+}
+
+static void tci_host_st(void *haddr, uint64_t val, MemOp mop)
+{
+    switch (mop & (MO_BSWAP | MO_SIZE)) {
+    case MO_UB:
+        stb_p(haddr, val);
+        break;
+    case MO_LEUW:
+        stw_le_p(haddr, val);
+        break;
+    case MO_LEUL:
+        stl_le_p(haddr, val);
+        break;
+    case MO_LEUQ:
+        stq_le_p(haddr, val);
+        break;
+    case MO_BEUW:
+        stw_be_p(haddr, val);
+        break;
+    case MO_BEUL:
+        stl_be_p(haddr, val);
+        break;
+    case MO_BEUQ:
+        stq_be_p(haddr, val);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+#ifdef CONFIG_SOFTMMU
+/*
+ * The TLB lookup that the native backends inline: return the host address
+ * for an aligned access that hits an entry without any flags set, or NULL
+ * to leave it to the helpers.
+ */
+static void *tci_tlb_lookup(CPUArchState *env, target_ulong taddr,
+                            MemOpIdx oi, bool is_store)
+{
+    MemOp mop = get_memop(oi);
+    unsigned a_bits = MAX(get_alignment_bits(mop), mop & MO_SIZE);
+    CPUTLBEntry *entry = tlb_entry(env, get_mmuidx(oi), taddr);
+    target_ulong a_mask = ((target_ulong)1 << a_bits) - 1;
+    target_ulong cmp = is_store ? tlb_addr_write(entry) : entry->addr_read;
+
+    if ((taddr & (TARGET_PAGE_MASK | a_mask)) != cmp) {
+        return NULL;
+    }
+    return (void *)((uintptr_t)taddr + entry->addend);
+}
+#endif
+
 static uint64_t tci_qemu_ld(CPUArchState *env, target_ulong taddr,
                             MemOpIdx oi, const void *tb_ptr)
 {
@@ -296,6 +420,12 @@ static uint64_t tci_qemu_ld(CPUArchState *env, target_ulong taddr,
     uintptr_t ra = (uintptr_t)tb_ptr;
 
 #ifdef CONFIG_SOFTMMU
+    void *haddr = tci_tlb_lookup(env, taddr, oi, false);
+
+    if (likely(haddr)) {
+        return tci_host_ld(haddr, mop);
+    }
+
     switch (mop & (MO_BSWAP | MO_SSIZE)) {
     case MO_UB:
         return helper_ret_ldub_mmu(env, taddr, oi, ra);
@@ -333,46 +463,7 @@ static uint64_t tci_qemu_ld(CPUArchState *env, target_ulong taddr,
     if (taddr & a_mask) {
         helper_unaligned_ld(env, taddr);
     }
-    switch (mop & (MO_BSWAP | MO_SSIZE)) {
-    case MO_UB:
-        ret = ldub_p(haddr);
-        break;
-    case MO_SB:
-        ret = ldsb_p(haddr);
-        break;
-    case MO_LEUW:
-        ret = lduw_le_p(haddr);
-        break;
-    case MO_LESW:
-        ret = ldsw_le_p(haddr);
-        break;
-    case MO_LEUL:
-        ret = (uint32_t)ldl_le_p(haddr);
-        break;
-    case MO_LESL:
-        ret = (int32_t)ldl_le_p(haddr);
-        break;
-    case MO_LEUQ:
-        ret = ldq_le_p(haddr);
-        break;
-    case MO_BEUW:
-        ret = lduw_be_p(haddr);
-        break;
-    case MO_BESW:
-        ret = ldsw_be_p(haddr);
-        break;
-    case MO_BEUL:
-        ret = (uint32_t)ldl_be_p(haddr);
-        break;
-    case MO_BESL:
-        ret = (int32_t)ldl_be_p(haddr);
-        break;
-    case MO_BEUQ:
-        ret = ldq_be_p(haddr);
-        break;
-    default:
-        g_assert_not_reached();
-    }
+    ret = tci_host_ld(haddr, mop);
     clear_helper_retaddr();
     return ret;
 #endif
@@ -385,6 +476,13 @@ static void tci_qemu_st(CPUArchState *env, target_ulong taddr, uint64_t val,
     uintptr_t ra = (uintptr_t)tb_ptr;
 
 #ifdef CONFIG_SOFTMMU
+    void *haddr = tci_tlb_lookup(env, taddr, oi, true);
+
+    if (likely(haddr)) {
+        tci_host_st(haddr, val, mop);
+        return;
+    }
+
     switch (mop & (MO_BSWAP | MO_SIZE)) {
     case MO_UB:
         helper_ret_stb_mmu(env, taddr, val, oi, ra);
@@ -418,31 +516,7 @@ static void tci_qemu_st(CPUArchState *env, target_ulong taddr, uint64_t val,
     if (taddr & a_mask) {
         helper_unaligned_st(env, taddr);
     }
-    switch (mop & (MO_BSWAP | MO_SIZE)) {
-    case MO_UB:
-        stb_p(haddr, val);
-        break;
-    case MO_LEUW:
-        stw_le_p(haddr, val);
-        break;
-    case MO_LEUL:
-        stl_le_p(haddr, val);
-        break;
-    case MO_LEUQ:
-        stq_le_p(haddr, val);
-        break;
-    case MO_BEUW:
-        stw_be_p(haddr, val);
-        break;
-    case MO_BEUL:
-        stl_be_p(haddr, val);
-        break;
-    case MO_BEUQ:
-        stq_be_p(haddr, val);
-        break;
-    default:
-        g_assert_not_reached();
-    }
+    tci_host_st(haddr, val, mop);
     clear_helper_retaddr();
 #endif
 }
@@ -459,6 +533,18 @@ static void tci_qemu_st(CPUArchState *env, target_ulong taddr, uint64_t val,
 # define CASE_64(x)
 #endif
 
+/*
+ * Fetch the next insn and jump straight to its handler, so that each
+ * handler ends in an indirect branch of its own that the host can
+ * predict, rather than all of them sharing the one of the switch.
+ */
+#define TCI_NEXT()                              \
+    do {                                        \
+        insn = *tb_ptr++;                       \
+        opc = extract32(insn, 0, 8);            \
+        goto *tci_dispatch[opc];                \
+    } while (0)
+
 /* Interpret pseudo code in tb. */
 /*
  * Disable CFI checks.
@@ -473,6 +559,71 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
     uint64_t stack[(TCG_STATIC_CALL_ARGS_SIZE + TCG_STATIC_FRAME_SIZE)
                    / sizeof(uint64_t)];
     void *call_slots[TCG_STATIC_CALL_ARGS_SIZE / sizeof(uint64_t)];
+    /*
+     * The frequent opcodes have a handler label of their own; the rest
+     * go through the switch.
+     */
+    static const void *const tci_dispatch[256] = {
+        [0 ... 255] = &&do_switch,
+        [INDEX_op_call] = &&do_call,
+        [INDEX_op_br] = &&do_br,
+        [INDEX_op_brcond_i32] = &&do_brcond_i32,
+        [INDEX_op_setcond_i32] = &&do_setcond_i32,
+        [INDEX_op_mov_i32] = &&do_mov,
+        [INDEX_op_tci_movi] = &&do_tci_movi,
+        [INDEX_op_tci_movl] = &&do_tci_movl,
+        [INDEX_op_ld8u_i32] = &&do_ld8u,
+        [INDEX_op_ld8s_i32] = &&do_ld8s,
+        [INDEX_op_ld16u_i32] = &&do_ld16u,
+        [INDEX_op_ld16s_i32] = &&do_ld16s,
+        [INDEX_op_ld_i32] = &&do_ld32u,
+        [INDEX_op_st8_i32] = &&do_st8,
+        [INDEX_op_st16_i32] = &&do_st16,
+        [INDEX_op_st_i32] = &&do_st32,
+        [INDEX_op_add_i32] = &&do_add,
+        [INDEX_op_sub_i32] = &&do_sub,
+        [INDEX_op_and_i32] = &&do_and,
+        [INDEX_op_or_i32] = &&do_or,
+        [INDEX_op_xor_i32] = &&do_xor,
+        [INDEX_op_shl_i32] = &&do_shl_i32,
+        [INDEX_op_shr_i32] = &&do_shr_i32,
+        [INDEX_op_sar_i32] = &&do_sar_i32,
+        [INDEX_op_exit_tb] = &&do_exit_tb,
+        [INDEX_op_goto_tb] = &&do_goto_tb,
+        [INDEX_op_goto_ptr] = &&do_goto_ptr,
+        [INDEX_op_qemu_ld_i32] = &&do_qemu_ld_i32,
+        [INDEX_op_qemu_ld_i64] = &&do_qemu_ld_i64,
+        [INDEX_op_qemu_st_i32] = &&do_qemu_st_i32,
+        [INDEX_op_qemu_st_i64] = &&do_qemu_st_i64,
+#if TCG_TARGET_REG_BITS == 64
+        [INDEX_op_brcond_i64] = &&do_brcond_i64,
+        [INDEX_op_setcond_i64] = &&do_setcond_i64,
+        [INDEX_op_mov_i64] = &&do_mov,
+        [INDEX_op_ld8u_i64] = &&do_ld8u,
+        [INDEX_op_ld8s_i64] = &&do_ld8s,
+        [INDEX_op_ld16u_i64] = &&do_ld16u,
+        [INDEX_op_ld16s_i64] = &&do_ld16s,
+        [INDEX_op_ld32u_i64] = &&do_ld32u,
+        [INDEX_op_ld32s_i64] = &&do_ld32s_i64,
+        [INDEX_op_ld_i64] = &&do_ld_i64,
+        [INDEX_op_st8_i64] = &&do_st8,
+        [INDEX_op_st16_i64] = &&do_st16,
+        [INDEX_op_st32_i64] = &&do_st32,
+        [INDEX_op_st_i64] = &&do_st_i64,
+        [INDEX_op_add_i64] = &&do_add,
+        [INDEX_op_sub_i64] = &&do_sub,
+        [INDEX_op_and_i64] = &&do_and,
+        [INDEX_op_or_i64] = &&do_or,
+        [INDEX_op_xor_i64] = &&do_xor,
+        [INDEX_op_shl_i64] = &&do_shl_i64,
+        [INDEX_op_shr_i64] = &&do_shr_i64,
+        [INDEX_op_sar_i64] = &&do_sar_i64,
+        [INDEX_op_ext32s_i64] = &&do_ext32s_i64,
+        [INDEX_op_ext_i32_i64] = &&do_ext32s_i64,
+        [INDEX_op_ext32u_i64] = &&do_ext32u_i64,
+        [INDEX_op_extu_i32_i64] = &&do_ext32u_i64,
+#endif
+    };
 
     regs[TCG_AREG0] = (tcg_target_ulong)env;
     regs[TCG_REG_CALL_STACK] = (uintptr_t)stack;
@@ -492,14 +643,16 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
         uint64_t tmp64;
         uint64_t T1, T2;
         MemOpIdx oi;
-        int32_t ofs;
         void *ptr;
 
         insn = *tb_ptr++;
         opc = extract32(insn, 0, 8);
+        goto *tci_dispatch[opc];
 
+    do_switch:
         switch (opc) {
         case INDEX_op_call:
+        do_call:
             /*
              * Set up the ffi_avalue array once, delayed until now
              * because many TB's do not make any calls. In tcg_gen_callN,
@@ -546,152 +699,172 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             default:
                 g_assert_not_reached();
             }
-            break;
+            TCI_NEXT();
 
         case INDEX_op_br:
+        do_br:
             tci_args_l(insn, tb_ptr, &ptr);
             tb_ptr = ptr;
-            continue;
+            TCI_NEXT();
         case INDEX_op_setcond_i32:
+        do_setcond_i32:
             tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
-            break;
+            TCI_NEXT();
         case INDEX_op_movcond_i32:
             tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
             tmp32 = tci_compare32(regs[r1], regs[r2], condition);
             regs[r0] = regs[tmp32 ? r3 : r4];
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_REG_BITS == 32
         case INDEX_op_setcond2_i32:
             tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
             T1 = tci_uint64(regs[r2], regs[r1]);
             T2 = tci_uint64(regs[r4], regs[r3]);
             regs[r0] = tci_compare64(T1, T2, condition);
-            break;
+            TCI_NEXT();
+        case INDEX_op_brcond2_i32:
+            tci_args_rrrrcl(insn, &tb_ptr, &r0, &r1, &r2, &r3,
+                            &condition, &ptr);
+            T1 = tci_uint64(regs[r1], regs[r0]);
+            T2 = tci_uint64(regs[r3], regs[r2]);
+            if (tci_compare64(T1, T2, condition)) {
+                tb_ptr = ptr;
+            }
+            TCI_NEXT();
 #elif TCG_TARGET_REG_BITS == 64
         case INDEX_op_setcond_i64:
+        do_setcond_i64:
             tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
             regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
-            break;
+            TCI_NEXT();
         case INDEX_op_movcond_i64:
             tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
             tmp32 = tci_compare64(regs[r1], regs[r2], condition);
             regs[r0] = regs[tmp32 ? r3 : r4];
-            break;
+            TCI_NEXT();
 #endif
         CASE_32_64(mov)
+        do_mov:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = regs[r1];
-            break;
+            TCI_NEXT();
         case INDEX_op_tci_movi:
+        do_tci_movi:
             tci_args_ri(insn, &r0, &t1);
             regs[r0] = t1;
-            break;
+            TCI_NEXT();
         case INDEX_op_tci_movl:
+        do_tci_movl:
             tci_args_rl(insn, tb_ptr, &r0, &ptr);
             regs[r0] = *(tcg_target_ulong *)ptr;
-            break;
+            TCI_NEXT();
 
             /* Load/store operations (32 bit). */
 
         CASE_32_64(ld8u)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_ld8u:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             regs[r0] = *(uint8_t *)ptr;
-            break;
+            TCI_NEXT();
         CASE_32_64(ld8s)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_ld8s:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             regs[r0] = *(int8_t *)ptr;
-            break;
+            TCI_NEXT();
         CASE_32_64(ld16u)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_ld16u:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             regs[r0] = *(uint16_t *)ptr;
-            break;
+            TCI_NEXT();
         CASE_32_64(ld16s)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_ld16s:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             regs[r0] = *(int16_t *)ptr;
-            break;
+            TCI_NEXT();
         case INDEX_op_ld_i32:
         CASE_64(ld32u)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_ld32u:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             regs[r0] = *(uint32_t *)ptr;
-            break;
+            TCI_NEXT();
         CASE_32_64(st8)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_st8:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             *(uint8_t *)ptr = regs[r0];
-            break;
+            TCI_NEXT();
         CASE_32_64(st16)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_st16:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             *(uint16_t *)ptr = regs[r0];
-            break;
+            TCI_NEXT();
         case INDEX_op_st_i32:
         CASE_64(st32)
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_st32:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             *(uint32_t *)ptr = regs[r0];
-            break;
+            TCI_NEXT();
 
             /* Arithmetic operations (mixed 32/64 bit). */
 
         CASE_32_64(add)
+        do_add:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] + regs[r2];
-            break;
+            TCI_NEXT();
         CASE_32_64(sub)
+        do_sub:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] - regs[r2];
-            break;
+            TCI_NEXT();
         CASE_32_64(mul)
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] * regs[r2];
-            break;
+            TCI_NEXT();
         CASE_32_64(and)
+        do_and:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] & regs[r2];
-            break;
+            TCI_NEXT();
         CASE_32_64(or)
+        do_or:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] | regs[r2];
-            break;
+            TCI_NEXT();
         CASE_32_64(xor)
+        do_xor:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] ^ regs[r2];
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_HAS_andc_i32 || TCG_TARGET_HAS_andc_i64
         CASE_32_64(andc)
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] & ~regs[r2];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_orc_i32 || TCG_TARGET_HAS_orc_i64
         CASE_32_64(orc)
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] | ~regs[r2];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_eqv_i32 || TCG_TARGET_HAS_eqv_i64
         CASE_32_64(eqv)
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = ~(regs[r1] ^ regs[r2]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_nand_i32 || TCG_TARGET_HAS_nand_i64
         CASE_32_64(nand)
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = ~(regs[r1] & regs[r2]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_nor_i32 || TCG_TARGET_HAS_nor_i64
         CASE_32_64(nor)
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = ~(regs[r1] | regs[r2]);
-            break;
+            TCI_NEXT();
 #endif
 
             /* Arithmetic operations (32 bit). */
@@ -699,95 +872,99 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
         case INDEX_op_div_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
-            break;
+            TCI_NEXT();
         case INDEX_op_divu_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
-            break;
+            TCI_NEXT();
         case INDEX_op_rem_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
-            break;
+            TCI_NEXT();
         case INDEX_op_remu_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_HAS_clz_i32
         case INDEX_op_clz_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             tmp32 = regs[r1];
             regs[r0] = tmp32 ? clz32(tmp32) : regs[r2];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ctz_i32
         case INDEX_op_ctz_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             tmp32 = regs[r1];
             regs[r0] = tmp32 ? ctz32(tmp32) : regs[r2];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ctpop_i32
         case INDEX_op_ctpop_i32:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = ctpop32(regs[r1]);
-            break;
+            TCI_NEXT();
 #endif
 
             /* Shift/rotate operations (32 bit). */
 
         case INDEX_op_shl_i32:
+        do_shl_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] << (regs[r2] & 31);
-            break;
+            TCI_NEXT();
         case INDEX_op_shr_i32:
+        do_shr_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint32_t)regs[r1] >> (regs[r2] & 31);
-            break;
+            TCI_NEXT();
         case INDEX_op_sar_i32:
+        do_sar_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int32_t)regs[r1] >> (regs[r2] & 31);
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_HAS_rot_i32
         case INDEX_op_rotl_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = rol32(regs[r1], regs[r2] & 31);
-            break;
+            TCI_NEXT();
         case INDEX_op_rotr_i32:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = ror32(regs[r1], regs[r2] & 31);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_deposit_i32
         case INDEX_op_deposit_i32:
             tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
             regs[r0] = deposit32(regs[r1], pos, len, regs[r2]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_extract_i32
         case INDEX_op_extract_i32:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = extract32(regs[r1], pos, len);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_sextract_i32
         case INDEX_op_sextract_i32:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = sextract32(regs[r1], pos, len);
-            break;
+            TCI_NEXT();
 #endif
         case INDEX_op_brcond_i32:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            if ((uint32_t)regs[r0]) {
+        do_brcond_i32:
+            tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+            if (tci_compare32(regs[r0], regs[r1], condition)) {
                 tb_ptr = ptr;
             }
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_add2_i32
         case INDEX_op_add2_i32:
             tci_args_rrrrrr(insn, &r0, &r1, &r2, &r3, &r4, &r5);
             T1 = tci_uint64(regs[r3], regs[r2]);
             T2 = tci_uint64(regs[r5], regs[r4]);
             tci_write_reg64(regs, r1, r0, T1 + T2);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_REG_BITS == 32 || TCG_TARGET_HAS_sub2_i32
         case INDEX_op_sub2_i32:
@@ -795,137 +972,137 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             T1 = tci_uint64(regs[r3], regs[r2]);
             T2 = tci_uint64(regs[r5], regs[r4]);
             tci_write_reg64(regs, r1, r0, T1 - T2);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_mulu2_i32
         case INDEX_op_mulu2_i32:
             tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
             tmp64 = (uint64_t)(uint32_t)regs[r2] * (uint32_t)regs[r3];
             tci_write_reg64(regs, r1, r0, tmp64);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_muls2_i32
         case INDEX_op_muls2_i32:
             tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
             tmp64 = (int64_t)(int32_t)regs[r2] * (int32_t)regs[r3];
             tci_write_reg64(regs, r1, r0, tmp64);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
         CASE_32_64(ext8s)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (int8_t)regs[r1];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64 || \
     TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
         CASE_32_64(ext16s)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (int16_t)regs[r1];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ext8u_i32 || TCG_TARGET_HAS_ext8u_i64
         CASE_32_64(ext8u)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (uint8_t)regs[r1];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ext16u_i32 || TCG_TARGET_HAS_ext16u_i64
         CASE_32_64(ext16u)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (uint16_t)regs[r1];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
         CASE_32_64(bswap16)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = bswap16(regs[r1]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_bswap32_i32 || TCG_TARGET_HAS_bswap32_i64
         CASE_32_64(bswap32)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = bswap32(regs[r1]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_not_i32 || TCG_TARGET_HAS_not_i64
         CASE_32_64(not)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = ~regs[r1];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_neg_i32 || TCG_TARGET_HAS_neg_i64
         CASE_32_64(neg)
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = -regs[r1];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_REG_BITS == 64
             /* Load/store operations (64 bit). */
 
         case INDEX_op_ld32s_i64:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_ld32s_i64:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             regs[r0] = *(int32_t *)ptr;
-            break;
+            TCI_NEXT();
         case INDEX_op_ld_i64:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_ld_i64:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             regs[r0] = *(uint64_t *)ptr;
-            break;
+            TCI_NEXT();
         case INDEX_op_st_i64:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
+        do_st_i64:
+            ptr = tci_args_ldst(insn, &tb_ptr, regs, &r0);
             *(uint64_t *)ptr = regs[r0];
-            break;
+            TCI_NEXT();
 
             /* Arithmetic operations (64 bit). */
 
         case INDEX_op_div_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
-            break;
+            TCI_NEXT();
         case INDEX_op_divu_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
-            break;
+            TCI_NEXT();
         case INDEX_op_rem_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
-            break;
+            TCI_NEXT();
         case INDEX_op_remu_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_HAS_clz_i64
         case INDEX_op_clz_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] ? clz64(regs[r1]) : regs[r2];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ctz_i64
         case INDEX_op_ctz_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] ? ctz64(regs[r1]) : regs[r2];
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ctpop_i64
         case INDEX_op_ctpop_i64:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = ctpop64(regs[r1]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_mulu2_i64
         case INDEX_op_mulu2_i64:
             tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
             mulu64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_muls2_i64
         case INDEX_op_muls2_i64:
             tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
             muls64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_add2_i64
         case INDEX_op_add2_i64:
@@ -934,7 +1111,7 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             T2 = regs[r3] + regs[r5] + (T1 < regs[r2]);
             regs[r0] = T1;
             regs[r1] = T2;
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_add2_i64
         case INDEX_op_sub2_i64:
@@ -943,96 +1120,106 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             T2 = regs[r3] - regs[r5] - (regs[r2] < regs[r4]);
             regs[r0] = T1;
             regs[r1] = T2;
-            break;
+            TCI_NEXT();
 #endif
 
             /* Shift/rotate operations (64 bit). */
 
         case INDEX_op_shl_i64:
+        do_shl_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] << (regs[r2] & 63);
-            break;
+            TCI_NEXT();
         case INDEX_op_shr_i64:
+        do_shr_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = regs[r1] >> (regs[r2] & 63);
-            break;
+            TCI_NEXT();
         case INDEX_op_sar_i64:
+        do_sar_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = (int64_t)regs[r1] >> (regs[r2] & 63);
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_HAS_rot_i64
         case INDEX_op_rotl_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = rol64(regs[r1], regs[r2] & 63);
-            break;
+            TCI_NEXT();
         case INDEX_op_rotr_i64:
             tci_args_rrr(insn, &r0, &r1, &r2);
             regs[r0] = ror64(regs[r1], regs[r2] & 63);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_deposit_i64
         case INDEX_op_deposit_i64:
             tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
             regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_extract_i64
         case INDEX_op_extract_i64:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = extract64(regs[r1], pos, len);
-            break;
+            TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_sextract_i64
         case INDEX_op_sextract_i64:
             tci_args_rrbb(insn, &r0, &r1, &pos, &len);
             regs[r0] = sextract64(regs[r1], pos, len);
-            break;
+            TCI_NEXT();
 #endif
         case INDEX_op_brcond_i64:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            if (regs[r0]) {
+        do_brcond_i64:
+            tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &condition, &ptr);
+            if (tci_compare64(regs[r0], regs[r1], condition)) {
                 tb_ptr = ptr;
             }
-            break;
+            TCI_NEXT();
         case INDEX_op_ext32s_i64:
         case INDEX_op_ext_i32_i64:
+        do_ext32s_i64:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (int32_t)regs[r1];
-            break;
+            TCI_NEXT();
         case INDEX_op_ext32u_i64:
         case INDEX_op_extu_i32_i64:
+        do_ext32u_i64:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = (uint32_t)regs[r1];
-            break;
+            TCI_NEXT();
 #if TCG_TARGET_HAS_bswap64_i64
         case INDEX_op_bswap64_i64:
             tci_args_rr(insn, &r0, &r1);
             regs[r0] = bswap64(regs[r1]);
-            break;
+            TCI_NEXT();
 #endif
 #endif /* TCG_TARGET_REG_BITS == 64 */
 
             /* QEMU specific operations. */
 
         case INDEX_op_exit_tb:
+        do_exit_tb:
             tci_args_l(insn, tb_ptr, &ptr);
             return (uintptr_t)ptr;
 
         case INDEX_op_goto_tb:
+        do_goto_tb:
             tci_args_l(insn, tb_ptr, &ptr);
             tb_ptr = *(void **)ptr;
-            break;
+            TCI_NEXT();
 
         case INDEX_op_goto_ptr:
+        do_goto_ptr:
             tci_args_r(insn, &r0);
             ptr = (void *)regs[r0];
             if (!ptr) {
                 return 0;
             }
             tb_ptr = ptr;
-            break;
+            TCI_NEXT();
 
         case INDEX_op_qemu_ld_i32:
+        do_qemu_ld_i32:
             if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
                 tci_args_rrm(insn, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -1042,9 +1229,10 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             }
             tmp32 = tci_qemu_ld(env, taddr, oi, tb_ptr);
             regs[r0] = tmp32;
-            break;
+            TCI_NEXT();
 
         case INDEX_op_qemu_ld_i64:
+        do_qemu_ld_i64:
             if (TCG_TARGET_REG_BITS == 64) {
                 tci_args_rrm(insn, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -1062,9 +1250,10 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             } else {
                 regs[r0] = tmp64;
             }
-            break;
+            TCI_NEXT();
 
         case INDEX_op_qemu_st_i32:
+        do_qemu_st_i32:
             if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
                 tci_args_rrm(insn, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -1074,9 +1263,10 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
             }
             tmp32 = regs[r0];
             tci_qemu_st(env, taddr, tmp32, oi, tb_ptr);
-            break;
+            TCI_NEXT();
 
         case INDEX_op_qemu_st_i64:
+        do_qemu_st_i64:
             if (TCG_TARGET_REG_BITS == 64) {
                 tci_args_rrm(insn, &r0, &r1, &oi);
                 taddr = regs[r1];
@@ -1093,12 +1283,12 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
                 tmp64 = tci_uint64(regs[r1], regs[r0]);
             }
             tci_qemu_st(env, taddr, tmp64, oi, tb_ptr);
-            break;
+            TCI_NEXT();
 
         case INDEX_op_mb:
             /* Ensure ordering for all kinds */
             smp_mb();
-            break;
+            TCI_NEXT();
         default:
             g_assert_not_reached();
         }
@@ -1190,9 +1380,16 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
 
     case INDEX_op_brcond_i32:
     case INDEX_op_brcond_i64:
-        tci_args_rl(insn, tb_ptr, &r0, &ptr);
-        info->fprintf_func(info->stream, "%-12s  %s, 0, ne, %p",
-                           op_name, str_r(r0), ptr);
+        tci_args_rrcl(insn, &tb_ptr, &r0, &r1, &c, &ptr);
+        info->fprintf_func(info->stream, "%-12s  %s, %s, %s, %p",
+                           op_name, str_r(r0), str_r(r1), str_c(c), ptr);
+        break;
+
+    case INDEX_op_brcond2_i32:
+        tci_args_rrrrcl(insn, &tb_ptr, &r0, &r1, &r2, &r3, &c, &ptr);
+        info->fprintf_func(info->stream, "%-12s  %s, %s, %s, %s, %s, %p",
+                           op_name, str_r(r0), str_r(r1), str_r(r2),
+                           str_r(r3), str_c(c), ptr);
         break;
 
     case INDEX_op_setcond_i32:
@@ -1234,6 +1431,9 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
     case INDEX_op_st_i32:
     case INDEX_op_st_i64:
         tci_args_rrs(insn, &r0, &r1, &s2);
+        if (s2 == TCI_LDST_OFS_LONG) {
+            s2 = *tb_ptr++;
+        }
         info->fprintf_func(info->stream, "%-12s  %s, %s, %d",
                            op_name, str_r(r0), str_r(r1), s2);
         break;
@@ -1405,5 +1605,5 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
         break;
     }
 
-    return sizeof(insn);
+    return (uintptr_t)tb_ptr - (uintptr_t)addr;
 }
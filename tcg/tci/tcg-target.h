@@ -174,6 +174,12 @@ typedef enum {
 
 #define TCG_TARGET_HAS_MEMORY_BSWAP     1
 
+/*
+ * A host load or store with an offset that does not fit in its 16-bit
+ * field has this value there instead, and the offset in the next word.
+ */
+#define TCI_LDST_OFS_LONG               (-0x8000)
+
 /* not defined -- call should be eliminated at compile time */
 void tb_target_set_jmp_target(uintptr_t, uintptr_t, uintptr_t, uintptr_t);
 
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+#
+# Run the softmmu TLB miss benchmarks against one or more QEMU builds
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# The guests map pages of more than one size and keep touching them
+# while invalidating some other page, so that any imprecision in how
+# the softmmu TLB flushes large pages shows up as TLB misses:
+#
+#   arc:     tests/tcg/arc/bench/bench_tlb_mixed_mmu.elf
+#   x86_64:  tests/tcg/x86_64/tlb-bench (built by check-tcg)
+#
+# Each guest is started stopped, timed from "cont" until it powers the
+# machine off, and "info jit" is then queried for the TLB flush counts.
+# With --vtlb-size, every run is repeated for each victim TLB size.
+#
+# Example:
+#
+#   ./tlb-bench.py --build base=../base-build --build new=. \
+#       --vtlb-size 8 --vtlb-size 32 \
+#       arc:tests/tcg/arc/bench/bench_tlb_mixed_mmu.elf \
+#       x86_64:tests/tcg/x86_64-softmmu/tlb-bench
+#
+
+import argparse
+import os
+import re
+import sys
+import time
+
+sys.path.append(os.path.join(os.path.dirname(__file__),
+                             '..', '..', 'python'))
+from qemu.machine import QEMUMachine
+
+
+MACHINE_ARGS = {
+    'arc': ['-M', 'arc-sim', '-cpu', 'archs', '-m', '3G',
+            '-global', 'cpu.mpu-numreg=8', '-serial', 'null'],
+    'x86_64': ['-M', 'pc', '-m', '2G'],
+}
+
+
+def parse_info_jit(text):
+    res = {}
+    for key, pattern in (('full', r'TLB full flushes\s+(\d+)'),
+                         ('part', r'TLB partial flushes\s+(\d+)'),
+                         ('large', r'TLB large page full flushes\s+(\d+)')):
+        m = re.search(pattern, text)
+        res[key] = int(m.group(1)) if m else None
+    return res
+
+
+def time_run(qemu, extra, kernel, timeout):
+    vm = QEMUMachine(qemu, args=extra + ['-S', '-no-shutdown',
+                                         '-kernel', kernel])
+    vm.launch()
+    try:
+        start = time.monotonic()
+        vm.command('cont')
+        vm.event_wait('SHUTDOWN', timeout=timeout)
+        elapsed = time.monotonic() - start
+        jit = vm.command('human-monitor-command',
+                         command_line='info jit')
+    finally:
+        vm.shutdown()
+    res = parse_info_jit(jit)
+    res['wall'] = elapsed
+    return res
+
+
+def fmt(value, spec):
+    return 'n/a' if value is None else format(value, spec)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run softmmu TLB miss benchmarks and report the run '
+                    'time and the TLB flush counts.')
+    parser.add_argument('--build', action='append', required=True,
+                        metavar='[NAME=]DIR',
+                        help='QEMU build directory, may be repeated')
+    parser.add_argument('--vtlb-size', action='append', type=int,
+                        metavar='N',
+                        help='victim TLB size to run with, may be repeated')
+    parser.add_argument('--timeout', type=int, default=600,
+                        help='per run timeout in seconds')
+    parser.add_argument('benchmarks', nargs='+', metavar='ARCH:KERNEL')
+    args = parser.parse_args()
+
+    builds = []
+    for spec in args.build:
+        name, _, path = spec.rpartition('=')
+        builds.append((name or path, path))
+
+    benchmarks = []
+    for spec in args.benchmarks:
+        arch, _, kernel = spec.partition(':')
+        if arch not in MACHINE_ARGS or not kernel:
+            parser.error('%s: expected one of %s, a colon and a kernel' %
+                         (spec, ', '.join(MACHINE_ARGS)))
+        benchmarks.append((arch, kernel))
+
+    print('%-12s %-24s %6s %10s %10s %10s %10s' %
+          ('build', 'benchmark', 'vtlb', 'wall(s)',
+           'full', 'partial', 'large'))
+    for name, path in builds:
+        for arch, kernel in benchmarks:
+            qemu = os.path.join(path, 'qemu-system-' + arch)
+            for vtlb in args.vtlb_size or [None]:
+                extra = list(MACHINE_ARGS[arch])
+                if vtlb is not None:
+                    extra += ['-accel', 'tcg,vtlb-size=%d' % vtlb]
+                res = time_run(qemu, extra, kernel, args.timeout)
+                print('%-12s %-24s %6s %10.3f %10s %10s %10s' %
+                      (name, os.path.splitext(os.path.basename(kernel))[0],
+                       fmt(vtlb, 'd'), res['wall'], fmt(res['full'], 'd'),
+                       fmt(res['part'], 'd'), fmt(res['large'], 'd')))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# Run the ARC TCG benchmarks against one or more QEMU builds
+#
+# Copyright (c) 2022 Synopsys Inc.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Every benchmark is run twice per build:
+#
+#  1. with the "insn" plugin in inline mode, to get the number of
+#     guest instructions retired;
+#  2. without plugins, stopped at startup and timed from "cont" until
+#     the guest powers the machine off. "info jit" is then queried to
+#     get the TB count and, on --enable-profiler builds, the time spent
+#     in the translator and the register spills and reloads per TB.
+#
+# Guest MIPS is computed from the instruction count of the first run
+# and the wall clock time of the second one, so that the plugin
+# overhead does not skew the result.
+#
+# Example:
+#
+#   ./arc-bench.py --qemu base=../base/qemu-system-arc \
+#                  --qemu new=./qemu-system-arc \
+#                  --plugin tests/plugin/libinsn.so *.elf
+#
+# A build may carry extra options, to compare runtime settings:
+#
+#   ./arc-bench.py --qemu 'bb=./qemu-system-arc' \
+#                  --qemu 'ebb=./qemu-system-arc -accel tcg,ebb-regalloc=on' \
+#                  --plugin tests/plugin/libinsn.so *.elf
+#
+
+import argparse
+import os
+import re
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.append(os.path.join(os.path.dirname(__file__),
+                             '..', '..', '..', '..', 'python'))
+from qemu.machine import QEMUMachine
+
+
+MACHINE_ARGS = ['-M', 'arc-sim', '-cpu', 'archs', '-m', '3G',
+                '-global', 'cpu.mpu-numreg=8', '-serial', 'null']
+
+
+def count_insns(qemu, extra, plugin, elf, timeout):
+    with tempfile.TemporaryDirectory() as tmp:
+        log = os.path.join(tmp, 'plugin.log')
+        subprocess.run([qemu] + MACHINE_ARGS + extra +
+                       ['-display', 'none', '-monitor', 'none',
+                        '-plugin', plugin + ',inline=on',
+                        '-d', 'plugin', '-D', log, '-kernel', elf],
+                       check=True, timeout=timeout,
+                       stdout=subprocess.DEVNULL)
+        with open(log) as f:
+            m = re.search(r'^insns: (\d+)$', f.read(), re.MULTILINE)
+    return int(m.group(1)) if m else None
+
+
+def parse_info_jit(text):
+    res = {}
+    for key, pattern in (('tbs', r'TB count\s+(\d+)'),
+                         ('translated', r'translated TBs\s+(\d+)'),
+                         ('jit_ns', r'JIT cycles\s+(\d+)'),
+                         ('spills', r'avg spills/TB\s+([\d.]+)'),
+                         ('reloads', r'avg reloads/TB\s+([\d.]+)')):
+        m = re.search(pattern, text)
+        res[key] = float(m.group(1)) if m else None
+    return res
+
+
+def time_run(qemu, extra, elf, timeout):
+    vm = QEMUMachine(qemu, args=MACHINE_ARGS + extra +
+                     ['-S', '-no-shutdown', '-kernel', elf])
+    vm.launch()
+    try:
+        start = time.monotonic()
+        vm.command('cont')
+        vm.event_wait('SHUTDOWN', timeout=timeout)
+        elapsed = time.monotonic() - start
+        jit = vm.command('human-monitor-command',
+                         command_line='info jit')
+    finally:
+        vm.shutdown()
+    res = parse_info_jit(jit)
+    res['wall'] = elapsed
+    return res
+
+
+def fmt(value, spec):
+    return 'n/a' if value is None else format(value, spec)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run ARC TCG benchmarks and report guest MIPS, '
+                    'translation time and TB counts.')
+    parser.add_argument('--qemu', action='append', required=True,
+                        metavar='[NAME=]BINARY [OPTION...]',
+                        help='qemu-system-arc binary and extra options, '
+                             'may be repeated')
+    parser.add_argument('--plugin', required=True,
+                        help='path to tests/plugin/libinsn.so')
+    parser.add_argument('--timeout', type=int, default=600,
+                        help='per run timeout in seconds')
+    parser.add_argument('benchmarks', nargs='+', metavar='ELF')
+    args = parser.parse_args()
+
+    builds = []
+    for spec in args.qemu:
+        argv = shlex.split(spec)
+        name, _, argv[0] = argv[0].rpartition('=')
+        builds.append((name or argv[0], argv[0], argv[1:]))
+
+    print('%-12s %-24s %12s %10s %8s %10s %10s %10s %8s %8s' %
+          ('build', 'benchmark', 'insns', 'wall(s)', 'MIPS',
+           'TBs', 'xlated', 'jit(ms)', 'spill/TB', 'rload/TB'))
+    for name, qemu, extra in builds:
+        for elf in args.benchmarks:
+            insns = count_insns(qemu, extra, args.plugin, elf, args.timeout)
+            res = time_run(qemu, extra, elf, args.timeout)
+            mips = insns / res['wall'] / 1e6 if insns else None
+            jit_ms = res['jit_ns'] / 1e6 if res['jit_ns'] else None
+            print('%-12s %-24s %12s %10.3f %8s %10s %10s %10s %8s %8s' %
+                  (name, os.path.splitext(os.path.basename(elf))[0],
+                   fmt(insns, 'd'), res['wall'], fmt(mips, '.1f'),
+                   fmt(res['tbs'], '.0f'), fmt(res['translated'], '.0f'),
+                   fmt(jit_ms, '.1f'), fmt(res['spills'], '.1f'),
+                   fmt(res['reloads'], '.1f')))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,190 @@
+/*
+ * Test REP MOVS and REP STOS across pages, with overlapping operands and
+ * with either direction flag, against a plain C loop.
+ *
+ * With "bench" as the argument, report the throughput of large copies
+ * and fills instead.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define BUF_SIZE    (4 * 4096)
+#define BENCH_SIZE  (1024 * 1024)
+#define BENCH_MB    1024
+
+static uint8_t buf[BUF_SIZE] __attribute__((aligned(4096)));
+static uint8_t ref[BUF_SIZE] __attribute__((aligned(4096)));
+
+struct regs {
+    uintptr_t si, di, cx;
+};
+
+#define REP_OP(NAME, INSN)                                              \
+static void NAME(struct regs *r, uintptr_t ax, int down)                \
+{                                                                       \
+    if (down) {                                                         \
+        asm volatile("std; rep " INSN "; cld"                           \
+                     : "+S"(r->si), "+D"(r->di), "+c"(r->cx)            \
+                     : "a"(ax) : "memory");                             \
+    } else {                                                            \
+        asm volatile("rep " INSN                                        \
+                     : "+S"(r->si), "+D"(r->di), "+c"(r->cx)            \
+                     : "a"(ax) : "memory");                             \
+    }                                                                   \
+}
+
+REP_OP(rep_movsb, "movsb")
+REP_OP(rep_movsw, "movsw")
+REP_OP(rep_movsl, "movsl")
+REP_OP(rep_stosb, "stosb")
+REP_OP(rep_stosw, "stosw")
+REP_OP(rep_stosl, "stosl")
+
+static void (*const movs[])(struct regs *, uintptr_t, int) = {
+    rep_movsb, rep_movsw, rep_movsl
+};
+static void (*const stos[])(struct regs *, uintptr_t, int) = {
+    rep_stosb, rep_stosw, rep_stosl
+};
+
+static void fill(void)
+{
+    int i;
+
+    for (i = 0; i < BUF_SIZE; i++) {
+        buf[i] = i * 7 + (i >> 8);
+    }
+    memcpy(ref, buf, BUF_SIZE);
+}
+
+/* The reference: one element at a time, in the order of the insn. */
+static void ref_op(int is_movs, size_t dst, size_t src, size_t count,
+                   int size, uint32_t ax, int down)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        size_t d = down ? dst - i * size : dst + i * size;
+        size_t s = down ? src - i * size : src + i * size;
+
+        if (is_movs) {
+            memmove(ref + d, ref + s, size);
+        } else {
+            memcpy(ref + d, &ax, size);
+        }
+    }
+}
+
+static int check(const char *op, int size, size_t dst, size_t src,
+                 size_t count, int down)
+{
+    int is_movs = op[0] == 'm';
+    uint32_t ax = 0x11223344;
+    size_t step = down ? -count * size : count * size;
+    struct regs r = {
+        .si = (uintptr_t)buf + src,
+        .di = (uintptr_t)buf + dst,
+        .cx = count,
+    };
+
+    fill();
+    ref_op(is_movs, dst, src, count, size, ax, down);
+    (is_movs ? movs : stos)[size >> 1](&r, ax, down);
+
+    if (memcmp(buf, ref, BUF_SIZE) != 0 || r.cx != 0 ||
+        r.di != (uintptr_t)buf + dst + step ||
+        (is_movs && r.si != (uintptr_t)buf + src + step)) {
+        printf("FAIL: rep %s%c dst %#zx src %#zx count %zu%s\n",
+               op, "bwl"[size >> 1], dst, src, count, down ? " std" : "");
+        return 1;
+    }
+    return 0;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int bench(void)
+{
+    uint8_t *src = malloc(BENCH_SIZE), *dst = malloc(BENCH_SIZE);
+    struct regs r;
+    double t;
+    int i;
+
+    memset(src, 1, BENCH_SIZE);
+
+    t = now();
+    for (i = 0; i < BENCH_MB; i++) {
+        r = (struct regs) { (uintptr_t)src, (uintptr_t)dst, BENCH_SIZE / 4 };
+        rep_movsl(&r, 0, 0);
+    }
+    printf("rep movsl: %.1f MB/s\n", BENCH_MB / (now() - t));
+
+    t = now();
+    for (i = 0; i < BENCH_MB; i++) {
+        r = (struct regs) { 0, (uintptr_t)dst, BENCH_SIZE };
+        rep_stosb(&r, 0x5a, 0);
+    }
+    printf("rep stosb: %.1f MB/s\n", BENCH_MB / (now() - t));
+
+    free(src);
+    free(dst);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t offsets[] = { 0, 1, 3, 4094, 4095, 4096, 4099 };
+    static const size_t counts[] = { 0, 1, 5, 1000, 2049, 4097 };
+    static const ssize_t gaps[] = { 4096 + 512, 1, 2, 4, 6, -3, -8 };
+    int err = 0, size, down;
+    size_t o, c, g;
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return bench();
+    }
+
+    for (size = 1; size <= 4; size <<= 1) {
+        for (down = 0; down < 2; down++) {
+            for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+                for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+                    size_t src = 4096 + offsets[o];
+                    size_t len = counts[c] * size;
+
+                    if (down) {
+                        /* Start from the last element, going down. */
+                        src += len - size;
+                    }
+                    for (g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+                        size_t dst = src + gaps[g];
+
+                        if (down ? src + size > BUF_SIZE ||
+                                   dst + size > BUF_SIZE || dst < len :
+                                   src + len > BUF_SIZE ||
+                                   dst + len > BUF_SIZE) {
+                            continue;
+                        }
+                        err |= check("movs", size, dst, src, counts[c], down);
+                    }
+                    if (src + size <= BUF_SIZE && src + len <= BUF_SIZE) {
+                        err |= check("stos", size, src, src, counts[c], down);
+                    }
+                }
+            }
+        }
+    }
+
+    return err;
+}
@@ -0,0 +1,88 @@
+/*
+ * TLB miss benchmark, with a mix of 4K and 2M pages
+ *
+ * boot.S identity maps the first 4GB with 2M pages. This maps the 2M
+ * at 1GB with 4K pages instead, and then keeps reading and writing a
+ * few 2M pages at either end of the first 2GB and a few of the 4K
+ * pages, while invalidating another 4K page with invlpg every round,
+ * as a kernel would after changing its PTE.
+ *
+ * Unless the softmmu TLB tracks the 2M pages at each end apart, the
+ * area it flushes for large pages covers the 4K pages as well, and
+ * every invlpg flushes all of the TLB. Run with "-m 2G".
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <inttypes.h>
+#include <minilib.h>
+
+#define ROUNDS          200000
+
+#define PAGE_4K         0x1000ULL
+#define PAGE_2M         0x200000ULL
+#define PTE_ADDR_MASK   0x000ffffffffff000ULL
+#define PTE_FLAGS       0x67            /* P, RW, US, A, D */
+#define PDE_FLAGS       0x07            /* P, RW, US */
+
+#define SMALL_BASE      0x40000000ULL
+#define SMALL_PAGES     64
+#define SMALL_VICTIMS   64
+#define LARGE_LOW       0x01000000ULL
+#define LARGE_HIGH      0x70000000ULL
+#define LARGE_PAGES     4
+
+__attribute__((aligned(4096)))
+static uint64_t small_pt[512];
+
+static uint64_t *table(uint64_t entry)
+{
+    return (uint64_t *)(uintptr_t)(entry & PTE_ADDR_MASK);
+}
+
+static void touch(uint64_t addr)
+{
+    volatile uint64_t *p = (volatile uint64_t *)(uintptr_t)addr;
+
+    *p = *p + 1;
+}
+
+static void map_small_pages(void)
+{
+    uint64_t cr3, *pd;
+    int i;
+
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    pd = table(table(table(cr3)[0])[SMALL_BASE >> 30]);
+
+    for (i = 0; i < 512; i++) {
+        small_pt[i] = (SMALL_BASE + i * PAGE_4K) | PTE_FLAGS;
+    }
+    pd[(SMALL_BASE >> 21) & 511] = (uintptr_t)small_pt | PDE_FLAGS;
+
+    asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+int main(void)
+{
+    int r, i;
+
+    map_small_pages();
+
+    for (r = 0; r < ROUNDS; r++) {
+        uint64_t victim = SMALL_BASE +
+            (SMALL_PAGES + r % SMALL_VICTIMS) * PAGE_4K;
+
+        for (i = 0; i < LARGE_PAGES; i++) {
+            touch(LARGE_LOW + i * PAGE_2M);
+            touch(LARGE_HIGH + i * PAGE_2M);
+        }
+        for (i = 0; i < SMALL_PAGES; i++) {
+            touch(SMALL_BASE + i * PAGE_4K);
+        }
+        asm volatile("invlpg (%0)" : : "r"(victim) : "memory");
+    }
+
+    ml_printf("[DONE] tlb-bench, %d rounds\n", ROUNDS);
+    return 0;
+}